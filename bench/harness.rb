@@ -0,0 +1,100 @@
+require 'json'
+
+module FastMatrixBench
+  #
+  # One measured operation: +flops+ and +bytes+ are per call and give
+  # GFLOPS and GB/s, +stdlib+ is the same operation on ::Matrix if any.
+  #
+  Case = Struct.new(:name, :size, :flops, :bytes, :fast, :stdlib, keyword_init: true)
+
+  #
+  # Runs cases, prints a table, writes JSON and compares with a baseline.
+  #
+  class Harness
+    attr_reader :results
+
+    def initialize(min_time:, repeats:, stdlib_limit:)
+      @min_time = min_time
+      @repeats = repeats
+      @stdlib_limit = stdlib_limit
+      @results = []
+    end
+
+    def run(cases)
+      puts format('%-28s %-18s %12s %9s %9s %12s', 'operation', 'size', 'time', 'GFLOPS', 'GB/s', 'vs ::Matrix')
+      cases.each do |c|
+        result = measure_case(c)
+        @results << result
+        puts row(result)
+      end
+    end
+
+    def write_json(path, metadata)
+      File.write(path, JSON.pretty_generate(metadata.merge(results: @results)))
+    end
+
+    #
+    # Results slower than baseline by more than +tolerance+ (0.2 is 20%)
+    #
+    def regressions(baseline_path, tolerance)
+      baseline = JSON.parse(File.read(baseline_path))['results']
+      expected = baseline.map { |r| [[r['name'], r['size']], r['seconds']] }.to_h
+      @results.map do |r|
+        before = expected[[r[:name], r[:size]]]
+        next if before.nil? || r[:seconds] <= before * (1 + tolerance)
+
+        r.merge(baseline_seconds: before, slowdown: r[:seconds] / before)
+      end.compact
+    end
+
+    private
+
+    def measure_case(c)
+      seconds = measure(&c.fast)
+      result = {
+        name: c.name,
+        size: c.size,
+        seconds: seconds,
+        gflops: c.flops && c.flops / seconds / 1e9,
+        gbps: c.bytes && c.bytes / seconds / 1e9
+      }
+      if c.stdlib && (c.flops.nil? || c.flops <= @stdlib_limit)
+        result[:stdlib_seconds] = measure(&c.stdlib)
+        result[:speedup] = result[:stdlib_seconds] / seconds
+      end
+      result
+    end
+
+    def clock
+      Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    end
+
+    def time_of(iterations)
+      start = clock
+      iterations.times { yield }
+      clock - start
+    end
+
+    # best of +repeats+ batches, a batch runs at least min_time / repeats
+    def measure(&block)
+      iterations = 1
+      iterations *= 2 while time_of(iterations, &block) < @min_time / @repeats && iterations < 1 << 20
+      Array.new(@repeats) { time_of(iterations, &block) / iterations }.min
+    end
+
+    def row(r)
+      speedup = r[:speedup] ? format('%.1fx', r[:speedup]) : '-'
+      format('%-28s %-18s %12s %9s %9s %12s', r[:name], r[:size], human_time(r[:seconds]),
+             r[:gflops] ? format('%.3f', r[:gflops]) : '-',
+             r[:gbps] ? format('%.3f', r[:gbps]) : '-', speedup)
+    end
+
+    def human_time(seconds)
+      return format('%.2f s', seconds) if seconds >= 1
+      return format('%.2f ms', seconds * 1e3) if seconds >= 1e-3
+      return format('%.2f us', seconds * 1e6) if seconds >= 1e-6
+
+      format('%.0f ns', seconds * 1e9)
+    end
+  end
+end
@@ -0,0 +1,321 @@
+#
+# Benchmarks of native operations of Matrix and Vector, run with `rake bench`.
+#
+# Environment:
+#   BENCH_QUICK=1         small sizes only
+#   BENCH_FILTER=regexp   run only operations with matching names
+#   BENCH_MIN_TIME=0.3    seconds spent on every measurement
+#   BENCH_OUTPUT=path     JSON results, bench/results.json by default
+#   BENCH_BASELINE=path   baseline to compare with, bench/baseline.json by default
+#   BENCH_TOLERANCE=0.2   allowed slowdown against the baseline
+#
+# With --save-baseline the results are written to the baseline instead.
+# Exits with status 1 if some operation is slower than its baseline.
+#
+require 'fast_matrix'
+require 'matrix'
+require_relative 'harness'
+
+module FastMatrixBench
+  QUICK = ENV['BENCH_QUICK'] == '1'
+  SQUARE = QUICK ? [16, 64] : [16, 64, 256, 512]
+  # rows x columns of tall matrices
+  SKINNY = QUICK ? [[1000, 8]] : [[10_000, 8], [100_000, 4]]
+  # sizes of small matrices multiplied in a batch
+  BATCH_SIZES = [2, 4, 8].freeze
+  BATCH = QUICK ? 100 : 10_000
+  VECTOR = QUICK ? [1000] : [1000, 1_000_000]
+
+  module_function
+
+  def matrix(rows, columns = rows, seed = rows * 31 + columns)
+    FastMatrix::Matrix.random(rows, columns, seed: seed)
+  end
+
+  def vector(size, seed = size)
+    FastMatrix::Vector.random(size, seed: seed)
+  end
+
+  def label(*dims)
+    dims.join('x')
+  end
+
+  def multiply_cases
+    cases = SQUARE.flat_map do |n|
+      a = matrix(n)
+      b = matrix(n, n, 1)
+      sa = a.convert
+      sb = b.convert
+      mm = { size: label(n, n, n), flops: 2.0 * n**3, bytes: 24.0 * n * n }
+      [
+        Case.new(name: 'Matrix#*', fast: -> { a * b }, stdlib: -> { sa * sb }, **mm),
+        Case.new(name: 'Matrix#strassen', fast: -> { a.strassen(b) }, **mm),
+        Case.new(name: 'Matrix#multiply_async', fast: -> { a.multiply_async(b).value }, **mm)
+      ]
+    end
+
+    cases += SKINNY.flat_map do |rows, columns|
+      tall = matrix(rows, columns)
+      wide = tall.transpose
+      other = matrix(rows, columns, 2)
+      v = vector(columns)
+      size = label(rows, columns)
+      [
+        Case.new(name: 'Matrix#* (skinny)', size: label(columns, rows, columns), flops: 2.0 * rows * columns**2,
+                 bytes: 16.0 * rows * columns, fast: -> { wide * tall }),
+        Case.new(name: 'Matrix#* (tall x vector)', size: size, flops: 2.0 * rows * columns,
+                 bytes: 8.0 * rows * (columns + 1), fast: -> { tall * v }),
+        Case.new(name: 'Matrix#syrk', size: size, flops: 1.0 * rows * columns**2,
+                 bytes: 8.0 * rows * columns, fast: -> { tall.syrk(trans: true) }),
+        Case.new(name: 'Matrix#dot_rows', size: size, flops: 2.0 * rows * columns,
+                 bytes: 8.0 * rows * (columns + 1), fast: -> { tall.dot_rows(v) }),
+        Case.new(name: 'Matrix#hadamard (skinny)', size: size, flops: 1.0 * rows * columns,
+                 bytes: 24.0 * rows * columns, fast: -> { tall.hadamard_product(other) })
+      ]
+    end
+
+    cases + BATCH_SIZES.map do |n|
+      mats = Array.new(BATCH) { |i| matrix(n, n, i) }
+      std = mats.map(&:convert)
+      Case.new(name: 'Matrix#* (batch)', size: "#{BATCH} of #{label(n, n)}", flops: 2.0 * n**3 * (BATCH - 1),
+               bytes: 24.0 * n * n * (BATCH - 1),
+               fast: -> { mats.each_cons(2) { |x, y| x * y } },
+               stdlib: -> { std.each_cons(2) { |x, y| x * y } })
+    end
+  end
+
+  # results of these operations are memoized by the matrix,
+  # a clone shares the buffer but computes them again
+  def decomposition_cases
+    SQUARE.flat_map do |n|
+      a = matrix(n) + FastMatrix::Matrix.identity(n) * n
+      s = a.convert
+      sym = a + a.transpose
+      k = [n / 8, 1].max
+      size = label(n, n)
+      [
+        Case.new(name: 'Matrix#determinant', size: size, flops: 2.0 / 3 * n**3, bytes: 8.0 * n * n,
+                 fast: -> { a.clone.determinant }, stdlib: -> { s.determinant }),
+        Case.new(name: 'Matrix#inverse', size: size, flops: 2.0 * n**3, bytes: 16.0 * n * n,
+                 fast: -> { a.clone.inverse }, stdlib: -> { s.inverse }),
+        Case.new(name: 'Matrix#**', size: "#{size} ** 8", flops: 6.0 * n**3, bytes: 24.0 * n * n,
+                 fast: -> { a**8 }, stdlib: -> { s**8 }),
+        Case.new(name: 'Matrix#symmetric_eigen', size: size, flops: 9.0 * n**3, bytes: 16.0 * n * n,
+                 fast: -> { sym.symmetric_eigen }),
+        Case.new(name: 'Matrix#top_eigen', size: "#{size} k=#{k}", bytes: 8.0 * n * n,
+                 fast: -> { sym.top_eigen(k, tol: 1e-6) })
+      ]
+    end
+  end
+
+  def convolve_cases
+    SQUARE.flat_map do |n|
+      a = matrix(n)
+      [3, 7].map do |k|
+        kernel = matrix(k)
+        Case.new(name: 'Matrix#convolve', size: "#{label(n, n)} * #{label(k, k)}",
+                 flops: 2.0 * n * n * k * k, bytes: 16.0 * n * n, fast: -> { a.convolve(kernel) })
+      end
+    end
+  end
+
+  def chain_cases
+    dims = QUICK ? [10, 200, 5, 150, 8] : [40, 1000, 20, 800, 30]
+    mats = dims.each_cons(2).map { |r, c| matrix(r, c) }
+    std = mats.map(&:convert)
+    flops = 2.0 * dims.each_cons(3).map { |x, y, z| x * y * z }.min * (mats.size - 1)
+    [
+      Case.new(name: 'Matrix.chain_multiply', size: dims.join('x'), flops: flops,
+               fast: -> { FastMatrix::Matrix.chain_multiply(*mats) }, stdlib: -> { std.reduce(:*) })
+    ]
+  end
+
+  def elementwise_cases
+    SQUARE.flat_map do |n|
+      a = matrix(n)
+      b = matrix(n, n, 1)
+      sa = a.convert
+      sb = b.convert
+      v = vector(n)
+      copy = a.clone
+      scopy = copy.convert
+      len = n * n
+      size = label(n, n)
+      unary = { size: size, flops: 1.0 * len, bytes: 16.0 * len }
+      binary = { size: size, flops: 1.0 * len, bytes: 24.0 * len }
+      [
+        Case.new(name: 'Matrix#+', fast: -> { a + b }, stdlib: -> { sa + sb }, **binary),
+        Case.new(name: 'Matrix#-', fast: -> { a - b }, stdlib: -> { sa - sb }, **binary),
+        Case.new(name: 'Matrix#+=', fast: -> { a.clone.public_send('+=', b) }, **binary),
+        Case.new(name: 'Matrix#* (scalar)', fast: -> { a * 1.0 }, stdlib: -> { sa * 1.0 }, **unary),
+        Case.new(name: 'Matrix#/ (scalar)', fast: -> { a / 1.0 }, stdlib: -> { sa / 1.0 }, **unary),
+        Case.new(name: 'Matrix#hadamard_product', fast: -> { a.hadamard_product(b) },
+                 stdlib: -> { sa.hadamard_product(sb) }, **binary),
+        Case.new(name: 'Matrix#abs', fast: -> { a.abs }, **unary),
+        Case.new(name: 'Matrix#map_fn (:exp)', fast: -> { a.map_fn(:exp) }, **unary),
+        Case.new(name: 'Matrix#map_fn (:sqrt)', fast: -> { a.abs.map_fn!(:sqrt) }, **unary),
+        Case.new(name: 'Matrix#pow', fast: -> { a.pow(2) }, **unary),
+        Case.new(name: 'Matrix#clamp', fast: -> { a.clamp(0.25, 0.75) }, **unary),
+        Case.new(name: 'Matrix#broadcast', fast: -> { a.broadcast(:+, v) }, **binary),
+        Case.new(name: 'Matrix#fill!', size: size, bytes: 8.0 * len, fast: -> { a.clone.fill!(0) }),
+        Case.new(name: 'Matrix#random!', size: size, bytes: 8.0 * len, fast: -> { a.clone.random!(seed: 1) }),
+        Case.new(name: 'Matrix#transpose', size: size, bytes: 16.0 * len,
+                 fast: -> { a.clone.transpose }, stdlib: -> { sa.transpose }),
+        Case.new(name: 'Matrix#clone', size: size, bytes: 16.0 * len, fast: -> { a.clone }),
+        Case.new(name: 'Matrix#eql?', size: size, bytes: 16.0 * len, fast: -> { a.eql?(copy) },
+                 stdlib: -> { sa.eql?(scopy) }),
+        Case.new(name: 'Matrix#>=', size: size, bytes: 16.0 * len, fast: -> { a >= b })
+      ]
+    end
+  end
+
+  def reduction_cases
+    SQUARE.flat_map do |n|
+      a = matrix(n)
+      s = a.convert
+      len = n * n
+      size = label(n, n)
+      reduce = { size: size, flops: 1.0 * len, bytes: 8.0 * len }
+      [
+        Case.new(name: 'Matrix#sum', fast: -> { a.sum }, stdlib: -> { s.sum }, **reduce),
+        Case.new(name: 'Matrix#max', fast: -> { a.max }, stdlib: -> { s.max }, **reduce),
+        Case.new(name: 'Matrix#min', fast: -> { a.min }, **reduce),
+        Case.new(name: 'Matrix#mean', fast: -> { a.mean }, **reduce),
+        Case.new(name: 'Matrix#norm', fast: -> { a.clone.norm }, **reduce),
+        Case.new(name: 'Matrix#frobenius_norm', fast: -> { a.clone.frobenius_norm }, **reduce),
+        Case.new(name: 'Matrix#trace', size: size, flops: 1.0 * n, fast: -> { a.trace }, stdlib: -> { s.trace }),
+        Case.new(name: 'Matrix#row_sums', fast: -> { a.row_sums }, **reduce),
+        Case.new(name: 'Matrix#column_sums', fast: -> { a.column_sums }, **reduce),
+        Case.new(name: 'Matrix#row_means', fast: -> { a.row_means }, **reduce),
+        Case.new(name: 'Matrix#column_means', fast: -> { a.column_means }, **reduce),
+        Case.new(name: 'Matrix#row_max', fast: -> { a.row_max }, **reduce),
+        Case.new(name: 'Matrix#row_min', fast: -> { a.row_min }, **reduce),
+        Case.new(name: 'Matrix#column_max', fast: -> { a.column_max }, **reduce),
+        Case.new(name: 'Matrix#column_min', fast: -> { a.column_min }, **reduce)
+      ]
+    end
+  end
+
+  def indexing_cases
+    SQUARE.flat_map do |n|
+      a = matrix(n)
+      s = a.convert
+      half = (0...n).step(2).to_a
+      perm = (0...n).to_a.reverse
+      size = label(n, n)
+      [
+        Case.new(name: 'Matrix#select_rows', size: size, bytes: 8.0 * n * half.size,
+                 fast: -> { a.select_rows(half) }),
+        Case.new(name: 'Matrix#select_columns', size: size, bytes: 8.0 * n * half.size,
+                 fast: -> { a.select_columns(half) }),
+        Case.new(name: 'Matrix#permute_rows', size: size, bytes: 16.0 * n * n, fast: -> { a.permute_rows(perm) }),
+        Case.new(name: 'Matrix#scatter_rows!', size: size, bytes: 8.0 * n * half.size,
+                 fast: -> { a.scatter_rows!(half, a.select_rows(half)) }),
+        Case.new(name: 'Matrix#swap_rows!', size: size, bytes: 32.0 * n, fast: -> { a.swap_rows!(0, n - 1) }),
+        Case.new(name: 'Matrix#swap_columns!', size: size, bytes: 32.0 * n, fast: -> { a.swap_columns!(0, n - 1) }),
+        Case.new(name: 'Matrix#[] (range)', size: size, bytes: 4.0 * n * n,
+                 fast: -> { a[0...n / 2, 0...n / 2] }, stdlib: -> { s.minor(0...n / 2, 0...n / 2) }),
+        Case.new(name: 'Matrix#[]', size: size, fast: -> { a[n - 1, n - 1] }, stdlib: -> { s[n - 1, n - 1] }),
+        Case.new(name: 'Matrix#to_a', size: size, fast: -> { a.to_a }, stdlib: -> { s.to_a }),
+        Case.new(name: 'Matrix#each', size: size, fast: -> { a.each {} }, stdlib: -> { s.each {} }),
+        Case.new(name: 'Matrix#map', size: size, fast: -> { a.map { |x| x } }, stdlib: -> { s.map { |x| x } }),
+        Case.new(name: 'Matrix#each_with_index', size: size, fast: -> { a.each_with_index { |_x, _i, _j| } },
+                 stdlib: -> { s.each_with_index { |_x, _i, _j| } })
+      ]
+    end
+  end
+
+  def vector_cases
+    VECTOR.flat_map do |n|
+      a = vector(n)
+      b = vector(n, 1)
+      copy = a.clone
+      sa = ::Vector.elements(a.to_a)
+      sb = ::Vector.elements(b.to_a)
+      unary = { size: n.to_s, flops: 1.0 * n, bytes: 16.0 * n }
+      binary = { size: n.to_s, flops: 1.0 * n, bytes: 24.0 * n }
+      reduce = { size: n.to_s, flops: 2.0 * n, bytes: 16.0 * n }
+      [
+        Case.new(name: 'Vector#+', fast: -> { a + b }, stdlib: -> { sa + sb }, **binary),
+        Case.new(name: 'Vector#-', fast: -> { a - b }, stdlib: -> { sa - sb }, **binary),
+        Case.new(name: 'Vector#+=', fast: -> { a.clone.public_send('+=', b) }, **binary),
+        Case.new(name: 'Vector#* (scalar)', fast: -> { a * 1.0 }, stdlib: -> { sa * 1.0 }, **unary),
+        Case.new(name: 'Vector#/ (scalar)', fast: -> { a / 1.0 }, stdlib: -> { sa / 1.0 }, **unary),
+        Case.new(name: 'Vector#hadamard_product', fast: -> { a.hadamard_product(b) }, **binary),
+        Case.new(name: 'Vector#map_fn (:exp)', fast: -> { a.map_fn(:exp) }, **unary),
+        Case.new(name: 'Vector#pow', fast: -> { a.pow(2) }, **unary),
+        Case.new(name: 'Vector#clamp', fast: -> { a.clamp(0.25, 0.75) }, **unary),
+        Case.new(name: 'Vector#dot', fast: -> { a.dot(b) }, stdlib: -> { sa.dot(sb) }, **reduce),
+        Case.new(name: 'Vector#norm', fast: -> { a.norm }, stdlib: -> { sa.norm }, **reduce),
+        Case.new(name: 'Vector#normalize', fast: -> { a.normalize }, stdlib: -> { sa.normalize }, **reduce),
+        Case.new(name: 'Vector#fill!', size: n.to_s, bytes: 8.0 * n, fast: -> { a.clone.fill!(0) }),
+        Case.new(name: 'Vector#eql?', size: n.to_s, bytes: 16.0 * n, fast: -> { a.eql?(copy) }),
+        Case.new(name: 'Vector#to_a', size: n.to_s, fast: -> { a.to_a }, stdlib: -> { sa.to_a }),
+        Case.new(name: 'Vector#each', size: n.to_s, fast: -> { a.each {} }, stdlib: -> { sa.each {} })
+      ]
+    end + outer_cases
+  end
+
+  def outer_cases
+    SQUARE.flat_map do |n|
+      a = vector(n)
+      b = vector(n, 1)
+      m = matrix(n)
+      row = FastMatrix::Matrix.row_vector(b.to_a)
+      sm = m.convert
+      sa = ::Vector.elements(a.to_a)
+      [
+        Case.new(name: 'Vector#outer', size: label(n, n), flops: 1.0 * n * n, bytes: 8.0 * n * n,
+                 fast: -> { a.outer(b) }),
+        Case.new(name: 'Vector#* (row matrix)', size: label(n, n), flops: 1.0 * n * n, bytes: 8.0 * n * n,
+                 fast: -> { a * row }),
+        Case.new(name: 'Matrix#* (vector)', size: label(n, n), flops: 2.0 * n * n, bytes: 8.0 * n * n,
+                 fast: -> { m * a }, stdlib: -> { sm * sa })
+      ]
+    end + [
+      Case.new(name: 'Vector#cross_product', size: '3',
+               fast: lambda {
+                 FastMatrix::Vector[1, 2, 3].cross_product(FastMatrix::Vector[4, 5, 6])
+               },
+               stdlib: -> { ::Vector[1, 2, 3].cross_product(::Vector[4, 5, 6]) })
+    ]
+  end
+
+  def cases
+    all = multiply_cases + decomposition_cases + chain_cases + convolve_cases + elementwise_cases +
+          reduction_cases + indexing_cases + vector_cases
+    filter = ENV['BENCH_FILTER']
+    filter ? all.select { |c| c.name.match?(Regexp.new(filter)) } : all
+  end
+
+  def main(argv)
+    save_baseline = argv.include?('--save-baseline')
+    dir = __dir__
+    baseline = ENV.fetch('BENCH_BASELINE', File.join(dir, 'baseline.json'))
+    output = save_baseline ? baseline : ENV.fetch('BENCH_OUTPUT', File.join(dir, 'results.json'))
+    tolerance = Float(ENV.fetch('BENCH_TOLERANCE', '0.2'))
+
+    harness = Harness.new(min_time: Float(ENV.fetch('BENCH_MIN_TIME', QUICK ? '0.05' : '0.3')),
+                          repeats: 5, stdlib_limit: QUICK ? 1e6 : 5e7)
+    harness.run(cases)
+    harness.write_json(output, ruby: RUBY_DESCRIPTION, fast_matrix: FastMatrix::VERSION,
+                               threads: ENV['FAST_MATRIX_NUM_THREADS'], quick: QUICK,
+                               time: Time.now.utc.to_s)
+    puts "\nResults written to #{output}"
+    return 0 if save_baseline || !File.exist?(baseline)
+
+    slower = harness.regressions(baseline, tolerance)
+    if slower.empty?
+      puts "No regressions against #{baseline} (tolerance #{(tolerance * 100).round}%)"
+      return 0
+    end
+
+    puts "\nRegressions against #{baseline} (tolerance #{(tolerance * 100).round}%):"
+    slower.each do |r|
+      puts format('  %-28s %-18s %.2fx slower', r[:name], r[:size], r[:slowdown])
+    end
+    1
+  end
+end
+
+exit FastMatrixBench.main(ARGV) if $PROGRAM_NAME == __FILE__
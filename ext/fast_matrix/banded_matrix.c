@@ -0,0 +1,512 @@
+#include "banded_matrix.h"
+#include "c_array_operations.h"
+#include "errors.h"
+#include "matrix.h"
+#include "vector.h"
+#include <limits.h>
+#include <math.h>
+
+VALUE cBandedMatrix;
+VALUE cTridiagonalMatrix;
+
+void banded_matrix_free(void* data);
+size_t banded_matrix_size(const void* data);
+
+const rb_data_type_t banded_matrix_type =
+{
+    .wrap_struct_name = "banded_matrix",
+    .function =
+    {
+        .dmark = NULL,
+        .dfree = banded_matrix_free,
+        .dsize = banded_matrix_size,
+    },
+    .data = NULL,
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_FROZEN_SHAREABLE,
+#else
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+#endif
+};
+
+void banded_matrix_free(void* data)
+{
+    free(((*(struct banded_matrix*)data)).data);
+    free(data);
+}
+
+size_t banded_matrix_size(const void* data)
+{
+    return sizeof(struct banded_matrix);
+}
+
+VALUE banded_matrix_alloc(VALUE self)
+{
+    struct banded_matrix* mtx = malloc(sizeof(struct banded_matrix));
+    mtx->data = NULL;
+    return TypedData_Wrap_Struct(self, &banded_matrix_type, mtx);
+}
+
+void c_banded_matrix_init(struct banded_matrix* mtr, int n, int kl, int ku)
+{
+    mtr->n = n;
+    mtr->kl = kl;
+    mtr->ku = ku;
+    mtr->data = calloc((size_t)n * (kl + ku + 1), sizeof(double));
+}
+
+VALUE banded_matrix_initialize(VALUE self, VALUE size, VALUE lower, VALUE upper)
+{
+    struct banded_matrix* data;
+    int n = raise_rb_value_to_int(size);
+    int kl = raise_rb_value_to_int(lower);
+    int ku = raise_rb_value_to_int(upper);
+
+    if(n <= 0)
+        rb_raise(fm_eIndexError, "Size cannot be negative or zero");
+    if(kl < 0 || ku < 0)
+        rb_raise(fm_eIndexError, "Bandwidth cannot be negative");
+
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, data);
+
+    c_banded_matrix_init(data, n, kl, ku);
+
+    return self;
+}
+
+VALUE tridiagonal_matrix_initialize(VALUE self, VALUE size)
+{
+    return banded_matrix_initialize(self, size, INT2NUM(1), INT2NUM(1));
+}
+
+//  []=
+VALUE banded_matrix_set(VALUE self, VALUE row, VALUE column, VALUE v)
+{
+    rb_check_frozen(self);
+    int i = raise_rb_value_to_int(row);
+    int j = raise_rb_value_to_int(column);
+    double x = raise_rb_value_to_double(v);
+
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    i = (i < 0) ? A->n + i : i;
+    j = (j < 0) ? A->n + j : j;
+
+    raise_check_range(i, 0, A->n);
+    raise_check_range(j, 0, A->n);
+    if(j - i < -A->kl || j - i > A->ku)
+        rb_raise(fm_eIndexError, "Index out of band");
+
+    A->data[(size_t)(A->kl + A->ku + 1) * i + (j - i + A->kl)] = x;
+    return v;
+}
+
+//  []
+VALUE banded_matrix_get(VALUE self, VALUE row, VALUE column)
+{
+    int i = raise_rb_value_to_int(row);
+    int j = raise_rb_value_to_int(column);
+
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    i = (i < 0) ? A->n + i : i;
+    j = (j < 0) ? A->n + j : j;
+
+    if(i < 0 || j < 0 || i >= A->n || j >= A->n)
+        return Qnil;
+    if(j - i < -A->kl || j - i > A->ku)
+        return DBL2NUM(0);
+
+    return DBL2NUM(A->data[(size_t)(A->kl + A->ku + 1) * i + (j - i + A->kl)]);
+}
+
+VALUE banded_matrix_row_count(VALUE self)
+{
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    return INT2NUM(A->n);
+}
+
+VALUE banded_matrix_lower_bandwidth(VALUE self)
+{
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    return INT2NUM(A->kl);
+}
+
+VALUE banded_matrix_upper_bandwidth(VALUE self)
+{
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    return INT2NUM(A->ku);
+}
+
+// offset of the first element of diagonal and its length
+static int banded_diagonal_bounds(struct banded_matrix* A, int offset, int* first_row)
+{
+    if(offset < -A->kl || offset > A->ku)
+        rb_raise(fm_eIndexError, "Diagonal out of band");
+
+    *first_row = (offset < 0) ? -offset : 0;
+    int len = A->n - abs(offset);
+    return len > 0 ? len : 0;
+}
+
+VALUE banded_matrix_diagonal(VALUE self, VALUE offset)
+{
+    int k = raise_rb_value_to_int(offset);
+
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    int first;
+    int len = banded_diagonal_bounds(A, k, &first);
+    if(len == 0)
+        rb_raise(fm_eIndexError, "Diagonal is empty");
+
+    struct vector* R;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+    c_vector_init(R, len);
+
+    size_t w = A->kl + A->ku + 1;
+    for(int t = 0; t < len; ++t)
+        R->data[t] = A->data[w * (first + t) + (k + A->kl)];
+
+    return result;
+}
+
+VALUE banded_matrix_set_diagonal(VALUE self, VALUE offset, VALUE values)
+{
+    rb_check_frozen(self);
+    int k = raise_rb_value_to_int(offset);
+
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    int first;
+    int len = banded_diagonal_bounds(A, k, &first);
+    size_t w = A->kl + A->ku + 1;
+    double* p = A->data + w * first + (k + A->kl);
+
+    if(RB_TYPE_P(values, T_ARRAY))
+    {
+        if(RARRAY_LEN(values) != len)
+            rb_raise(fm_eIndexError, "Wrong diagonal size");
+        for(int t = 0; t < len; ++t)
+            p[w * t] = raise_rb_value_to_double(rb_ary_entry(values, t));
+    }
+    else if(rb_obj_is_kind_of(values, cVector))
+    {
+        struct vector* V;
+        TypedData_Get_Struct(values, struct vector, &vector_type, V);
+        if(V->n != len)
+            rb_raise(fm_eIndexError, "Wrong diagonal size");
+        for(int t = 0; t < len; ++t)
+            p[w * t] = V->data[t];
+    }
+    else
+    {
+        double d = raise_rb_value_to_double(values);
+        for(int t = 0; t < len; ++t)
+            p[w * t] = d;
+    }
+
+    return self;
+}
+
+// A - band matrix n x n
+// V - vector n
+// R - vector n
+void c_banded_matrix_vector_multiply(int n, int kl, int ku, const double* A, const double* V, double* R)
+{
+    size_t w = kl + ku + 1;
+    for(int i = 0; i < n; ++i)
+    {
+        const double* p_a = A + w * i + kl - i;
+        int begin = (i - kl > 0) ? i - kl : 0;
+        int end = (i + ku < n - 1) ? i + ku : n - 1;
+        double sum = 0;
+        for(int j = begin; j <= end; ++j)
+            sum += p_a[j] * V[j];
+        R[i] = sum;
+    }
+}
+
+// the Thomas algorithm is stable without pivoting only for these matrices
+static bool c_tridiagonal_dominant(int n, const double* A)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        const double* row = A + 3 * (size_t)i;
+        double off = (i > 0 ? fabs(row[0]) : 0) + (i < n - 1 ? fabs(row[2]) : 0);
+        if(!(fabs(row[1]) >= off))
+            return false;
+    }
+    return true;
+}
+
+// Thomas algorithm, no pivoting, returns false on zero pivot
+static bool c_tridiagonal_solve(int n, const double* A, const double* B, double* X)
+{
+    double* c = malloc(n * sizeof(double));
+    bool result = true;
+
+    for(int i = 0; i < n && result; ++i)
+    {
+        const double* row = A + 3 * (size_t)i;
+        double denominator = row[1];
+        double rhs = B[i];
+        if(i > 0)
+        {
+            denominator -= row[0] * c[i - 1];
+            rhs -= row[0] * X[i - 1];
+        }
+        if(denominator == 0)
+            result = false;
+        else
+        {
+            c[i] = row[2] / denominator;
+            X[i] = rhs / denominator;
+        }
+    }
+
+    if(result)
+        for(int i = n - 2; i >= 0; --i)
+            X[i] -= c[i] * X[i + 1];
+
+    free(c);
+    return result;
+}
+
+// Gaussian elimination with partial pivoting, row i of the work copy
+// stores columns from i - kl to i + kl + ku to hold fill-in of pivoting
+static bool c_banded_lu_solve(int n, int kl, int ku, const double* A, const double* B, double* X)
+{
+    size_t w = kl + ku + 1;
+    size_t ww = 2 * kl + ku + 1;
+    double* W = calloc(ww * n, sizeof(double));
+    bool result = true;
+
+    for(int i = 0; i < n; ++i)
+        copy_d_array(w, A + w * i, W + ww * i);
+    copy_d_array(n, B, X);
+
+    for(int k = 0; k < n && result; ++k)
+    {
+        int last_row = (k + kl < n - 1) ? k + kl : n - 1;
+        int last_column = (k + kl + ku < n - 1) ? k + kl + ku : n - 1;
+
+        int p = k;
+        for(int i = k + 1; i <= last_row; ++i)
+            if(fabs(W[ww * i + (k - i + kl)]) > fabs(W[ww * p + (k - p + kl)]))
+                p = i;
+
+        double* p_k = W + ww * k + kl - k;
+        if(p != k)
+        {
+            double* p_p = W + ww * p + kl - p;
+            for(int j = k; j <= last_column; ++j)
+            {
+                double t = p_k[j];
+                p_k[j] = p_p[j];
+                p_p[j] = t;
+            }
+            double t = X[k];
+            X[k] = X[p];
+            X[p] = t;
+        }
+
+        double pivot = p_k[k];
+        if(pivot == 0)
+        {
+            result = false;
+            break;
+        }
+
+        for(int i = k + 1; i <= last_row; ++i)
+        {
+            double* p_i = W + ww * i + kl - i;
+            double f = p_i[k] / pivot;
+            if(f == 0)
+                continue;
+            p_i[k] = 0;
+            for(int j = k + 1; j <= last_column; ++j)
+                p_i[j] -= f * p_k[j];
+            X[i] -= f * X[k];
+        }
+    }
+
+    if(result)
+        for(int i = n - 1; i >= 0; --i)
+        {
+            const double* p_i = W + ww * i + kl - i;
+            int last_column = (i + kl + ku < n - 1) ? i + kl + ku : n - 1;
+            double sum = X[i];
+            for(int j = i + 1; j <= last_column; ++j)
+                sum -= p_i[j] * X[j];
+            X[i] = sum / p_i[i];
+        }
+
+    free(W);
+    return result;
+}
+
+bool c_banded_solve(int n, int kl, int ku, const double* A, const double* B, double* X)
+{
+    if(kl == 1 && ku == 1 && c_tridiagonal_dominant(n, A) && c_tridiagonal_solve(n, A, B, X))
+        return true;
+    return c_banded_lu_solve(n, kl, ku, A, B, X);
+}
+
+VALUE banded_matrix_solve(VALUE self, VALUE other)
+{
+    struct banded_matrix* A;
+    struct vector* B;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    TypedData_Get_Struct(other, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Matrix size differs from vector size");
+
+    struct vector* X;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, X);
+
+    c_vector_init(X, A->n);
+    if(!c_banded_solve(A->n, A->kl, A->ku, A->data, B->data, X->data))
+        rb_raise(fm_eError, "Matrix is singular");
+
+    return result;
+}
+
+VALUE banded_matrix_multiply_mv(VALUE self, VALUE other)
+{
+    struct banded_matrix* A;
+    struct vector* V;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    TypedData_Get_Struct(other, struct vector, &vector_type, V);
+
+    if(A->n != V->n)
+        rb_raise(fm_eIndexError, "Matrix columns differs from vector size");
+
+    struct vector* R;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+
+    c_vector_init(R, A->n);
+    c_banded_matrix_vector_multiply(A->n, A->kl, A->ku, A->data, V->data, R->data);
+
+    return result;
+}
+
+VALUE banded_matrix_copy(VALUE self)
+{
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    struct banded_matrix* R;
+    VALUE result = TypedData_Make_Struct(rb_obj_class(self), struct banded_matrix, &banded_matrix_type, R);
+
+    c_banded_matrix_init(R, A->n, A->kl, A->ku);
+    size_t w = A->kl + A->ku + 1;
+    for(int i = 0; i < A->n; ++i)
+        copy_d_array(w, A->data + w * i, R->data + w * i);
+
+    return result;
+}
+
+VALUE banded_matrix_multiply_mn(VALUE self, VALUE value)
+{
+    double d = raise_rb_value_to_double(value);
+    VALUE result = banded_matrix_copy(self);
+
+    struct banded_matrix* R;
+    TypedData_Get_Struct(result, struct banded_matrix, &banded_matrix_type, R);
+
+    size_t w = R->kl + R->ku + 1;
+    for(int i = 0; i < R->n; ++i)
+        multiply_d_array(w, R->data + w * i, d);
+
+    return result;
+}
+
+VALUE banded_matrix_multiply(VALUE self, VALUE v)
+{
+    if(RB_FLOAT_TYPE_P(v) || FIXNUM_P(v)
+        || RB_TYPE_P(v, T_BIGNUM))
+        return banded_matrix_multiply_mn(self, v);
+    if(RBASIC_CLASS(v) == cVector)
+        return banded_matrix_multiply_mv(self, v);
+    rb_raise(fm_eTypeError, "Invalid klass for multiply");
+}
+
+VALUE banded_matrix_to_matrix(VALUE self)
+{
+    struct banded_matrix* A;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+
+    int n = A->n;
+    if((double)n * n > INT_MAX)
+        rb_raise(fm_eIndexError, "Matrix is too large to be dense");
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+
+    c_matrix_init(R, n, n);
+    fill_d_array(n * n, R->data, 0);
+
+    size_t w = A->kl + A->ku + 1;
+    for(int i = 0; i < n; ++i)
+    {
+        const double* p_a = A->data + w * i + A->kl - i;
+        int begin = (i - A->kl > 0) ? i - A->kl : 0;
+        int end = (i + A->ku < n - 1) ? i + A->ku : n - 1;
+        for(int j = begin; j <= end; ++j)
+            R->data[j + n * i] = p_a[j];
+    }
+
+    return result;
+}
+
+VALUE banded_matrix_equal(VALUE self, VALUE value)
+{
+    struct banded_matrix* A;
+    struct banded_matrix* B;
+    TypedData_Get_Struct(self, struct banded_matrix, &banded_matrix_type, A);
+    TypedData_Get_Struct(value, struct banded_matrix, &banded_matrix_type, B);
+
+    if(A->n != B->n || A->kl != B->kl || A->ku != B->ku)
+        return Qfalse;
+
+    size_t w = A->kl + A->ku + 1;
+    for(int i = 0; i < A->n; ++i)
+        if(!equal_d_arrays(w, A->data + w * i, B->data + w * i))
+            return Qfalse;
+    return Qtrue;
+}
+
+void init_fm_banded_matrix()
+{
+    VALUE  mod = rb_define_module("FastMatrix");
+    cBandedMatrix = rb_define_class_under(mod, "BandedMatrix", rb_cObject);
+    cTridiagonalMatrix = rb_define_class_under(mod, "TridiagonalMatrix", cBandedMatrix);
+
+    rb_define_alloc_func(cBandedMatrix, banded_matrix_alloc);
+
+    rb_define_method(cBandedMatrix, "initialize", banded_matrix_initialize, 3);
+    rb_define_method(cBandedMatrix, "[]", banded_matrix_get, 2);
+    rb_define_method(cBandedMatrix, "[]=", banded_matrix_set, 3);
+    rb_define_method(cBandedMatrix, "row_count", banded_matrix_row_count, 0);
+    rb_define_method(cBandedMatrix, "column_count", banded_matrix_row_count, 0);
+    rb_define_method(cBandedMatrix, "lower_bandwidth", banded_matrix_lower_bandwidth, 0);
+    rb_define_method(cBandedMatrix, "upper_bandwidth", banded_matrix_upper_bandwidth, 0);
+    rb_define_method(cBandedMatrix, "diagonal", banded_matrix_diagonal, 1);
+    rb_define_method(cBandedMatrix, "set_diagonal", banded_matrix_set_diagonal, 2);
+    rb_define_method(cBandedMatrix, "*", banded_matrix_multiply, 1);
+    rb_define_method(cBandedMatrix, "solve", banded_matrix_solve, 1);
+    rb_define_method(cBandedMatrix, "clone", banded_matrix_copy, 0);
+    rb_define_method(cBandedMatrix, "to_matrix", banded_matrix_to_matrix, 0);
+    rb_define_method(cBandedMatrix, "eql?", banded_matrix_equal, 1);
+
+    rb_define_method(cTridiagonalMatrix, "initialize", tridiagonal_matrix_initialize, 1);
+}
@@ -0,0 +1,32 @@
+#ifndef FAST_MATRIX_BANDED_MATRIX_H
+#define FAST_MATRIX_BANDED_MATRIX_H 1
+
+#include "ruby.h"
+#include <stdbool.h>
+
+extern VALUE cBandedMatrix;
+extern VALUE cTridiagonalMatrix;
+extern const rb_data_type_t banded_matrix_type;
+
+// square band matrix n x n with kl subdiagonals and ku superdiagonals,
+// row i stores columns from i - kl to i + ku
+//   A(i, j) = data[(kl + ku + 1) * i + (j - i + kl)]
+// elements out of the matrix in the first and the last rows are zero
+struct banded_matrix
+{
+    int n;
+    int kl;
+    int ku;
+    double* data;
+};
+
+void c_banded_matrix_init(struct banded_matrix* mtr, int n, int kl, int ku);
+
+// R = A * V
+void c_banded_matrix_vector_multiply(int n, int kl, int ku, const double* A, const double* V, double* R);
+// solve A * X = B, returns false if A is singular
+bool c_banded_solve(int n, int kl, int ku, const double* A, const double* B, double* X);
+
+void init_fm_banded_matrix();
+
+#endif /* FAST_MATRIX_BANDED_MATRIX_H */
@@ -0,0 +1,290 @@
+#include "block.h"
+#include "c_array_operations.h"
+#include "errors.h"
+#include "matrix.h"
+#include "parallel.h"
+#include <limits.h>
+#include <string.h>
+
+struct block_job
+{
+    int m;
+    double* R;
+    int bm;
+    int bn;
+    const double* B;
+    int tasks;
+
+    //  Kronecker product only
+    int am;
+    const double* A;
+};
+
+static void put_block_task(void* data, int task)
+{
+    struct block_job* job = data;
+    int begin = (long)job->bn * task / job->tasks;
+    int end = (long)job->bn * (task + 1) / job->tasks;
+
+    for(int i = begin; i < end; ++i)
+        memcpy(job->R + (size_t)job->m * i, job->B + (size_t)job->bm * i, job->bm * sizeof(double));
+}
+
+void c_matrix_put_block(int m, double* R, int row, int column, int bm, int bn, const double* B)
+{
+    double* start = R + (size_t)m * row + column;
+    if(bm == m)
+    {
+        copy_d_array(bm * bn, B, start);
+        return;
+    }
+
+    struct block_job job = { .m = m, .R = start, .bm = bm, .bn = bn, .B = B };
+    job.tasks = parallel_tasks((long)bm * bn, bn);
+    if(job.tasks == 1)
+        put_block_task(&job, 0);
+    else
+        parallel_for(job.tasks, put_block_task, &job);
+}
+
+//  every row of A gives bn rows of R
+static void kronecker_task(void* data, int task)
+{
+    struct block_job* job = data;
+    int an = job->m;
+    int begin = (long)an * task / job->tasks;
+    int end = (long)an * (task + 1) / job->tasks;
+    int am = job->am;
+    int bm = job->bm;
+    int rm = am * bm;
+
+    for(int i = begin; i < end; ++i)
+        for(int k = 0; k < job->bn; ++k)
+        {
+            double* r = job->R + (size_t)rm * (i * job->bn + k);
+            const double* b = job->B + (size_t)bm * k;
+            for(int j = 0; j < am; ++j)
+            {
+                double a = job->A[j + (size_t)am * i];
+                double* p_r = r + (size_t)bm * j;
+                for(int l = 0; l < bm; ++l)
+                    p_r[l] = a * b[l];
+            }
+        }
+}
+
+void c_matrix_kronecker(int am, int an, const double* A, int bm, int bn, const double* B, double* R)
+{
+    struct block_job job = { .m = an, .R = R, .bm = bm, .bn = bn, .B = B, .am = am, .A = A };
+    job.tasks = parallel_tasks((long)am * an * bm * bn, an);
+    if(job.tasks == 1)
+        kronecker_task(&job, 0);
+    else
+        parallel_for(job.tasks, kronecker_task, &job);
+}
+
+static struct matrix* block_arg(VALUE v)
+{
+    struct matrix* M;
+    TypedData_Get_Struct(v, struct matrix, &matrix_type, M);
+    return M;
+}
+
+static VALUE block_result(int m, int n, struct matrix** R)
+{
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, *R);
+    c_matrix_init(*R, m, n);
+    return result;
+}
+
+static int block_size_add(int a, int b)
+{
+    if(b > INT_MAX - a)
+        rb_raise(fm_eIndexError, "Matrix is too large");
+    return a + b;
+}
+
+VALUE matrix_s_vstack(int argc, VALUE* argv, VALUE klass)
+{
+    rb_check_arity(argc, 1, UNLIMITED_ARGUMENTS);
+    int m = block_arg(argv[0])->m;
+    int n = 0;
+    for(int t = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        if(M->m != m)
+            rb_raise(fm_eIndexError, "Different columns count");
+        n = block_size_add(n, M->n);
+    }
+
+    struct matrix* R;
+    VALUE result = block_result(m, n, &R);
+    for(int t = 0, row = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        c_matrix_put_block(m, R->data, row, 0, M->m, M->n, M->data);
+        row += M->n;
+    }
+    return result;
+}
+
+VALUE matrix_s_hstack(int argc, VALUE* argv, VALUE klass)
+{
+    rb_check_arity(argc, 1, UNLIMITED_ARGUMENTS);
+    int n = block_arg(argv[0])->n;
+    int m = 0;
+    for(int t = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        if(M->n != n)
+            rb_raise(fm_eIndexError, "Different rows count");
+        m = block_size_add(m, M->m);
+    }
+
+    struct matrix* R;
+    VALUE result = block_result(m, n, &R);
+    for(int t = 0, column = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        c_matrix_put_block(m, R->data, 0, column, M->m, M->n, M->data);
+        column += M->m;
+    }
+    return result;
+}
+
+// blocks is an array of block rows, every block row is an array of matrices;
+// blocks of a block row have the same rows count, blocks of a block column
+// have the same columns count
+VALUE matrix_s_block_matrix(VALUE klass, VALUE blocks)
+{
+    Check_Type(blocks, T_ARRAY);
+    long rows = RARRAY_LEN(blocks);
+    if(rows == 0)
+        rb_raise(fm_eIndexError, "No blocks");
+
+    VALUE first = rb_ary_entry(blocks, 0);
+    Check_Type(first, T_ARRAY);
+    long columns = RARRAY_LEN(first);
+    if(columns == 0)
+        rb_raise(fm_eIndexError, "No blocks");
+
+    int m = 0;
+    int n = 0;
+    for(long j = 0; j < columns; ++j)
+        m = block_size_add(m, block_arg(rb_ary_entry(first, j))->m);
+    for(long i = 0; i < rows; ++i)
+    {
+        VALUE line = rb_ary_entry(blocks, i);
+        Check_Type(line, T_ARRAY);
+        if(RARRAY_LEN(line) != columns)
+            rb_raise(fm_eIndexError, "Block rows have different blocks count");
+
+        int line_n = block_arg(rb_ary_entry(line, 0))->n;
+        for(long j = 0; j < columns; ++j)
+        {
+            struct matrix* M = block_arg(rb_ary_entry(line, j));
+            if(M->n != line_n)
+                rb_raise(fm_eIndexError, "Blocks of a block row have different rows count");
+            if(M->m != block_arg(rb_ary_entry(first, j))->m)
+                rb_raise(fm_eIndexError, "Blocks of a block column have different columns count");
+        }
+        n = block_size_add(n, line_n);
+    }
+
+    struct matrix* R;
+    VALUE result = block_result(m, n, &R);
+    for(long i = 0, row = 0; i < rows; ++i)
+    {
+        VALUE line = rb_ary_entry(blocks, i);
+        int column = 0;
+        struct matrix* M = NULL;
+        for(long j = 0; j < columns; ++j)
+        {
+            M = block_arg(rb_ary_entry(line, j));
+            c_matrix_put_block(m, R->data, row, column, M->m, M->n, M->data);
+            column += M->m;
+        }
+        row += M->n;
+    }
+    return result;
+}
+
+VALUE matrix_s_block_diagonal(int argc, VALUE* argv, VALUE klass)
+{
+    rb_check_arity(argc, 1, UNLIMITED_ARGUMENTS);
+    int m = 0;
+    int n = 0;
+    for(int t = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        m = block_size_add(m, M->m);
+        n = block_size_add(n, M->n);
+    }
+
+    struct matrix* R;
+    VALUE result = block_result(m, n, &R);
+    fill_d_array(m * n, R->data, 0);
+    for(int t = 0, row = 0, column = 0; t < argc; ++t)
+    {
+        struct matrix* M = block_arg(argv[t]);
+        c_matrix_put_block(m, R->data, row, column, M->m, M->n, M->data);
+        row += M->n;
+        column += M->m;
+    }
+    return result;
+}
+
+VALUE matrix_kronecker(VALUE self, VALUE other)
+{
+    struct matrix* A = block_arg(self);
+    struct matrix* B = block_arg(other);
+
+    if(A->m > INT_MAX / B->m || A->n > INT_MAX / B->n)
+        rb_raise(fm_eIndexError, "Matrix is too large");
+
+    struct matrix* R;
+    VALUE result = block_result(A->m * B->m, A->n * B->n, &R);
+    c_matrix_kronecker(A->m, A->n, A->data, B->m, B->n, B->data, R->data);
+    return result;
+}
+
+// n x n matrix with values on the diagonal, sizes are checked by the Ruby wrappers
+VALUE matrix_s_diagonal(VALUE klass, VALUE values)
+{
+    Check_Type(values, T_ARRAY);
+    int n = (int)RARRAY_LEN(values);
+
+    struct matrix* R;
+    VALUE result = block_result(n, n, &R);
+    fill_d_array(n * n, R->data, 0);
+    for(int i = 0; i < n; ++i)
+        R->data[i + n * i] = raise_rb_value_to_double(rb_ary_entry(values, i));
+    return result;
+}
+
+VALUE matrix_s_scalar(VALUE klass, VALUE size, VALUE value)
+{
+    int n = raise_rb_value_to_int(size);
+    double d = raise_rb_value_to_double(value);
+
+    struct matrix* R;
+    VALUE result = block_result(n, n, &R);
+    fill_d_array(n * n, R->data, 0);
+    for(int i = 0; i < n; ++i)
+        R->data[i + n * i] = d;
+    return result;
+}
+
+void init_fm_block()
+{
+    VALUE singleton = rb_singleton_class(cMatrix);
+
+    rb_define_singleton_method(cMatrix, "vstack", matrix_s_vstack, -1);
+    rb_define_singleton_method(cMatrix, "hstack", matrix_s_hstack, -1);
+    rb_define_singleton_method(cMatrix, "block_matrix", matrix_s_block_matrix, 1);
+    rb_define_singleton_method(cMatrix, "block_diagonal", matrix_s_block_diagonal, -1);
+    rb_define_private_method(singleton, "diagonal_impl", matrix_s_diagonal, 1);
+    rb_define_private_method(singleton, "scalar_impl", matrix_s_scalar, 2);
+
+    rb_define_method(cMatrix, "kronecker", matrix_kronecker, 1);
+}
@@ -0,0 +1,19 @@
+#ifndef FAST_MATRIX_BLOCK_H
+#define FAST_MATRIX_BLOCK_H 1
+
+#include "ruby.h"
+
+// copies B into R so that B[0, 0] lands at R[row, column]
+// R - matrix m x *
+// B - matrix bm x bn
+void c_matrix_put_block(int m, double* R, int row, int column, int bm, int bn, const double* B);
+
+// Kronecker product
+// A - matrix am x an
+// B - matrix bm x bn
+// R - matrix (am * bm) x (an * bn)
+void c_matrix_kronecker(int am, int an, const double* A, int bm, int bn, const double* B, double* R);
+
+void init_fm_block();
+
+#endif /* FAST_MATRIX_BLOCK_H */
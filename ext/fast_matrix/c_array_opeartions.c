@@ -1,66 +1,639 @@
-#include "c_array_operations.h"
-#include "math.h"
-
-void fill_d_array(int len, double* a, double v)
-{
-    for(int i = 0; i < len; ++i)
-        a[i] = v;
-}
-
-void multiply_d_array(int len, double* a, double v)
-{
-    for(int i = 0; i < len; ++i)
-        a[i] *= v;
-}
-
-void copy_d_array(int len, const double* input, double* output)
-{
-    for(int i = 0; i < len; ++i)
-        output[i] = input[i];
-}
-
-void add_d_arrays_to_result(int len, const double* a1, const double* a2, double* result)
-{
-    for(int i = 0; i < len; ++i)
-        result[i] = a1[i] + a2[i];
-}
-
-void add_d_arrays_to_first(int len, double* sum, const double* added)
-{
-    for(int i = 0; i < len; ++i)
-        sum[i] += added[i];
-}
-
-void sub_d_arrays_to_result(int len, const double* dec, const double* sub, double* dif)
-{
-    for(int i = 0; i < len; ++i)
-        dif[i] = dec[i] - sub[i];
-}
-
-void sub_d_arrays_to_first(int len, double* dif, const double* sub)
-{
-    for(int i = 0; i < len; ++i)
-        dif[i] -= sub[i];
-}
-
-bool equal_d_arrays(int len, const double* A, const double* B)
-{
-    for(int i = 0; i < len; ++i)
-        if(A[i] != B[i])
-            return false;
-    return true;
-}
-
-void abs_d_array(int len, const double* A, double* B)
-{
-    for(int i = 0; i < len; ++i)
-        B[i] = fabs(A[i]);
-}
-
-bool greater_or_equal_d_array(int len, const double* A, const double* B)
-{
-    for(int i = 0; i < len; ++i)
-        if(A[i] < B[i])
-            return false;
-    return true;
-}
+#include "c_array_operations.h"
+#include "parallel.h"
+#include "math.h"
+#include <stdlib.h>
+#include <string.h>
+
+// comparisons check the shared result after every block of this size
+#define COMPARE_BLOCK 4096
+// pairwise summation switches to a plain loop on blocks of this size
+#define PAIRWISE_BLOCK 128
+
+struct array_job
+{
+    int len;
+    int tasks;
+    const double* a;
+    const double* b;
+    double* r;
+    double v;
+    double w;
+    int function;
+    int result;
+    double (*block)(int len, const double* a, double p);
+    double (*combine)(double x, double y);
+    double partial[PARALLEL_MAX_TASKS];
+};
+
+static void job_range(const struct array_job* job, int task, int* begin, int* end)
+{
+    *begin = (int)((long long)job->len * task / job->tasks);
+    *end = (int)((long long)job->len * (task + 1) / job->tasks);
+}
+
+static void run_array_job(struct array_job* job, void (*fn)(void* arg, int task))
+{
+    job->result = true;
+    //  every task gets at least half of the threshold
+    job->tasks = parallel_tasks(job->len, job->len / (PARALLEL_THRESHOLD / 2));
+    if(job->tasks == 1)
+        fn(job, 0);
+    else
+        parallel_for(job->tasks, fn, job);
+}
+
+static void fill_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    double v = job->v;
+    double* a = job->r;
+    for(int i = begin; i < end; ++i)
+        a[i] = v;
+}
+
+void fill_d_array(int len, double* a, double v)
+{
+    struct array_job job = { .len = len, .r = a, .v = v };
+    run_array_job(&job, fill_task);
+}
+
+static void multiply_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    double v = job->v;
+    double* a = job->r;
+    for(int i = begin; i < end; ++i)
+        a[i] *= v;
+}
+
+void multiply_d_array(int len, double* a, double v)
+{
+    struct array_job job = { .len = len, .r = a, .v = v };
+    run_array_job(&job, multiply_task);
+}
+
+static void divide_task_by_value(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    double v = job->v;
+    double* a = job->r;
+    for(int i = begin; i < end; ++i)
+        a[i] /= v;
+}
+
+void divide_d_array(int len, double* a, double v)
+{
+    struct array_job job = { .len = len, .r = a, .v = v };
+    run_array_job(&job, divide_task_by_value);
+}
+
+static void copy_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* input = job->a;
+    double* output = job->r;
+    for(int i = begin; i < end; ++i)
+        output[i] = input[i];
+}
+
+void copy_d_array(int len, const double* input, double* output)
+{
+    struct array_job job = { .len = len, .a = input, .r = output };
+    run_array_job(&job, copy_task);
+}
+
+static void add_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* a1 = job->a;
+    const double* a2 = job->b;
+    double* result = job->r;
+    for(int i = begin; i < end; ++i)
+        result[i] = a1[i] + a2[i];
+}
+
+void add_d_arrays_to_result(int len, const double* a1, const double* a2, double* result)
+{
+    struct array_job job = { .len = len, .a = a1, .b = a2, .r = result };
+    run_array_job(&job, add_task);
+}
+
+void add_d_arrays_to_first(int len, double* sum, const double* added)
+{
+    add_d_arrays_to_result(len, sum, added, sum);
+}
+
+static void sub_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* dec = job->a;
+    const double* sub = job->b;
+    double* dif = job->r;
+    for(int i = begin; i < end; ++i)
+        dif[i] = dec[i] - sub[i];
+}
+
+void sub_d_arrays_to_result(int len, const double* dec, const double* sub, double* dif)
+{
+    struct array_job job = { .len = len, .a = dec, .b = sub, .r = dif };
+    run_array_job(&job, sub_task);
+}
+
+void sub_d_arrays_to_first(int len, double* dif, const double* sub)
+{
+    sub_d_arrays_to_result(len, dif, sub, dif);
+}
+
+static void equal_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    const double* B = job->b;
+    for(int block = begin; block < end; block += COMPARE_BLOCK)
+    {
+        if(!__atomic_load_n(&job->result, __ATOMIC_RELAXED))
+            return;
+        int block_end = (block + COMPARE_BLOCK < end) ? block + COMPARE_BLOCK : end;
+        for(int i = block; i < block_end; ++i)
+            if(A[i] != B[i])
+            {
+                __atomic_store_n(&job->result, false, __ATOMIC_RELAXED);
+                return;
+            }
+    }
+}
+
+bool equal_d_arrays(int len, const double* A, const double* B)
+{
+    struct array_job job = { .len = len, .a = A, .b = B };
+    run_array_job(&job, equal_task);
+    return job.result;
+}
+
+static void abs_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    double* B = job->r;
+    for(int i = begin; i < end; ++i)
+        B[i] = fabs(A[i]);
+}
+
+void abs_d_array(int len, const double* A, double* B)
+{
+    struct array_job job = { .len = len, .a = A, .r = B };
+    run_array_job(&job, abs_task);
+}
+
+static void greater_or_equal_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    const double* B = job->b;
+    for(int block = begin; block < end; block += COMPARE_BLOCK)
+    {
+        if(!__atomic_load_n(&job->result, __ATOMIC_RELAXED))
+            return;
+        int block_end = (block + COMPARE_BLOCK < end) ? block + COMPARE_BLOCK : end;
+        for(int i = block; i < block_end; ++i)
+            if(A[i] < B[i])
+            {
+                __atomic_store_n(&job->result, false, __ATOMIC_RELAXED);
+                return;
+            }
+    }
+}
+
+bool greater_or_equal_d_array(int len, const double* A, const double* B)
+{
+    struct array_job job = { .len = len, .a = A, .b = B };
+    run_array_job(&job, greater_or_equal_task);
+    return job.result;
+}
+
+static void hadamard_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* a1 = job->a;
+    const double* a2 = job->b;
+    double* result = job->r;
+    for(int i = begin; i < end; ++i)
+        result[i] = a1[i] * a2[i];
+}
+
+void hadamard_d_arrays_to_result(int len, const double* a1, const double* a2, double* result)
+{
+    struct array_job job = { .len = len, .a = a1, .b = a2, .r = result };
+    run_array_job(&job, hadamard_task);
+}
+
+static void divide_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* a1 = job->a;
+    const double* a2 = job->b;
+    double* result = job->r;
+    for(int i = begin; i < end; ++i)
+        result[i] = a1[i] / a2[i];
+}
+
+void divide_d_arrays_to_result(int len, const double* a1, const double* a2, double* result)
+{
+    struct array_job job = { .len = len, .a = a1, .b = a2, .r = result };
+    run_array_job(&job, divide_task);
+}
+
+//  one loop per function, so that the compiler can vectorize each of them
+static void apply_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    double* B = job->r;
+    switch(job->function)
+    {
+    case D_EXP:
+        for(int i = begin; i < end; ++i)
+            B[i] = exp(A[i]);
+        break;
+    case D_LOG:
+        for(int i = begin; i < end; ++i)
+            B[i] = log(A[i]);
+        break;
+    case D_SQRT:
+        for(int i = begin; i < end; ++i)
+            B[i] = sqrt(A[i]);
+        break;
+    case D_TANH:
+        for(int i = begin; i < end; ++i)
+            B[i] = tanh(A[i]);
+        break;
+    case D_SIN:
+        for(int i = begin; i < end; ++i)
+            B[i] = sin(A[i]);
+        break;
+    case D_COS:
+        for(int i = begin; i < end; ++i)
+            B[i] = cos(A[i]);
+        break;
+    case D_ABS:
+        for(int i = begin; i < end; ++i)
+            B[i] = fabs(A[i]);
+        break;
+    }
+}
+
+void apply_d_array(int len, const double* A, double* B, enum d_function function)
+{
+    struct array_job job = { .len = len, .a = A, .r = B, .function = function };
+    run_array_job(&job, apply_task);
+}
+
+static void pow_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    double* B = job->r;
+    double p = job->v;
+    if(p == 2)
+        for(int i = begin; i < end; ++i)
+            B[i] = A[i] * A[i];
+    else
+        for(int i = begin; i < end; ++i)
+            B[i] = pow(A[i], p);
+}
+
+void pow_d_array(int len, const double* A, double* B, double p)
+{
+    struct array_job job = { .len = len, .a = A, .r = B, .v = p };
+    run_array_job(&job, pow_task);
+}
+
+static void clamp_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    const double* A = job->a;
+    double* B = job->r;
+    double min = job->v;
+    double max = job->w;
+    for(int i = begin; i < end; ++i)
+    {
+        double x = A[i] < min ? min : A[i];
+        B[i] = x > max ? max : x;
+    }
+}
+
+void clamp_d_array(int len, const double* A, double* B, double min, double max)
+{
+    struct array_job job = { .len = len, .a = A, .r = B, .v = min, .w = max };
+    run_array_job(&job, clamp_task);
+}
+
+//  leaf loops keep 8 independent accumulators to be vectorized
+static double sum_block(int len, const double* a, double p)
+{
+    double s[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    int i = 0;
+    for(; i + 8 <= len; i += 8)
+        for(int t = 0; t < 8; ++t)
+            s[t] += a[i + t];
+    double result = ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+    for(; i < len; ++i)
+        result += a[i];
+    return result;
+}
+
+static double sum_squares_block(int len, const double* a, double p)
+{
+    double s[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    int i = 0;
+    for(; i + 8 <= len; i += 8)
+        for(int t = 0; t < 8; ++t)
+            s[t] += a[i + t] * a[i + t];
+    double result = ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+    for(; i < len; ++i)
+        result += a[i] * a[i];
+    return result;
+}
+
+static double sum_pow_abs_block(int len, const double* a, double p)
+{
+    double result = 0;
+    for(int i = 0; i < len; ++i)
+        result += pow(fabs(a[i]), p);
+    return result;
+}
+
+static double min_block(int len, const double* a, double p)
+{
+    double result = a[0];
+    for(int i = 1; i < len; ++i)
+        result = (a[i] < result) ? a[i] : result;
+    return result;
+}
+
+static double max_block(int len, const double* a, double p)
+{
+    double result = a[0];
+    for(int i = 1; i < len; ++i)
+        result = (a[i] > result) ? a[i] : result;
+    return result;
+}
+
+static double max_abs_block(int len, const double* a, double p)
+{
+    double result = 0;
+    for(int i = 0; i < len; ++i)
+        result = (fabs(a[i]) > result) ? fabs(a[i]) : result;
+    return result;
+}
+
+static double pairwise(int len, const double* a, double (*block)(int len, const double* a, double p), double p)
+{
+    if(len <= PAIRWISE_BLOCK)
+        return block(len, a, p);
+
+    //  the first half is a multiple of 8 to keep leaf loops aligned
+    int half = (len / 2) & ~7;
+    return pairwise(half, a, block, p) + pairwise(len - half, a + half, block, p);
+}
+
+static double dot_block(int len, const double* a, const double* b)
+{
+    double s[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    int i = 0;
+    for(; i + 8 <= len; i += 8)
+        for(int t = 0; t < 8; ++t)
+            s[t] += a[i + t] * b[i + t];
+    double result = ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+    for(; i < len; ++i)
+        result += a[i] * b[i];
+    return result;
+}
+
+static double pairwise_dot(int len, const double* a, const double* b)
+{
+    if(len <= PAIRWISE_BLOCK)
+        return dot_block(len, a, b);
+
+    int half = (len / 2) & ~7;
+    return pairwise_dot(half, a, b) + pairwise_dot(len - half, a + half, b + half);
+}
+
+static double add_values(double x, double y)
+{
+    return x + y;
+}
+
+static void pairwise_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    job->partial[task] = pairwise(end - begin, job->a + begin, job->block, job->v);
+}
+
+static void dot_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    job->partial[task] = pairwise_dot(end - begin, job->a + begin, job->b + begin);
+}
+
+static void extreme_task(void* data, int task)
+{
+    struct array_job* job = data;
+    int begin, end;
+    job_range(job, task, &begin, &end);
+
+    job->partial[task] = job->block(end - begin, job->a + begin, job->v);
+}
+
+static double reduce_d_array(int len, const double* a, double p, bool sum,
+                             double (*block)(int len, const double* a, double p),
+                             double (*combine)(double x, double y))
+{
+    struct array_job job = { .len = len, .a = a, .v = p, .block = block, .combine = combine };
+    run_array_job(&job, sum ? pairwise_task : extreme_task);
+
+    double result = job.partial[0];
+    for(int i = 1; i < job.tasks; ++i)
+        result = combine(result, job.partial[i]);
+    return result;
+}
+
+double sum_d_array(int len, const double* a)
+{
+    return reduce_d_array(len, a, 1, true, sum_block, add_values);
+}
+
+double sum_squares_d_array(int len, const double* a)
+{
+    return reduce_d_array(len, a, 2, true, sum_squares_block, add_values);
+}
+
+double sum_pow_abs_d_array(int len, const double* a, double p)
+{
+    return reduce_d_array(len, a, p, true, sum_pow_abs_block, add_values);
+}
+
+double min_d_array(int len, const double* a)
+{
+    return reduce_d_array(len, a, 0, false, min_block, fmin);
+}
+
+double max_d_array(int len, const double* a)
+{
+    return reduce_d_array(len, a, 0, false, max_block, fmax);
+}
+
+double max_abs_d_array(int len, const double* a)
+{
+    return reduce_d_array(len, a, 0, false, max_abs_block, fmax);
+}
+
+double dot_d_arrays(int len, const double* a, const double* b)
+{
+    if(len < PARALLEL_THRESHOLD)
+        return pairwise_dot(len, a, b);
+
+    struct array_job job = { .len = len, .a = a, .b = b };
+    run_array_job(&job, dot_task);
+
+    double result = job.partial[0];
+    for(int i = 1; i < job.tasks; ++i)
+        result += job.partial[i];
+    return result;
+}
+
+static unsigned long long hash_bits(double x)
+{
+    //  -0.0 == 0.0, so both must give the same bits
+    if(x == 0)
+        x = 0;
+    unsigned long long bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static unsigned long long hash_mix(unsigned long long h, unsigned long long bits)
+{
+    h ^= bits * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+    return h * 0xbf58476d1ce4e5b9ULL;
+}
+
+//  four independent lanes keep the multiplier pipeline busy
+unsigned long long hash_d_array(int len, const double* a)
+{
+    unsigned long long h0 = 1, h1 = 2, h2 = 3, h3 = 4;
+    int i = 0;
+    for(; i + 3 < len; i += 4)
+    {
+        h0 = hash_mix(h0, hash_bits(a[i]));
+        h1 = hash_mix(h1, hash_bits(a[i + 1]));
+        h2 = hash_mix(h2, hash_bits(a[i + 2]));
+        h3 = hash_mix(h3, hash_bits(a[i + 3]));
+    }
+    for(; i < len; ++i)
+        h0 = hash_mix(h0, hash_bits(a[i]));
+
+    unsigned long long h = hash_mix(h0, h1);
+    h = hash_mix(h, h2);
+    h = hash_mix(h, h3);
+    return hash_mix(h, (unsigned long long)len);
+}
+
+//  frozen buffers may be cloned from several ractors at once,
+//  so the counter is installed with compare and swap
+int* share_d_array(int** shared)
+{
+    int* counter = __atomic_load_n(shared, __ATOMIC_ACQUIRE);
+    if(counter == NULL)
+    {
+        int* created = malloc(sizeof(int));
+        *created = 1;
+        if(__atomic_compare_exchange_n(shared, &counter, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            counter = created;
+        else
+            free(created);
+    }
+    __atomic_add_fetch(counter, 1, __ATOMIC_ACQ_REL);
+    return counter;
+}
+
+//  only a sole owner sees the counter equal to 1, nobody can share the buffer meanwhile;
+//  the copy may release the GVL, so the object keeps the shared buffer until it is done
+void unshare_d_array(int len, double** a, int** shared)
+{
+    int* counter = *shared;
+    if(counter == NULL)
+        return;
+
+    if(__atomic_load_n(counter, __ATOMIC_ACQUIRE) == 1)
+    {
+        *shared = NULL;
+        free(counter);
+        return;
+    }
+
+    double* copy = malloc(len * sizeof(double));
+    copy_d_array(len, *a, copy);
+    double* old = *a;
+    *a = copy;
+    *shared = NULL;
+    release_d_array(old, counter);
+}
+
+//  a parallel job may still read the buffer without the GVL
+void release_d_array(double* a, int* shared)
+{
+    if(shared != NULL && __atomic_sub_fetch(shared, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+    free(shared);
+    parallel_free(a);
+}
@@ -1,17 +1,58 @@
-#ifndef C_ARRAY_OPERATIONS
-#define C_ARRAY_OPERATIONS
-
-#include  <stdbool.h>
-
-void fill_d_array(int len, double* a, double v);
-void multiply_d_array(int len, double* a, double v);
-void copy_d_array(int len, const double* input, double* output);
-void add_d_arrays_to_result(int len, const double* a1, const double* a2, double* result);
-void add_d_arrays_to_first(int len, double* sum, const double* added);
-void sub_d_arrays_to_result(int len, const double* dec, const double* sub, double* dif);
-void sub_d_arrays_to_first(int len, double* dif, const double* sub);
-bool equal_d_arrays(int len, const double* A, const double* B);
-void abs_d_array(int len, const double* A, double* B);
-bool greater_or_equal_d_array(int len, const double* A, const double* B);
-
-#endif  /*C_ARRAY_OPERATIONS*/
+#ifndef C_ARRAY_OPERATIONS
+#define C_ARRAY_OPERATIONS
+
+#include  <stdbool.h>
+
+// large arrays are split between threads of the shared pool (parallel.h)
+
+void fill_d_array(int len, double* a, double v);
+void multiply_d_array(int len, double* a, double v);
+void divide_d_array(int len, double* a, double v);
+void copy_d_array(int len, const double* input, double* output);
+void add_d_arrays_to_result(int len, const double* a1, const double* a2, double* result);
+void add_d_arrays_to_first(int len, double* sum, const double* added);
+void sub_d_arrays_to_result(int len, const double* dec, const double* sub, double* dif);
+void sub_d_arrays_to_first(int len, double* dif, const double* sub);
+bool equal_d_arrays(int len, const double* A, const double* B);
+void abs_d_array(int len, const double* A, double* B);
+bool greater_or_equal_d_array(int len, const double* A, const double* B);
+
+// elementwise operations, the result may be the same array as an argument
+enum d_function
+{
+    D_EXP,
+    D_LOG,
+    D_SQRT,
+    D_TANH,
+    D_SIN,
+    D_COS,
+    D_ABS,
+};
+
+void hadamard_d_arrays_to_result(int len, const double* a1, const double* a2, double* result);
+void divide_d_arrays_to_result(int len, const double* a1, const double* a2, double* result);
+void apply_d_array(int len, const double* A, double* B, enum d_function function);
+void pow_d_array(int len, const double* A, double* B, double p);
+void clamp_d_array(int len, const double* A, double* B, double min, double max);
+
+// reductions use pairwise summation, the error grows as O(log(len))
+double sum_d_array(int len, const double* a);
+double sum_squares_d_array(int len, const double* a);
+double sum_pow_abs_d_array(int len, const double* a, double p);
+double min_d_array(int len, const double* a);
+double max_d_array(int len, const double* a);
+double max_abs_d_array(int len, const double* a);
+double dot_d_arrays(int len, const double* a, const double* b);
+// equal arrays have equal hashes, 0.0 and -0.0 are treated as equal
+unsigned long long hash_d_array(int len, const double* a);
+
+// Buffers shared by clones: shared is NULL while the buffer has one owner,
+// otherwise it points to the number of owners of the buffer.
+// share - adds an owner, returns the counter for the new owner
+// unshare - gives the owner its own buffer before it is changed
+// release - drops an owner and frees the buffer after the last one
+int* share_d_array(int** shared);
+void unshare_d_array(int len, double** a, int** shared);
+void release_d_array(double* a, int* shared);
+
+#endif  /*C_ARRAY_OPERATIONS*/
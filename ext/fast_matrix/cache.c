@@ -0,0 +1,185 @@
+#include "cache.h"
+#include "c_array_operations.h"
+#include "lu.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define CACHE_DETERMINANT 1
+#define CACHE_FROBENIUS_NORM 2
+#define CACHE_HASH 4
+#define CACHE_LU 8
+
+void c_matrix_cache_free(struct matrix_cache* cache)
+{
+    if(cache == NULL)
+        return;
+    if(cache->transpose != NULL)
+        release_d_array(cache->transpose, cache->transpose_shared);
+    if(cache->lu != NULL)
+        release_d_array(cache->lu, cache->lu_shared);
+    free(cache);
+}
+
+static struct matrix_cache* matrix_cache(struct matrix* A)
+{
+    struct matrix_cache* cache = __atomic_load_n(&A->cache, __ATOMIC_ACQUIRE);
+    if(cache != NULL)
+        return cache;
+
+    struct matrix_cache* created = calloc(1, sizeof(struct matrix_cache));
+    if(__atomic_compare_exchange_n(&A->cache, &cache, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return created;
+    free(created);
+    return cache;
+}
+
+static bool cache_has(struct matrix_cache* cache, int flag)
+{
+    return __atomic_load_n(&cache->valid, __ATOMIC_ACQUIRE) & flag;
+}
+
+//  a kernel may release the GVL, so the result is kept only if
+//  no other thread changed the matrix meanwhile
+static void cache_publish(struct matrix* A, unsigned long version, int flag)
+{
+    if(A->version == version)
+        __atomic_or_fetch(&matrix_cache(A)->valid, flag, __ATOMIC_RELEASE);
+}
+
+double c_matrix_determinant(struct matrix* A)
+{
+    struct matrix_cache* cache = matrix_cache(A);
+    if(cache_has(cache, CACHE_DETERMINANT))
+        return cache->determinant;
+
+    unsigned long version = A->version;
+    double det = determinant(A->n, A->data);
+    if(A->version == version)
+    {
+        cache = matrix_cache(A);
+        cache->determinant = det;
+        cache_publish(A, version, CACHE_DETERMINANT);
+    }
+    return det;
+}
+
+double c_matrix_frobenius_norm(struct matrix* A)
+{
+    struct matrix_cache* cache = matrix_cache(A);
+    if(cache_has(cache, CACHE_FROBENIUS_NORM))
+        return cache->frobenius_norm;
+
+    unsigned long version = A->version;
+    double norm = sqrt(sum_squares_d_array(A->m * A->n, A->data));
+    if(A->version == version)
+    {
+        cache = matrix_cache(A);
+        cache->frobenius_norm = norm;
+        cache_publish(A, version, CACHE_FROBENIUS_NORM);
+    }
+    return norm;
+}
+
+unsigned long long c_matrix_hash(struct matrix* A)
+{
+    struct matrix_cache* cache = matrix_cache(A);
+    if(cache_has(cache, CACHE_HASH))
+        return cache->hash;
+
+    unsigned long version = A->version;
+    unsigned long long hash = hash_d_array(A->m * A->n, A->data);
+    if(A->version == version)
+    {
+        cache = matrix_cache(A);
+        cache->hash = hash;
+        cache_publish(A, version, CACHE_HASH);
+    }
+    return hash;
+}
+
+bool c_matrix_hashes_differ(struct matrix* A, struct matrix* B)
+{
+    struct matrix_cache* a = __atomic_load_n(&A->cache, __ATOMIC_ACQUIRE);
+    struct matrix_cache* b = __atomic_load_n(&B->cache, __ATOMIC_ACQUIRE);
+    if(a == NULL || b == NULL || !cache_has(a, CACHE_HASH) || !cache_has(b, CACHE_HASH))
+        return false;
+    return a->hash != b->hash;
+}
+
+//  installs buffer into *slot unless another ractor was faster,
+//  returns the buffer in the slot
+static double* cache_install(struct matrix* A, unsigned long version, double** slot, double* buffer)
+{
+    if(A->version != version)
+        return NULL;
+    double* expected = NULL;
+    if(__atomic_compare_exchange_n(slot, &expected, buffer, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return buffer;
+    return expected;
+}
+
+double* c_matrix_transposed(struct matrix* A, int** shared)
+{
+    struct matrix_cache* cache = matrix_cache(A);
+    double* cached = __atomic_load_n(&cache->transpose, __ATOMIC_ACQUIRE);
+    if(cached != NULL)
+    {
+        *shared = share_d_array(&cache->transpose_shared);
+        return cached;
+    }
+
+    unsigned long version = A->version;
+    double* buffer = malloc(A->m * A->n * sizeof(double));
+    matrix_transpose(A->m, A->n, A->data, buffer);
+
+    cache = matrix_cache(A);
+    double* installed = cache_install(A, version, &cache->transpose, buffer);
+    if(installed != buffer)
+    {
+        //  the matrix changed or another ractor cached its own copy
+        *shared = NULL;
+        return buffer;
+    }
+    *shared = share_d_array(&cache->transpose_shared);
+    return buffer;
+}
+
+double* c_matrix_lu(struct matrix* A, int** shared)
+{
+    int n = A->n;
+    struct matrix_cache* cache = matrix_cache(A);
+    if(cache_has(cache, CACHE_LU))
+    {
+        if(cache->singular)
+            return NULL;
+        *shared = share_d_array(&cache->lu_shared);
+        return cache->lu;
+    }
+
+    unsigned long version = A->version;
+    double* buffer = malloc((size_t)n * n * sizeof(double) + n * sizeof(int));
+    copy_d_array(n * n, A->data, buffer);
+    bool regular = c_lu_decompose(n, buffer, (int*)(buffer + (size_t)n * n));
+
+    cache = matrix_cache(A);
+    if(!regular)
+    {
+        free(buffer);
+        if(A->version == version)
+        {
+            cache->singular = true;
+            cache_publish(A, version, CACHE_LU);
+        }
+        return NULL;
+    }
+
+    double* installed = cache_install(A, version, &cache->lu, buffer);
+    if(installed != buffer)
+    {
+        *shared = NULL;
+        return buffer;
+    }
+    *shared = share_d_array(&cache->lu_shared);
+    cache_publish(A, version, CACHE_LU);
+    return buffer;
+}
@@ -0,0 +1,48 @@
+#ifndef FAST_MATRIX_CACHE_H
+#define FAST_MATRIX_CACHE_H 1
+
+#include "ruby.h"
+#include "matrix.h"
+#include <stdbool.h>
+
+// Results derived from a matrix, memoized until the matrix changes.
+// c_matrix_modify drops the cache, so only unfrozen matrices, which
+// are never shared between ractors, lose it; frozen ones may fill
+// it from several ractors, so entries are published atomically.
+struct matrix_cache
+{
+    //  bits of results which are computed
+    int valid;
+
+    double determinant;
+    double frobenius_norm;
+    unsigned long long hash;
+
+    //  buffers shared with their users, see share_d_array
+    double* transpose;
+    int* transpose_shared;
+    //  n x n LU decomposition followed by n ints of permutation
+    double* lu;
+    int* lu_shared;
+    bool singular;
+};
+
+void c_matrix_cache_free(struct matrix_cache* cache);
+
+// A - matrix n x n
+double c_matrix_determinant(struct matrix* A);
+double c_matrix_frobenius_norm(struct matrix* A);
+unsigned long long c_matrix_hash(struct matrix* A);
+// true if hashes of both matrices are cached and differ
+bool c_matrix_hashes_differ(struct matrix* A, struct matrix* B);
+
+// Buffers come with a reference of the caller,
+// which must be dropped with release_d_array(buffer, *shared).
+// transposed data of A
+double* c_matrix_transposed(struct matrix* A, int** shared);
+// A - matrix n x n
+// returns LU decomposition of A (see c_lu_decompose) followed by n ints of
+// permutation, NULL if A is singular
+double* c_matrix_lu(struct matrix* A, int** shared);
+
+#endif /* FAST_MATRIX_CACHE_H */
@@ -0,0 +1,255 @@
+#include "convolve.h"
+#include "errors.h"
+#include "matrix.h"
+#include "parallel.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// results accumulated in registers at once, 32 is about twice
+// as fast as 8 for kernels from 3x3 to 25x25
+#define CONVOLVE_BLOCK 32
+
+// The matrix is padded once according to the boundary (:valid uses it as it is),
+// so that every result is a plain product of the kernel with a window:
+// R[i, j] = sum K[u, v] * P[i + u, j + v], P - matrix (rm + km - 1) x (rn + kn - 1)
+struct convolve_job
+{
+    int m;
+    int n;
+    const double* A;
+    int km;
+    int kn;
+    const double* K;
+    enum convolve_boundary boundary;
+    int off_i;
+    int off_j;
+
+    int pm;
+    int pn;
+    const double* P;
+    //  P unless A is used as it is
+    double* padded;
+    int rm;
+    int rn;
+    double* R;
+    int tasks;
+};
+
+int c_convolve_size(int size, int kernel_size, enum convolve_mode mode)
+{
+    switch(mode)
+    {
+    case CONVOLVE_FULL:
+        return size + kernel_size - 1;
+    case CONVOLVE_SAME:
+        return size;
+    case CONVOLVE_VALID:
+        return size >= kernel_size ? size - kernel_size + 1 : 0;
+    }
+    return 0;
+}
+
+static int convolve_offset(int kernel_size, enum convolve_mode mode)
+{
+    switch(mode)
+    {
+    case CONVOLVE_FULL:
+        return kernel_size - 1;
+    case CONVOLVE_SAME:
+        return (kernel_size - 1) / 2;
+    case CONVOLVE_VALID:
+        return 0;
+    }
+    return 0;
+}
+
+// index in [0, size) of the element at index i of the mirrored matrix, -1 for zeros
+static int boundary_index(int i, int size, enum convolve_boundary boundary)
+{
+    if(i >= 0 && i < size)
+        return i;
+    if(boundary == CONVOLVE_ZERO)
+        return -1;
+
+    //  the mirrored matrix has period 2 size
+    long period = 2L * size;
+    long t = i % period;
+    if(t < 0)
+        t += period;
+    return (int)(t < size ? t : period - 1 - t);
+}
+
+static void pad_task(void* data, int task)
+{
+    struct convolve_job* job = data;
+    int begin = (long)job->pn * task / job->tasks;
+    int end = (long)job->pn * (task + 1) / job->tasks;
+
+    //  columns of A which land in the padded row as a whole
+    int j0 = job->off_j;
+    int j1 = job->off_j + job->m;
+    j0 = j0 < 0 ? 0 : (j0 > job->pm ? job->pm : j0);
+    j1 = j1 < j0 ? j0 : (j1 > job->pm ? job->pm : j1);
+
+    for(int i = begin; i < end; ++i)
+    {
+        double* p = job->padded + (size_t)job->pm * i;
+        int si = boundary_index(i - job->off_i, job->n, job->boundary);
+        if(si < 0)
+        {
+            memset(p, 0, job->pm * sizeof(double));
+            continue;
+        }
+
+        const double* a = job->A + (size_t)job->m * si;
+        memcpy(p + j0, a + j0 - job->off_j, (j1 - j0) * sizeof(double));
+        for(int j = 0; j < j0; ++j)
+        {
+            int sj = boundary_index(j - job->off_j, job->m, job->boundary);
+            p[j] = sj < 0 ? 0 : a[sj];
+        }
+        for(int j = j1; j < job->pm; ++j)
+        {
+            int sj = boundary_index(j - job->off_j, job->m, job->boundary);
+            p[j] = sj < 0 ? 0 : a[sj];
+        }
+    }
+}
+
+//  width <= CONVOLVE_BLOCK results of row i starting at column j,
+//  they stay in registers for the whole kernel
+static inline void correlate_block(const struct convolve_job* job, int i, int j, int width)
+{
+    double acc[CONVOLVE_BLOCK] = { 0 };
+    for(int u = 0; u < job->kn; ++u)
+    {
+        const double* p = job->P + (size_t)job->pm * (i + u) + j;
+        const double* k = job->K + (size_t)job->km * u;
+        for(int v = 0; v < job->km; ++v)
+        {
+            double w = k[v];
+            for(int t = 0; t < width; ++t)
+                acc[t] += w * p[v + t];
+        }
+    }
+    memcpy(job->R + (size_t)job->rm * i + j, acc, width * sizeof(double));
+}
+
+static void correlate_task(void* data, int task)
+{
+    struct convolve_job* job = data;
+    int begin = (long)job->rn * task / job->tasks;
+    int end = (long)job->rn * (task + 1) / job->tasks;
+
+    for(int i = begin; i < end; ++i)
+    {
+        int j = 0;
+        for(; j + CONVOLVE_BLOCK <= job->rm; j += CONVOLVE_BLOCK)
+            correlate_block(job, i, j, CONVOLVE_BLOCK);
+        if(j < job->rm)
+            correlate_block(job, i, j, job->rm - j);
+    }
+}
+
+static void run_convolve_job(struct convolve_job* job, void (*fn)(void*, int), long work, int rows)
+{
+    job->tasks = parallel_tasks(work, rows);
+    if(job->tasks == 1)
+        fn(job, 0);
+    else
+        parallel_for(job->tasks, fn, job);
+}
+
+void c_matrix_correlate(int m, int n, const double* A, int km, int kn, const double* K,
+                        enum convolve_mode mode, enum convolve_boundary boundary, bool flip,
+                        int rm, int rn, double* R)
+{
+    size_t kk = (size_t)km * kn;
+    double* flipped = NULL;
+    if(flip)
+    {
+        flipped = malloc(kk * sizeof(double));
+        for(size_t t = 0; t < kk; ++t)
+            flipped[t] = K[kk - 1 - t];
+        K = flipped;
+    }
+
+    struct convolve_job job =
+    {
+        .m = m, .n = n, .A = A, .km = km, .kn = kn, .K = K, .boundary = boundary,
+        .off_i = convolve_offset(kn, mode), .off_j = convolve_offset(km, mode),
+        .pm = rm + km - 1, .pn = rn + kn - 1, .rm = rm, .rn = rn, .R = R,
+    };
+    //  windows of :valid never leave A
+    if(mode == CONVOLVE_VALID)
+        job.P = A;
+    else
+    {
+        job.padded = malloc((size_t)job.pm * job.pn * sizeof(double));
+        job.P = job.padded;
+        run_convolve_job(&job, pad_task, (long)job.pm * job.pn, job.pn);
+    }
+    run_convolve_job(&job, correlate_task, (long)rm * rn * kk, rn);
+
+    free(job.padded);
+    free(flipped);
+}
+
+static enum convolve_mode convolve_mode_arg(VALUE mode)
+{
+    if(SYMBOL_P(mode))
+    {
+        ID id = SYM2ID(mode);
+        if(id == rb_intern("full"))
+            return CONVOLVE_FULL;
+        if(id == rb_intern("same"))
+            return CONVOLVE_SAME;
+        if(id == rb_intern("valid"))
+            return CONVOLVE_VALID;
+    }
+    rb_raise(rb_eArgError, "expected :full, :same or :valid mode");
+}
+
+static enum convolve_boundary convolve_boundary_arg(VALUE boundary)
+{
+    if(SYMBOL_P(boundary))
+    {
+        ID id = SYM2ID(boundary);
+        if(id == rb_intern("zero"))
+            return CONVOLVE_ZERO;
+        if(id == rb_intern("reflect"))
+            return CONVOLVE_REFLECT;
+    }
+    rb_raise(rb_eArgError, "expected :zero or :reflect boundary");
+}
+
+VALUE matrix_convolve(VALUE self, VALUE kernel, VALUE mode, VALUE boundary, VALUE flip)
+{
+    struct matrix* A;
+    struct matrix* K;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    TypedData_Get_Struct(kernel, struct matrix, &matrix_type, K);
+
+    enum convolve_mode c_mode = convolve_mode_arg(mode);
+    enum convolve_boundary c_boundary = convolve_boundary_arg(boundary);
+
+    if(c_mode == CONVOLVE_FULL && (K->m > INT_MAX - A->m || K->n > INT_MAX - A->n))
+        rb_raise(fm_eIndexError, "Matrix is too large");
+    int rm = c_convolve_size(A->m, K->m, c_mode);
+    int rn = c_convolve_size(A->n, K->n, c_mode);
+    if(rm == 0 || rn == 0)
+        rb_raise(fm_eIndexError, "Kernel is larger than matrix");
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, rm, rn);
+    c_matrix_correlate(A->m, A->n, A->data, K->m, K->n, K->data,
+                       c_mode, c_boundary, RTEST(flip), rm, rn, R->data);
+    return result;
+}
+
+void init_fm_convolve()
+{
+    rb_define_private_method(cMatrix, "convolve_impl", matrix_convolve, 4);
+}
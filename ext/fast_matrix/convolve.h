@@ -0,0 +1,37 @@
+#ifndef FAST_MATRIX_CONVOLVE_H
+#define FAST_MATRIX_CONVOLVE_H 1
+
+#include "ruby.h"
+#include <stdbool.h>
+
+enum convolve_mode
+{
+    CONVOLVE_FULL,
+    CONVOLVE_SAME,
+    CONVOLVE_VALID,
+};
+
+enum convolve_boundary
+{
+    //  zeros outside of the matrix
+    CONVOLVE_ZERO,
+    //  the matrix mirrored at its edges, the edge is repeated: c b a | a b c | c b a
+    CONVOLVE_REFLECT,
+};
+
+// R[i, j] = sum K[u, v] * A[i + u - off_i, j + v - off_j] over the kernel,
+// the kernel is rotated by 180 degrees first if flip is true (convolution);
+// off is kn - 1 for :full, (kn - 1) / 2 for :same and 0 for :valid
+// A - matrix m x n
+// K - matrix km x kn
+// R - matrix rm x rn, see c_convolve_size
+void c_matrix_correlate(int m, int n, const double* A, int km, int kn, const double* K,
+                        enum convolve_mode mode, enum convolve_boundary boundary, bool flip,
+                        int rm, int rn, double* R);
+
+// size of the result along one axis, 0 if the kernel is larger than A for :valid
+int c_convolve_size(int size, int kernel_size, enum convolve_mode mode);
+
+void init_fm_convolve();
+
+#endif /* FAST_MATRIX_CONVOLVE_H */
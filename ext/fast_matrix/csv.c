@@ -0,0 +1,267 @@
+#include "csv.h"
+#include "errors.h"
+#include "matrix.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+VALUE cCSVParser;
+
+void csv_parser_free(void* data);
+size_t csv_parser_size(const void* data);
+
+const rb_data_type_t csv_parser_type =
+{
+    .wrap_struct_name = "csv_parser",
+    .function =
+    {
+        .dmark = NULL,
+        .dfree = csv_parser_free,
+        .dsize = csv_parser_size,
+    },
+    .data = NULL,
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+void csv_parser_free(void* data)
+{
+    struct csv_parser* p = data;
+    free(p->field);
+    free(p->values);
+    free(p);
+}
+
+size_t csv_parser_size(const void* data)
+{
+    const struct csv_parser* p = data;
+    return sizeof(struct csv_parser) + p->field_cap + p->values_cap * sizeof(double);
+}
+
+VALUE csv_parser_alloc(VALUE self)
+{
+    struct csv_parser* p = calloc(1, sizeof(struct csv_parser));
+    return TypedData_Wrap_Struct(self, &csv_parser_type, p);
+}
+
+VALUE csv_parser_initialize(VALUE self, VALUE separator, VALUE headers)
+{
+    struct csv_parser* p;
+    TypedData_Get_Struct(self, struct csv_parser, &csv_parser_type, p);
+
+    StringValue(separator);
+    if(RSTRING_LEN(separator) != 1)
+        rb_raise(rb_eArgError, "Separator must be a single character");
+
+    p->separator = RSTRING_PTR(separator)[0];
+    p->skip_line = RTEST(headers);
+    p->columns = -1;
+    p->line = 1;
+    return self;
+}
+
+static void csv_push_char(struct csv_parser* p, char c)
+{
+    if(p->field_len + 1 >= p->field_cap)
+    {
+        p->field_cap = p->field_cap ? 2 * p->field_cap : 64;
+        p->field = realloc(p->field, p->field_cap);
+    }
+    p->field[p->field_len++] = c;
+}
+
+static void csv_push_value(struct csv_parser* p, double v)
+{
+    if(p->values_len == p->values_cap)
+    {
+        p->values_cap = p->values_cap ? 2 * p->values_cap : 1024;
+        p->values = realloc(p->values, p->values_cap * sizeof(double));
+    }
+    p->values[p->values_len++] = v;
+}
+
+// empty fields are NaN, surrounding spaces are ignored
+static void csv_end_field(struct csv_parser* p)
+{
+    csv_push_char(p, 0);
+    char* begin = p->field;
+    while(*begin == ' ' || *begin == '\t')
+        ++begin;
+
+    double v = NAN;
+    if(*begin != 0)
+    {
+        char* end;
+        v = strtod(begin, &end);
+        while(*end == ' ' || *end == '\t')
+            ++end;
+        if(end == begin || *end != 0)
+            rb_raise(fm_eError, "Invalid number '%s' at line %ld", begin, p->line);
+    }
+
+    csv_push_value(p, v);
+    p->field_len = 0;
+    ++p->fields;
+    p->row_started = true;
+}
+
+// blank lines are skipped
+static void csv_end_line(struct csv_parser* p)
+{
+    if(p->row_started || p->field_len > 0)
+    {
+        csv_end_field(p);
+        if(p->columns < 0)
+            p->columns = p->fields;
+        else if(p->fields != p->columns)
+            rb_raise(fm_eIndexError, "Line %ld has %d fields, expected %d", p->line, p->fields, p->columns);
+        ++p->rows;
+    }
+    p->fields = 0;
+    p->row_started = false;
+    ++p->line;
+}
+
+VALUE csv_parser_feed(VALUE self, VALUE text)
+{
+    struct csv_parser* p;
+    TypedData_Get_Struct(self, struct csv_parser, &csv_parser_type, p);
+
+    StringValue(text);
+    const char* s = RSTRING_PTR(text);
+    long len = RSTRING_LEN(text);
+
+    for(long i = 0; i < len; ++i)
+    {
+        char c = s[i];
+        if(p->skip_line)
+        {
+            if(c == '\n')
+            {
+                p->skip_line = false;
+                ++p->line;
+            }
+        }
+        else if(c == '"')
+            p->quoted = !p->quoted;
+        else if(p->quoted)
+            csv_push_char(p, c);
+        else if(c == p->separator)
+            csv_end_field(p);
+        else if(c == '\n')
+            csv_end_line(p);
+        else if(c != '\r')
+            csv_push_char(p, c);
+    }
+    RB_GC_GUARD(text);
+    return self;
+}
+
+// completes the last line if the text does not end with a newline
+VALUE csv_parser_finish(VALUE self)
+{
+    struct csv_parser* p;
+    TypedData_Get_Struct(self, struct csv_parser, &csv_parser_type, p);
+
+    if(p->row_started || p->field_len > 0)
+        csv_end_line(p);
+    return self;
+}
+
+VALUE csv_parser_rows(VALUE self)
+{
+    struct csv_parser* p;
+    TypedData_Get_Struct(self, struct csv_parser, &csv_parser_type, p);
+
+    return LONG2NUM(p->rows);
+}
+
+// matrix of the first count completed rows, which are removed;
+// taking everything moves the buffer into the matrix without a copy
+VALUE csv_parser_take(VALUE self, VALUE count)
+{
+    struct csv_parser* p;
+    TypedData_Get_Struct(self, struct csv_parser, &csv_parser_type, p);
+
+    long n = NUM2LONG(count);
+    if(n <= 0 || n > p->rows)
+        rb_raise(fm_eIndexError, "Invalid count of rows");
+    if(n * p->columns > INT_MAX)
+        rb_raise(fm_eIndexError, "Too many rows");
+
+    size_t len = (size_t)n * p->columns;
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    R->m = p->columns;
+    R->n = (int)n;
+
+    if(len == p->values_len)
+    {
+        R->data = realloc(p->values, len * sizeof(double));
+        p->values = NULL;
+        p->values_len = 0;
+        p->values_cap = 0;
+    }
+    else
+    {
+        R->data = malloc(len * sizeof(double));
+        memcpy(R->data, p->values, len * sizeof(double));
+        memmove(p->values, p->values + len, (p->values_len - len) * sizeof(double));
+        p->values_len -= len;
+    }
+    p->rows -= n;
+    return result;
+}
+
+// %.15g if it reads back exactly, %.17g (always exact) otherwise
+static int csv_format_double(char* buffer, size_t size, double v)
+{
+    int len = snprintf(buffer, size, "%.15g", v);
+    if(strtod(buffer, NULL) == v)
+        return len;
+    return snprintf(buffer, size, "%.17g", v);
+}
+
+// count rows starting from first as CSV text
+VALUE matrix_csv_rows(VALUE self, VALUE first, VALUE count, VALUE separator)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    int begin = NUM2INT(first);
+    int n = NUM2INT(count);
+    StringValue(separator);
+    if(begin < 0 || n < 0 || begin + n > A->n)
+        rb_raise(fm_eIndexError, "Index out of range");
+
+    VALUE result = rb_str_buf_new((long)n * A->m * 8);
+    char buffer[32];
+    for(int i = begin; i < begin + n; ++i)
+    {
+        const double* row = A->data + (size_t)A->m * i;
+        for(int j = 0; j < A->m; ++j)
+        {
+            if(j > 0)
+                rb_str_buf_append(result, separator);
+            int len = csv_format_double(buffer, sizeof(buffer), row[j]);
+            rb_str_buf_cat(result, buffer, len);
+        }
+        rb_str_buf_cat(result, "\n", 1);
+    }
+    return result;
+}
+
+void init_fm_csv()
+{
+    cCSVParser = rb_define_class_under(cMatrix, "CSVParser", rb_cObject);
+
+    rb_define_alloc_func(cCSVParser, csv_parser_alloc);
+
+    rb_define_method(cCSVParser, "initialize", csv_parser_initialize, 2);
+    rb_define_method(cCSVParser, "feed", csv_parser_feed, 1);
+    rb_define_method(cCSVParser, "finish", csv_parser_finish, 0);
+    rb_define_method(cCSVParser, "rows", csv_parser_rows, 0);
+    rb_define_method(cCSVParser, "take", csv_parser_take, 1);
+
+    rb_define_private_method(cMatrix, "csv_rows", matrix_csv_rows, 3);
+}
@@ -0,0 +1,35 @@
+#ifndef FAST_MATRIX_CSV_H
+#define FAST_MATRIX_CSV_H 1
+
+#include "ruby.h"
+#include <stdbool.h>
+
+extern VALUE cCSVParser;
+extern const rb_data_type_t csv_parser_type;
+
+// Incremental CSV parser: text is fed in arbitrary pieces,
+// completed rows are kept as doubles until taken as a matrix.
+struct csv_parser
+{
+    char separator;
+    bool quoted;
+    bool skip_line;
+    bool row_started;
+    int columns;
+    int fields;
+    long line;
+
+    char* field;
+    size_t field_len;
+    size_t field_cap;
+
+    //  values of completed rows followed by the current row
+    double* values;
+    size_t values_len;
+    size_t values_cap;
+    long rows;
+};
+
+void init_fm_csv();
+
+#endif /* FAST_MATRIX_CSV_H */
@@ -0,0 +1,385 @@
+#include "eigen.h"
+#include "c_array_operations.h"
+#include "matrix.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Householder reduction to tridiagonal form (tred2 from EISPACK/JAMA).
+// The orthogonal transformation is kept transposed, so that every inner
+// loop walks along a row: U[j * n + k] is the k-th component of j-th basis vector.
+// U - on input transposed symmetric matrix, on output transposed transformation
+// d - diagonal of tridiagonal matrix
+// e - subdiagonal of tridiagonal matrix in e[1..n-1]
+static void tridiagonalize(int n, double* U, double* d, double* e)
+{
+    for(int j = 0; j < n; ++j)
+        d[j] = U[n - 1 + n * j];
+
+    for(int i = n - 1; i > 0; --i)
+    {
+        double* u_i = U + n * i;
+        double scale = 0;
+        double h = 0;
+        for(int k = 0; k < i; ++k)
+            scale += fabs(d[k]);
+
+        if(scale == 0)
+        {
+            e[i] = d[i - 1];
+            for(int j = 0; j < i; ++j)
+            {
+                double* u_j = U + n * j;
+                d[j] = u_j[i - 1];
+                u_j[i] = 0;
+                u_i[j] = 0;
+            }
+        }
+        else
+        {
+            for(int k = 0; k < i; ++k)
+            {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i - 1];
+            double g = sqrt(h);
+            if(f > 0)
+                g = -g;
+            e[i] = scale * g;
+            h -= f * g;
+            d[i - 1] = f - g;
+            fill_d_array(i, e, 0);
+
+            for(int j = 0; j < i; ++j)
+            {
+                double* u_j = U + n * j;
+                f = d[j];
+                u_i[j] = f;
+                g = e[j] + u_j[j] * f;
+                for(int k = j + 1; k < i; ++k)
+                {
+                    g += u_j[k] * d[k];
+                    e[k] += u_j[k] * f;
+                }
+                e[j] = g;
+            }
+
+            f = 0;
+            for(int j = 0; j < i; ++j)
+            {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for(int j = 0; j < i; ++j)
+                e[j] -= hh * d[j];
+
+            for(int j = 0; j < i; ++j)
+            {
+                double* u_j = U + n * j;
+                f = d[j];
+                g = e[j];
+                for(int k = j; k < i; ++k)
+                    u_j[k] -= f * e[k] + g * d[k];
+                d[j] = u_j[i - 1];
+                u_j[i] = 0;
+            }
+        }
+        d[i] = h;
+    }
+
+    //  accumulate transformations
+    for(int i = 0; i < n - 1; ++i)
+    {
+        double* u_i = U + n * i;
+        double* u_next = U + n * (i + 1);
+        u_i[n - 1] = u_i[i];
+        u_i[i] = 1;
+        double h = d[i + 1];
+        if(h != 0)
+        {
+            for(int k = 0; k <= i; ++k)
+                d[k] = u_next[k] / h;
+            for(int j = 0; j <= i; ++j)
+            {
+                double* u_j = U + n * j;
+                double g = 0;
+                for(int k = 0; k <= i; ++k)
+                    g += u_next[k] * u_j[k];
+                for(int k = 0; k <= i; ++k)
+                    u_j[k] -= g * d[k];
+            }
+        }
+        fill_d_array(i + 1, u_next, 0);
+    }
+    for(int j = 0; j < n; ++j)
+    {
+        double* u_j = U + n * j;
+        d[j] = u_j[n - 1];
+        u_j[n - 1] = 0;
+    }
+    U[n * n - 1] = 1;
+    e[0] = 0;
+}
+
+// Implicit QL iterations on tridiagonal matrix (tql2 from EISPACK/JAMA).
+// Z - on input transposed transformation from tridiagonalize,
+//     on output row i is the eigenvector of d[i]
+// d - on input diagonal, on output eigenvalues in ascending order
+// e - subdiagonal from tridiagonalize, destroyed
+static bool tridiagonal_ql(int n, double* Z, double* d, double* e)
+{
+    const double eps = pow(2.0, -52.0);
+    double f = 0;
+    double tst1 = 0;
+
+    for(int i = 1; i < n; ++i)
+        e[i - 1] = e[i];
+    e[n - 1] = 0;
+
+    for(int l = 0; l < n; ++l)
+    {
+        tst1 = fmax(tst1, fabs(d[l]) + fabs(e[l]));
+        int m = l;
+        while(m < n - 1 && fabs(e[m]) > eps * tst1)
+            ++m;
+
+        int iter = 0;
+        while(m > l && fabs(e[l]) > eps * tst1)
+        {
+            if(++iter > 30 * n)
+                return false;
+
+            double g = d[l];
+            double p = (d[l + 1] - g) / (2 * e[l]);
+            double r = hypot(p, 1);
+            if(p < 0)
+                r = -r;
+            d[l] = e[l] / (p + r);
+            d[l + 1] = e[l] * (p + r);
+            double dl1 = d[l + 1];
+            double h = g - d[l];
+            for(int i = l + 2; i < n; ++i)
+                d[i] -= h;
+            f += h;
+
+            p = d[m];
+            double c = 1, c2 = 1, c3 = 1;
+            double el1 = e[l + 1];
+            double s = 0, s2 = 0;
+            for(int i = m - 1; i >= l; --i)
+            {
+                c3 = c2;
+                c2 = c;
+                s2 = s;
+                g = c * e[i];
+                h = c * p;
+                r = hypot(p, e[i]);
+                e[i + 1] = s * r;
+                s = e[i] / r;
+                c = p / r;
+                p = c * d[i] - s * g;
+                d[i + 1] = h + s * (c * g + s * d[i]);
+
+                double* z_i = Z + n * i;
+                double* z_next = Z + n * (i + 1);
+                for(int k = 0; k < n; ++k)
+                {
+                    h = z_next[k];
+                    z_next[k] = s * z_i[k] + c * h;
+                    z_i[k] = c * z_i[k] - s * h;
+                }
+            }
+            p = -s * s2 * c3 * el1 * e[l] / dl1;
+            e[l] = s * p;
+            d[l] = c * p;
+        }
+        d[l] += f;
+        e[l] = 0;
+    }
+
+    //  selection sort keeps the number of row swaps at n
+    double* buffer = malloc(n * sizeof(double));
+    for(int i = 0; i < n - 1; ++i)
+    {
+        int k = i;
+        for(int j = i + 1; j < n; ++j)
+            if(d[j] < d[k])
+                k = j;
+        if(k != i)
+        {
+            double p = d[k];
+            d[k] = d[i];
+            d[i] = p;
+            copy_d_array(n, Z + n * i, buffer);
+            copy_d_array(n, Z + n * k, Z + n * i);
+            copy_d_array(n, buffer, Z + n * k);
+        }
+    }
+    free(buffer);
+    return true;
+}
+
+bool c_symmetric_eigen(int n, const double* A, double* values, double* Z)
+{
+    double* e = malloc(n * sizeof(double));
+
+    //  transposed copy: the lower triangle of A becomes rows of Z
+    for(int i = 0; i < n; ++i)
+        for(int j = 0; j < n; ++j)
+            Z[j + n * i] = A[i + n * j];
+
+    tridiagonalize(n, Z, values, e);
+    bool converged = tridiagonal_ql(n, Z, values, e);
+
+    free(e);
+    return converged;
+}
+
+// deterministic start vectors, so that results are reproducible
+static void fill_start_vectors(int len, double* a)
+{
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for(int i = 0; i < len; ++i)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        a[i] = (double)(state >> 11) / 9007199254740992.0 - 0.5;
+    }
+}
+
+// modified Gram-Schmidt on p rows of Q (each of length n),
+// rows which became linearly dependent are replaced with new directions
+static void orthonormalize_rows(int n, int p, double* Q, double* spare)
+{
+    for(int i = 0; i < p; ++i)
+    {
+        double* q_i = Q + n * i;
+        for(int attempt = 0; attempt < 3; ++attempt)
+        {
+            double before = sqrt(dot_d_arrays(n, q_i, q_i));
+            for(int j = 0; j < i; ++j)
+            {
+                const double* q_j = Q + n * j;
+                double r = dot_d_arrays(n, q_j, q_i);
+                for(int t = 0; t < n; ++t)
+                    q_i[t] -= r * q_j[t];
+            }
+            double norm = sqrt(dot_d_arrays(n, q_i, q_i));
+            if(norm > 1e-10 * before && norm > 0)
+            {
+                multiply_d_array(n, q_i, 1 / norm);
+                break;
+            }
+            fill_start_vectors(n, spare);
+            for(int t = 0; t < n; ++t)
+                q_i[t] = spare[(t + 7 * i + attempt) % n];
+        }
+    }
+}
+
+bool c_top_eigen(int n, int k, const double* A, double tol, int max_iterations, double* values, double* X)
+{
+    //  a few extra vectors speed up convergence of the k-th one
+    int p = 2 * k > k + 8 ? 2 * k : k + 8;
+    if(p > n)
+        p = n;
+
+    double* Q = malloc(p * n * sizeof(double));
+    double* Z = malloc(p * n * sizeof(double));
+    double* R = malloc(p * n * sizeof(double));
+    double* AR = malloc(p * n * sizeof(double));
+    double* H = malloc(p * p * sizeof(double));
+    double* S = malloc(p * p * sizeof(double));
+    double* w = malloc(p * sizeof(double));
+    int* order = malloc(p * sizeof(int));
+    bool converged = false;
+
+    fill_start_vectors(p * n, Q);
+    orthonormalize_rows(n, p, Q, Z);
+
+    for(int iteration = 0; iteration < max_iterations && !converged; ++iteration)
+    {
+        //  Z = A Q
+        for(int i = 0; i < p; ++i)
+            c_matrix_vector_multiply(n, n, A, Q + n * i, Z + n * i);
+
+        //  Rayleigh-Ritz: H = Q^T A Q
+        for(int i = 0; i < p; ++i)
+            for(int j = 0; j <= i; ++j)
+            {
+                double h = 0.5 * (dot_d_arrays(n, Q + n * i, Z + n * j)
+                                + dot_d_arrays(n, Q + n * j, Z + n * i));
+                H[j + p * i] = h;
+                H[i + p * j] = h;
+            }
+
+        if(!c_symmetric_eigen(p, H, w, S))
+            break;
+
+        //  order Ritz values by descending magnitude
+        for(int i = 0; i < p; ++i)
+        {
+            int t = i;
+            int j = i;
+            for(; j > 0 && fabs(w[order[j - 1]]) < fabs(w[t]); --j)
+                order[j] = order[j - 1];
+            order[j] = t;
+        }
+
+        //  Ritz vectors R = S Q and their images AR = S Z
+        fill_d_array(p * n, R, 0);
+        fill_d_array(p * n, AR, 0);
+        for(int i = 0; i < p; ++i)
+        {
+            const double* s = S + p * order[i];
+            double* r = R + n * i;
+            double* ar = AR + n * i;
+            for(int j = 0; j < p; ++j)
+            {
+                const double* q_j = Q + n * j;
+                const double* z_j = Z + n * j;
+                for(int t = 0; t < n; ++t)
+                {
+                    r[t] += s[j] * q_j[t];
+                    ar[t] += s[j] * z_j[t];
+                }
+            }
+        }
+
+        //  residuals ||A r - w r|| relative to the largest eigenvalue
+        double bound = tol * fabs(w[order[0]]);
+        converged = true;
+        for(int i = 0; i < k && converged; ++i)
+        {
+            double lambda = w[order[i]];
+            const double* r = R + n * i;
+            const double* ar = AR + n * i;
+            double residual = 0;
+            for(int t = 0; t < n; ++t)
+                residual += (ar[t] - lambda * r[t]) * (ar[t] - lambda * r[t]);
+            converged = sqrt(residual) <= bound;
+        }
+
+        for(int i = 0; i < k; ++i)
+            values[i] = w[order[i]];
+        copy_d_array(k * n, R, X);
+
+        if(!converged)
+        {
+            double* t = Q;
+            Q = AR;
+            AR = t;
+            orthonormalize_rows(n, p, Q, Z);
+        }
+    }
+
+    free(Q);
+    free(Z);
+    free(R);
+    free(AR);
+    free(H);
+    free(S);
+    free(w);
+    free(order);
+    return converged;
+}
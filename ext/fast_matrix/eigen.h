@@ -0,0 +1,16 @@
+#ifndef FAST_MATRIX_EIGEN_H
+#define FAST_MATRIX_EIGEN_H 1
+
+#include <stdbool.h>
+
+// A      - symmetric matrix n x n (only the lower triangle is read)
+// values - vector n, eigenvalues in ascending order
+// Z      - matrix n x n, row i is the eigenvector of values[i]
+bool c_symmetric_eigen(int n, const double* A, double* values, double* Z);
+
+// A      - symmetric matrix n x n
+// values - vector k, eigenvalues of largest magnitude in descending order of magnitude
+// X      - matrix k x n, row i is the eigenvector of values[i]
+bool c_top_eigen(int n, int k, const double* A, double tol, int max_iterations, double* values, double* X);
+
+#endif /* FAST_MATRIX_EIGEN_H */
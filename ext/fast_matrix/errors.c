@@ -2,6 +2,7 @@
 
 VALUE fm_eTypeError;
 VALUE fm_eIndexError;
+VALUE fm_eError;
 
 double raise_rb_value_to_double(VALUE v)
 {
@@ -34,4 +35,5 @@ void init_fm_errors()
     
     fm_eTypeError  = rb_define_class_under(mod, "TypeError",  rb_eTypeError);
     fm_eIndexError = rb_define_class_under(mod, "IndexError", rb_eIndexError);
+    fm_eError      = rb_define_class_under(mod, "Error",      rb_eStandardError);
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 extern VALUE fm_eTypeError;
 extern VALUE fm_eIndexError;
+extern VALUE fm_eError;
 
 //  convert ruby value to double or raise an error if this is not possible
 double raise_rb_value_to_double(VALUE v);
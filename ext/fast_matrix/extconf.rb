@@ -1,3 +1,13 @@
 require "mkmf"
 
+have_library("pthread")
+have_func("rb_ext_ractor_safe", "ruby.h")
+have_func("rb_ractor_local_storage_value_newkey", "ruby.h")
+# USDT probe fast_matrix:operation for dtrace, bpftrace and systemtap
+have_header("sys/sdt.h")
+
+# math functions never report errors through errno, so that
+# elementwise loops such as sqrt can be vectorized
+$CFLAGS << " -fno-math-errno" if try_cflags("-fno-math-errno")
+
 create_makefile("fast_matrix/fast_matrix")
@@ -4,7 +4,19 @@
 
 void Init_fast_matrix()
 {
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+    //  classes and error classes are assigned only here, kernels keep
+    //  no Ruby state and the thread pool is guarded by its own mutexes
+    rb_ext_ractor_safe(true);
+#endif
     init_fm_errors();
     init_fm_matrix();
     init_fm_vector();
+    init_fm_banded_matrix();
+    init_fm_future();
+    init_fm_npy();
+    init_fm_csv();
+    init_fm_profile();
+    init_fm_block();
+    init_fm_convolve();
 }
\ No newline at end of file
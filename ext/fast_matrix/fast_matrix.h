@@ -4,6 +4,13 @@
 #include "errors.h"
 #include "matrix.h"
 #include "vector.h"
+#include "banded_matrix.h"
+#include "future.h"
+#include "npy.h"
+#include "csv.h"
+#include "profile.h"
+#include "block.h"
+#include "convolve.h"
 
 void Init_fast_matrix();
 
@@ -0,0 +1,392 @@
+#include "future.h"
+#include "c_array_operations.h"
+#include "errors.h"
+#include "matrix.h"
+#include "parallel.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+VALUE cFuture;
+VALUE fm_eCancelledError;
+
+// Executor: a FIFO queue of futures served by native threads
+// started on the first submit. Workers never touch Ruby objects.
+
+#define MAX_EXECUTORS 64
+
+static pthread_mutex_t executor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t executor_cond = PTHREAD_COND_INITIALIZER;
+static struct future* queue_head = NULL;
+static struct future* queue_tail = NULL;
+static struct future* running[MAX_EXECUTORS];
+static int executors_count = 0;
+static bool executor_started = false;
+static bool atfork_registered = false;
+
+void future_mark(void* data);
+void future_free(void* data);
+size_t future_size(const void* data);
+
+const rb_data_type_t future_type =
+{
+    .wrap_struct_name = "future",
+    .function =
+    {
+        .dmark = future_mark,
+        .dfree = future_free,
+        .dsize = future_size,
+    },
+    .data = NULL,
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static void future_release(struct future* f)
+{
+    if(__atomic_sub_fetch(&f->refs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    close(f->fds[0]);
+    close(f->fds[1]);
+    free(f->A);
+    free(f->B);
+    free(f->C);
+    free(f);
+}
+
+//  the byte is never read, so the descriptor stays readable
+static void future_resolve(struct future* f, int state)
+{
+    __atomic_store_n(&f->state, state, __ATOMIC_RELEASE);
+    char byte = 1;
+    ssize_t written = write(f->fds[1], &byte, 1);
+    (void)written;
+}
+
+static void future_compute(struct future* f)
+{
+    switch(f->kind)
+    {
+    case FUTURE_MULTIPLY:
+        c_matrix_multiply(f->n, f->k, f->m, f->A, f->B, f->C);
+        break;
+    case FUTURE_STRASSEN:
+        fill_d_array(f->m * f->n, f->C, 0);
+        recursive_strassen(f->n, f->k, f->m, f->A, f->B, f->C);
+        break;
+    case FUTURE_DETERMINANT:
+        f->scalar = determinant(f->n, f->A);
+        break;
+    }
+}
+
+static void* executor_worker(void* data)
+{
+    int slot = (int)(long)data;
+
+    pthread_mutex_lock(&executor_mutex);
+    for(;;)
+    {
+        while(queue_head == NULL)
+            pthread_cond_wait(&executor_cond, &executor_mutex);
+
+        struct future* f = queue_head;
+        queue_head = f->next;
+        if(queue_head == NULL)
+            queue_tail = NULL;
+        f->next = NULL;
+
+        //  the state is changed under the mutex, so cancel either
+        //  sees a pending future or the worker skips it here
+        if(f->state == FUTURE_CANCELLED)
+        {
+            pthread_mutex_unlock(&executor_mutex);
+            future_release(f);
+            pthread_mutex_lock(&executor_mutex);
+            continue;
+        }
+        f->state = FUTURE_RUNNING;
+        running[slot] = f;
+        pthread_mutex_unlock(&executor_mutex);
+
+        future_compute(f);
+        future_resolve(f, FUTURE_DONE);
+
+        pthread_mutex_lock(&executor_mutex);
+        running[slot] = NULL;
+        pthread_mutex_unlock(&executor_mutex);
+        future_release(f);
+        pthread_mutex_lock(&executor_mutex);
+    }
+    return NULL;
+}
+
+//  the pipe is shared with the parent process, the child gets its own
+//  one on the same descriptors before it cancels the future
+static void future_cancel_in_child(struct future* f)
+{
+    int fds[2];
+    if(pipe(fds) == 0)
+    {
+        dup2(fds[0], f->fds[0]);
+        dup2(fds[1], f->fds[1]);
+        close(fds[0]);
+        close(fds[1]);
+    }
+    future_resolve(f, FUTURE_CANCELLED);
+}
+
+//  workers do not survive fork: futures they owned are cancelled
+//  in the child, and the child starts new workers on demand
+static void executor_after_fork()
+{
+    pthread_mutex_init(&executor_mutex, NULL);
+    pthread_cond_init(&executor_cond, NULL);
+
+    for(struct future* f = queue_head; f != NULL; f = f->next)
+        future_cancel_in_child(f);
+    queue_head = NULL;
+    queue_tail = NULL;
+
+    for(int i = 0; i < executors_count; ++i)
+        if(running[i] != NULL)
+        {
+            future_cancel_in_child(running[i]);
+            running[i] = NULL;
+        }
+    executors_count = 0;
+    executor_started = false;
+}
+
+static void executor_start()
+{
+    if(!atfork_registered)
+        pthread_atfork(NULL, NULL, executor_after_fork);
+    atfork_registered = true;
+    executor_started = true;
+
+    int count = parallel_threads_count();
+    for(int i = 0; i < count; ++i)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, executor_worker, (void*)(long)i) != 0)
+            break;
+        pthread_detach(thread);
+        ++executors_count;
+    }
+}
+
+// runs the future on the calling thread if no worker can be started
+static void executor_submit(struct future* f)
+{
+    pthread_mutex_lock(&executor_mutex);
+    if(!executor_started)
+        executor_start();
+
+    if(executors_count == 0)
+    {
+        pthread_mutex_unlock(&executor_mutex);
+        f->state = FUTURE_RUNNING;
+        future_compute(f);
+        future_resolve(f, FUTURE_DONE);
+        return;
+    }
+
+    ++f->refs;
+    if(queue_tail == NULL)
+        queue_head = f;
+    else
+        queue_tail->next = f;
+    queue_tail = f;
+    pthread_cond_signal(&executor_cond);
+    pthread_mutex_unlock(&executor_mutex);
+}
+
+void future_mark(void* data)
+{
+    rb_gc_mark(((struct future*)data)->value);
+}
+
+void future_free(void* data)
+{
+    struct future* f = data;
+    pthread_mutex_lock(&executor_mutex);
+    if(f->state == FUTURE_PENDING)
+        f->state = FUTURE_CANCELLED;
+    pthread_mutex_unlock(&executor_mutex);
+    future_release(f);
+}
+
+size_t future_size(const void* data)
+{
+    return sizeof(struct future);
+}
+
+static VALUE future_new(int kind, struct future** result)
+{
+    int fds[2];
+    if(pipe(fds) != 0)
+        rb_sys_fail("pipe");
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    struct future* f;
+    VALUE future = TypedData_Make_Struct(cFuture, struct future, &future_type, f);
+    f->refs = 1;
+    f->state = FUTURE_PENDING;
+    f->kind = kind;
+    f->fds[0] = fds[0];
+    f->fds[1] = fds[1];
+    f->value = Qnil;
+    *result = f;
+    return future;
+}
+
+static double* copy_data(int len, const double* data)
+{
+    double* copy = malloc(len * sizeof(double));
+    copy_d_array(len, data, copy);
+    return copy;
+}
+
+static VALUE matrix_multiply_async_kind(VALUE self, VALUE other, int kind)
+{
+    struct matrix* A;
+    struct matrix* B;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
+
+    if(A->m != B->n)
+        rb_raise(fm_eIndexError, "First columns differs from second rows");
+
+    struct future* f;
+    VALUE future = future_new(kind, &f);
+    f->m = B->m;
+    f->k = A->m;
+    f->n = A->n;
+    f->A = copy_data(A->m * A->n, A->data);
+    f->B = copy_data(B->m * B->n, B->data);
+    f->C = malloc(f->m * f->n * sizeof(double));
+
+    executor_submit(f);
+    return future;
+}
+
+VALUE matrix_multiply_async(VALUE self, VALUE other)
+{
+    return matrix_multiply_async_kind(self, other, FUTURE_MULTIPLY);
+}
+
+VALUE matrix_strassen_async(VALUE self, VALUE other)
+{
+    return matrix_multiply_async_kind(self, other, FUTURE_STRASSEN);
+}
+
+VALUE matrix_determinant_async(VALUE self)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    struct future* f;
+    VALUE future = future_new(FUTURE_DETERMINANT, &f);
+    f->n = A->n;
+    f->A = copy_data(A->m * A->n, A->data);
+
+    executor_submit(f);
+    return future;
+}
+
+VALUE future_ready(VALUE self)
+{
+    struct future* f;
+    TypedData_Get_Struct(self, struct future, &future_type, f);
+
+    int state = __atomic_load_n(&f->state, __ATOMIC_ACQUIRE);
+    return (state == FUTURE_DONE || state == FUTURE_CANCELLED) ? Qtrue : Qfalse;
+}
+
+VALUE future_cancelled(VALUE self)
+{
+    struct future* f;
+    TypedData_Get_Struct(self, struct future, &future_type, f);
+
+    return __atomic_load_n(&f->state, __ATOMIC_ACQUIRE) == FUTURE_CANCELLED ? Qtrue : Qfalse;
+}
+
+// only a future which has not started yet can be cancelled
+VALUE future_cancel(VALUE self)
+{
+    struct future* f;
+    TypedData_Get_Struct(self, struct future, &future_type, f);
+
+    bool cancelled = false;
+    pthread_mutex_lock(&executor_mutex);
+    if(f->state == FUTURE_PENDING)
+    {
+        future_resolve(f, FUTURE_CANCELLED);
+        cancelled = true;
+    }
+    pthread_mutex_unlock(&executor_mutex);
+    return cancelled ? Qtrue : Qfalse;
+}
+
+VALUE future_fileno(VALUE self)
+{
+    struct future* f;
+    TypedData_Get_Struct(self, struct future, &future_type, f);
+
+    return INT2NUM(f->fds[0]);
+}
+
+// result of the resolved future, the buffer of matrix moves into the Ruby object
+VALUE future_value(VALUE self)
+{
+    struct future* f;
+    TypedData_Get_Struct(self, struct future, &future_type, f);
+
+    int state = __atomic_load_n(&f->state, __ATOMIC_ACQUIRE);
+    if(state == FUTURE_CANCELLED)
+        rb_raise(fm_eCancelledError, "Future was cancelled");
+    if(state != FUTURE_DONE)
+        rb_raise(fm_eError, "Future is not resolved");
+
+    if(f->value != Qnil)
+        return f->value;
+
+    if(f->kind == FUTURE_DETERMINANT)
+        f->value = DBL2NUM(f->scalar);
+    else
+    {
+        struct matrix* R;
+        f->value = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+        R->m = f->m;
+        R->n = f->n;
+        R->data = f->C;
+        f->C = NULL;
+    }
+    return f->value;
+}
+
+void init_fm_future()
+{
+    VALUE  mod = rb_define_module("FastMatrix");
+    cFuture = rb_define_class_under(mod, "Future", rb_cObject);
+    fm_eCancelledError = rb_define_class_under(cFuture, "CancelledError", fm_eError);
+
+    rb_undef_alloc_func(cFuture);
+
+    rb_define_method(cFuture, "ready?", future_ready, 0);
+    rb_define_method(cFuture, "cancelled?", future_cancelled, 0);
+    rb_define_method(cFuture, "cancel", future_cancel, 0);
+    rb_define_method(cFuture, "fileno", future_fileno, 0);
+    rb_define_private_method(cFuture, "value_impl", future_value, 0);
+
+    rb_define_method(cMatrix, "multiply_async", matrix_multiply_async, 1);
+    rb_define_method(cMatrix, "strassen_async", matrix_strassen_async, 1);
+    rb_define_method(cMatrix, "determinant_async", matrix_determinant_async, 0);
+}
@@ -0,0 +1,52 @@
+#ifndef FAST_MATRIX_FUTURE_H
+#define FAST_MATRIX_FUTURE_H 1
+
+#include "ruby.h"
+
+extern VALUE cFuture;
+extern VALUE fm_eCancelledError;
+extern const rb_data_type_t future_type;
+
+enum future_state
+{
+    FUTURE_PENDING,
+    FUTURE_RUNNING,
+    FUTURE_DONE,
+    FUTURE_CANCELLED,
+};
+
+enum future_kind
+{
+    FUTURE_MULTIPLY,
+    FUTURE_STRASSEN,
+    FUTURE_DETERMINANT,
+};
+
+// Operation computed on a background native thread.
+// Inputs are copied on submit, so the receiver may change meanwhile.
+// The structure is shared by the Ruby object and the executor,
+// it is freed by whichever of them releases it last.
+struct future
+{
+    struct future* next;
+    int refs;
+    int state;
+    int kind;
+
+    //  A - matrix k x n, B - matrix m x k, C - matrix m x n
+    int n;
+    int k;
+    int m;
+    double* A;
+    double* B;
+    double* C;
+    double scalar;
+
+    //  the read end becomes readable when the future is resolved
+    int fds[2];
+    VALUE value;
+};
+
+void init_fm_future();
+
+#endif /* FAST_MATRIX_FUTURE_H */
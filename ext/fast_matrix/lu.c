@@ -0,0 +1,29 @@
+#include "lu.h"
+#include "c_array_operations.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LU_REAL double
+#define LU_FABS fabs
+#define LU_NAME(fn) fn
+#include "lu_template.inc"
+#undef LU_REAL
+#undef LU_FABS
+#undef LU_NAME
+
+#define LU_REAL float
+#define LU_FABS fabsf
+#define LU_NAME(fn) fn##_f
+#include "lu_template.inc"
+#undef LU_REAL
+#undef LU_FABS
+#undef LU_NAME
+
+void c_lu_inverse(int n, const double* LU, const int* perm, double* R)
+{
+    fill_d_array(n * n, R, 0);
+    for(int i = 0; i < n; ++i)
+        R[i + (size_t)n * i] = 1;
+    c_lu_solve(n, LU, perm, n, R);
+}
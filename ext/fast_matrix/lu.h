@@ -0,0 +1,27 @@
+#ifndef FAST_MATRIX_LU_H
+#define FAST_MATRIX_LU_H 1
+
+#include <stdbool.h>
+
+// LU decomposition with partial pivoting, in place: P A = L U,
+// L has unit diagonal and is stored below the diagonal of A.
+// A    - matrix n x n
+// perm - vector n, row perm[i] of the original matrix is row i of P A
+// returns false if A is singular
+bool c_lu_decompose(int n, double* A, int* perm);
+
+// solves A X = B for k right-hand sides using the decomposition above
+// LU - decomposed matrix n x n
+// B  - matrix k x n, replaced with X
+void c_lu_solve(int n, const double* LU, const int* perm, int k, double* B);
+
+// LU - decomposed matrix n x n
+// R  - matrix n x n, the inverse of the original matrix
+void c_lu_inverse(int n, const double* LU, const int* perm, double* R);
+
+// single precision versions of the above for mixed precision solves,
+// they move half the memory of the double ones
+bool c_lu_decompose_f(int n, float* A, int* perm);
+void c_lu_solve_f(int n, const float* LU, const int* perm, int k, float* B);
+
+#endif /* FAST_MATRIX_LU_H */
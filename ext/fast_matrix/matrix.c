@@ -1,678 +1,2352 @@
-#include "matrix.h"
-#include "c_array_operations.h"
-#include "errors.h"
-#include "vector.h"
-
-VALUE cMatrix;
-
-void matrix_free(void* data);
-size_t matrix_size(const void* data);
-
-const rb_data_type_t matrix_type =
-{
-    .wrap_struct_name = "matrix",
-    .function =
-    {
-        .dmark = NULL,
-        .dfree = matrix_free,
-        .dsize = matrix_size,
-    },
-    .data = NULL,
-    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
-};
-
-void matrix_free(void* data)
-{
-    free(((*(struct matrix*)data)).data);
-    free(data);
-}
-
-size_t matrix_size(const void* data)
-{
-	return sizeof(struct matrix);
-}
-
-VALUE matrix_alloc(VALUE self)
-{
-	struct matrix* mtx = malloc(sizeof(struct matrix));
-    mtx->data = NULL;
-	return TypedData_Wrap_Struct(self, &matrix_type, mtx);
-}
-
-void c_matrix_init(struct matrix* mtr, int m, int n)
-{
-    mtr->m = m;
-    mtr->n = n;
-    mtr->data = malloc(m * n * sizeof(double));
-}
-
-VALUE matrix_initialize(VALUE self, VALUE rows_count, VALUE columns_count)
-{
-	struct matrix* data;
-    int m = raise_rb_value_to_int(columns_count);
-    int n = raise_rb_value_to_int(rows_count);
-
-    if(m <= 0 || n <= 0)
-        rb_raise(fm_eIndexError, "Size cannot be negative or zero");
-
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
-
-    c_matrix_init(data, m, n);
-
-	return self;
-}
-
-//  []=
-VALUE matrix_set(VALUE self, VALUE row, VALUE column, VALUE v)
-{
-    int m = raise_rb_value_to_int(column);
-    int n = raise_rb_value_to_int(row);
-    double x = raise_rb_value_to_double(v);
-
-	struct matrix* data;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
-    
-    m = (m < 0) ? data->m + m : m;
-    n = (n < 0) ? data->n + n : n;
-
-    raise_check_range(m, 0, data->m);
-    raise_check_range(n, 0, data->n);
-
-    data->data[m + data->m * n] = x;
-    return v;
-}
-
-//  []
-VALUE matrix_get(VALUE self, VALUE row, VALUE column)
-{
-    int m = raise_rb_value_to_int(column);
-    int n = raise_rb_value_to_int(row);
-
-	struct matrix* data;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
-    
-    m = (m < 0) ? data->m + m : m;
-    n = (n < 0) ? data->n + n : n;
-    
-    if(m < 0 || n < 0 || n >= data->n || m >= data->m)
-        return Qnil;
-
-    return DBL2NUM(data->data[m + data->m * n]);
-}
-
-// in  - matrix m x n
-// out - matrix n x m
-void matrix_transpose(int m, int n, const double* in, double* out)
-{
-    for(int i = 0; i < m; ++i)
-        for(int j = 0; j < n; ++j)
-            out[j + n * i] = in[i + m * j];
-}
-
-// A - matrix k x n
-// B - matrix m x k
-// C - matrix m x n
-void c_matrix_multiply(int n, int k, int m, const double* A, const double* B, double* C)
-{
-    fill_d_array(m * n, C, 0);
-
-    for(int j = 0; j < n; ++j)
-    {
-        double* p_c = C + m * j;
-        const double* p_a = A + k * j;
-
-        for(int t = 0; t < k; ++t)
-        {
-            const double* p_b = B + m * t;
-            double d_a = p_a[t];
-            for(int i = 0; i < m; ++i)
-                p_c[i] += d_a * p_b[i];
-        }
-    }
-}
-
-// M - matrix m x n
-// V - vector m
-// R - vector n
-void c_matrix_vector_multiply(int n, int m, const double* M, const double* V, double* R)
-{
-    fill_d_array(n, R, 0);
-
-    for(int j = 0; j < n; ++j)
-    {
-        const double* p_m = M + m * j;
-        for(int i = 0; i < m; ++i)
-            R[j] += V[i] * p_m[i];
-    }
-}
-
-VALUE matrix_multiply_mv(VALUE self, VALUE other)
-{
-    struct matrix* M;
-    struct vector* V;
-    TypedData_Get_Struct(self, struct matrix, &matrix_type, M);
-    TypedData_Get_Struct(other, struct vector, &vector_type, V);
-
-    if(M->m != V->n)
-        rb_raise(fm_eIndexError, "Matrix columns differs from vector size");
-
-    int m = M->m;
-    int n = M->n;
-
-    struct vector* R;
-    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
-
-    c_vector_init(R, n);
-    c_matrix_vector_multiply(n, m, M->data, V->data, R->data);
-
-    return result;
-}
-
-// A - matrix k x n
-// B - matrix m x k
-// C - matrix m x n
-void strassen_iteration(int n, int k, int m, const double* A, const double* B, double* C, int s_a, int s_b, int s_c)
-{
-    for(int j = 0; j < n; ++j)
-    {
-        double* p_c = C + s_c * j;
-        const double* p_a = A + s_a * j;
-
-        for(int t = 0; t < k; ++t)
-        {
-            const double* p_b = B + s_b * t;
-            double d_a = p_a[t];
-            for(int i = 0; i < m; ++i)
-                p_c[i] += d_a * p_b[i];
-        }
-    }
-}
-
-bool check_strassen(int m, int n, int k)
-{
-    return n > 2 && m > 2 && k > 2 && (double)m * (double)n * (double)k > 100000000;
-}
-
-
-void strassen_copy(int m, int n, const double* A, double* B, int s_a, int s_b)
-{
-    for(int i = 0; i < n; ++i)
-    {
-        const double* p_A = A + i * s_a;
-        double* p_B = B + i * s_b;
-        for(int j = 0; j < m; ++j)
-            p_B[j] = p_A[j];
-    }
-}
-
-void strassen_sum_to_first(int m, int n, double* A, const double* B, int s_a, int s_b)
-{
-    for(int i = 0; i < n; ++i)
-    {
-        double* p_A = A + i * s_a;
-        const double* p_B = B + i * s_b;
-        for(int j = 0; j < m; ++j)
-            p_A[j] += p_B[j];
-    }
-}
-
-void strassen_sub_to_first(int m, int n, double* A, const double* B, int s_a, int s_b)
-{
-    for(int i = 0; i < n; ++i)
-    {
-        double* p_A = A + i * s_a;
-        const double* p_B = B + i * s_b;
-        for(int j = 0; j < m; ++j)
-            p_A[j] -= p_B[j];
-    }
-}
-
-// A - matrix k x n
-// B - matrix m x k
-// C - matrix m x n
-void recursive_strassen(int n, int k, int m, const double* A, const double* B, double* C)
-{
-    if(!check_strassen(m, n, k))
-        return c_matrix_multiply(n, k, m, A, B, C);
-
-    int k2 = k / 2;
-    int k1 = k - k2;
-    int m2 = m / 2;
-    int m1 = m - m2;
-    int n2 = n / 2;
-    int n1 = n - n2;
-
-    double* termA = malloc(k1 * n1 * sizeof(double));
-    double* termB = malloc(m1 * k1 * sizeof(double));
-
-    double* P1 = malloc(7 * m1 * n1 * sizeof(double));
-    double* P2 = P1 + m1 * n1;
-    double* P3 = P2 + m1 * n1;
-    double* P4 = P3 + m1 * n1;
-    double* P5 = P4 + m1 * n1;
-    double* P6 = P5 + m1 * n1;
-    double* P7 = P6 + m1 * n1;
-    fill_d_array(7 * m1 * n1, P1, 0);
-    fill_d_array(k1 * n1, termA, 0);
-    fill_d_array(m1 * k1, termB, 0);
-
-    //  -----------P1-----------
-    strassen_copy(k1, n1, A, termA, k, k1);
-    strassen_sum_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
-    
-    strassen_copy(m1, k1, B, termB, m, m1);
-    strassen_sum_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
-
-    recursive_strassen(n1, k1, m1, termA, termB, P1);
-    fill_d_array(k1 * n1, termA, 0);
-    //  -----------P2-----------
-    strassen_copy(k1, n2, A + k * n1, termA, k, k1);
-    strassen_sum_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
-    
-    strassen_copy(m1, k1, B, termB, m, m1);
-
-    recursive_strassen(n1, k1, m1, termA, termB, P2);
-    fill_d_array(m1 * k1, termB, 0);
-    //  -----------P3-----------
-    strassen_copy(k1, n1, A, termA, k, k1);
-    
-    strassen_copy(m2, k1, B + m1, termB, m, m1);
-    strassen_sub_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
-    
-    recursive_strassen(n1, k1, m1, termA, termB, P3);
-    fill_d_array(k1 * n1, termA, 0);
-    fill_d_array(m1 * k1, termB, 0);
-    //  -----------P4-----------
-    strassen_copy(k2, n2, A + k1 + k * n1, termA, k, k1);
-    
-    strassen_copy(m1, k2, B + m * k1, termB, m, m1);
-    strassen_sub_to_first(m1, k1, termB, B, m1, m);
-    
-    recursive_strassen(n1, k1, m1, termA, termB, P4);
-    fill_d_array(m1 * k1, termB, 0);
-    //  -----------P5-----------
-    strassen_copy(k1, n1, A, termA, k, k1);
-    strassen_sum_to_first(k2, n1, termA, A + k1, k1, k);
-    
-    strassen_copy(m2, k2, B + m1 + m * k1, termB, m, m1);
-    
-    recursive_strassen(n1, k1, m1, termA, termB, P5);
-    fill_d_array(k1 * n1, termA, 0);
-    //  -----------P6-----------
-    strassen_copy(k1, n2, A + k * n1, termA, k, k1);
-    strassen_sub_to_first(k1, n1, termA, A, k1, k);
-    
-    strassen_copy(m1, k1, B, termB, m, m1);
-    strassen_sum_to_first(m2, k1, termB, B + m1, m1, m);
-    
-    recursive_strassen(n1, k1, m1, termA, termB, P6);
-    fill_d_array(k1 * n1, termA, 0);
-    fill_d_array(m1 * k1, termB, 0);
-    //  -----------P7-----------
-    strassen_copy(k2, n1, A + k1, termA, k, k1);
-    strassen_sub_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
-    
-    strassen_copy(m1, k2, B + k1 * m, termB, m, m1);
-    strassen_sum_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
-    
-    recursive_strassen(n1, k1, m1, termA, termB, P7);
-
-    //  -----------C11-----------
-    double* C11 = C;
-    strassen_copy(m1, n1, P1, C11, m1, m);
-    strassen_sum_to_first(m1, n1, C11, P4, m, m1);
-    strassen_sub_to_first(m1, n1, C11, P5, m, m1);
-    strassen_sum_to_first(m1, n1, C11, P7, m, m1);
-    //  -----------C12-----------
-    double* C12 = C + m1;
-    strassen_copy(m2, n1, P3, C12, m1, m);
-    strassen_sum_to_first(m2, n1, C12, P5, m, m1);
-    //  -----------C21-----------
-    double* C21 = C + m * n1;
-    strassen_copy(m1, n2, P2, C21, m1, m);
-    strassen_sum_to_first(m1, n2, C21, P4, m, m1);
-    //  -----------C22-----------
-    double* C22 = C + m1 + m * n1;
-    strassen_copy(m2, n2, P1, C22, m1, m);
-    strassen_sub_to_first(m2, n2, C22, P2, m, m1);
-    strassen_sum_to_first(m2, n2, C22, P3, m, m1);
-    strassen_sum_to_first(m2, n2, C22, P6, m, m1);
-    
-    free(termA);
-    free(termB);
-    free(P1);
-}
-
-VALUE strassen(VALUE self, VALUE other)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
-
-    if(A->m != B->n)
-        rb_raise(fm_eIndexError, "First columns differs from second rows");
-
-    int m = B->m;
-    int k = A->m;
-    int n = A->n;
-
-    struct matrix* C;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
-
-    c_matrix_init(C, m, n);
-    fill_d_array(m * n, C->data, 0);
-    recursive_strassen(n, k, m, A->data, B->data, C->data);
-    return result;
-}
-
-VALUE matrix_multiply_mm(VALUE self, VALUE other)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
-
-    if(A->m != B->n)
-        rb_raise(fm_eIndexError, "First columns differs from second rows");
-
-    int m = B->m;
-    int k = A->m;
-    int n = A->n;
-
-    struct matrix* C;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
-
-    c_matrix_init(C, m, n);
-    c_matrix_multiply(n, k, m, A->data, B->data, C->data);
-
-    return result;
-}
-
-VALUE matrix_multiply_mn(VALUE self, VALUE value)
-{
-	struct matrix* A;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-
-    double d = NUM2DBL(value);
-
-    struct matrix* R;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
-
-    c_matrix_init(R, A->m, A->n);
-    copy_d_array(A->m * A->n, A->data, R->data);
-    multiply_d_array(R->m * R->n, R->data, d);
-
-    return result;
-}
-
-VALUE matrix_multiply(VALUE self, VALUE v)
-{
-    if(RB_FLOAT_TYPE_P(v) || FIXNUM_P(v)
-        || RB_TYPE_P(v, T_BIGNUM))
-        return matrix_multiply_mn(self, v);
-    if(RBASIC_CLASS(v) == cMatrix)
-        return matrix_multiply_mm(self, v);
-    if(RBASIC_CLASS(v) == cVector);
-        return matrix_multiply_mv(self, v);
-    rb_raise(fm_eTypeError, "Invalid klass for multiply");
-}
-
-VALUE matrix_copy(VALUE mtrx)
-{
-	struct matrix* M;
-	TypedData_Get_Struct(mtrx, struct matrix, &matrix_type, M);
-
-    struct matrix* R;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
-
-    c_matrix_init(R, M->m, M->n);
-    copy_d_array(M->m * M->n, M->data, R->data);
-
-    return result;
-}
-
-VALUE row_size(VALUE self)
-{
-	struct matrix* data;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
-    return INT2NUM(data->m);
-}
-
-VALUE column_size(VALUE self)
-{
-	struct matrix* data;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
-    return INT2NUM(data->n);
-}
-
-VALUE transpose(VALUE self)
-{
-	struct matrix* M;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, M);
-
-    struct matrix* R;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
-
-    c_matrix_init(R, M->n, M->m);
-    matrix_transpose(M->m, M->n, M->data, R->data);
-
-    return result;
-}
-
-VALUE matrix_add_with(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->m != B->m && A->n != B->n)
-        rb_raise(fm_eIndexError, "Different sizes matrices");
-
-    int m = B->m;
-    int n = A->n;
-
-    struct matrix* C;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
-
-    c_matrix_init(C, m, n);
-    add_d_arrays_to_result(n * m, A->data, B->data, C->data);
-
-    return result;
-}
-
-VALUE matrix_add_from(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->m != B->m && A->n != B->n)
-        rb_raise(fm_eIndexError, "Different sizes matrices");
-
-    int m = B->m;
-    int n = A->n;
-
-    add_d_arrays_to_first(n * m, A->data, B->data);
-
-    return self;
-}
-
-
-VALUE matrix_sub_with(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->m != B->m && A->n != B->n)
-        rb_raise(fm_eIndexError, "Different sizes matrices");
-
-    int m = B->m;
-    int n = A->n;
-
-    struct matrix* C;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
-
-    c_matrix_init(C, m, n);
-    sub_d_arrays_to_result(n * m, A->data, B->data, C->data);
-
-    return result;
-}
-
-double determinant(int n, const double* A)
-{
-    double* M = malloc(n * n * sizeof(double));
-    double det = 1;
-    copy_d_array(n * n, A, M);
-
-    for(int i = 0; i < n; ++i)
-    {
-        const double* line_p = M + i + i * n;
-        double current = *line_p; 
-        det *= current;
-
-        if(current == 0)
-        {
-            free(M);
-            return 0;
-        }
-
-        for(int j = i + 1; j < n; ++j)
-        {
-            double* t_line = M + i + j * n;
-            double head = *t_line;
-            for(int k = 1; k < n - i; ++k)
-                t_line[k] -= line_p[k] * head / current;
-        }
-    }
-
-    free(M);
-    return det;
-}
-
-VALUE matrix_determinant(VALUE self)
-{
-    struct matrix* A;
-    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-
-    
-    int m = A->m;
-    int n = A->n;
-    if(m != n)
-        rb_raise(fm_eIndexError, "Not a square matrix");
-
-    return DBL2NUM(determinant(n, A->data));
-}
-
-VALUE matrix_sub_from(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->m != B->m && A->n != B->n)
-        rb_raise(fm_eIndexError, "Different sizes matrices");
-
-    int m = B->m;
-    int n = A->n;
-
-    sub_d_arrays_to_first(n * m, A->data, B->data);
-
-    return self;
-}
-
-VALUE matrix_fill(VALUE self, VALUE value)
-{
-    double d = raise_rb_value_to_double(value);
-	struct matrix* A;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-
-    fill_d_array(A->m * A->n, A->data, d);
-
-    return self;
-}
-
-VALUE matrix_equal(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->n != B->n || A->m != B->m)
-		return Qfalse;
-
-    int n = A->n;
-    int m = B->m;
-
-    if(equal_d_arrays(n * m, A->data, B->data))
-		return Qtrue;
-	return Qfalse;
-}
-
-VALUE matrix_abs(VALUE self)
-{
-	struct matrix* A;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-
-    int m = A->m;
-    int n = A->n;
-
-    struct matrix* B;
-    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, B);
-
-    c_matrix_init(B, m, n);
-    abs_d_array(n * m, A->data, B->data);
-
-    return result;
-}
-
-VALUE matrix_greater_or_equal(VALUE self, VALUE value)
-{
-	struct matrix* A;
-    struct matrix* B;
-	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
-	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
-
-    if(A->m != B->m && A->n != B->n)
-        rb_raise(fm_eIndexError, "Different sizes matrices");
-
-    int m = B->m;
-    int n = A->n;
-
-    if(greater_or_equal_d_array(n * m, A->data, B->data))
-        return Qtrue;
-    return Qfalse;
-}
-
-void init_fm_matrix()
-{
-    VALUE  mod = rb_define_module("FastMatrix");
-	cMatrix = rb_define_class_under(mod, "Matrix", rb_cData);
-
-	rb_define_alloc_func(cMatrix, matrix_alloc);
-
-	rb_define_method(cMatrix, "initialize", matrix_initialize, 2);
-	rb_define_method(cMatrix, "[]", matrix_get, 2);
-	rb_define_method(cMatrix, "[]=", matrix_set, 3);
-	rb_define_method(cMatrix, "*", matrix_multiply, 1);
-	rb_define_method(cMatrix, "column_count", row_size, 0);
-	rb_define_method(cMatrix, "row_count", column_size, 0);
-	rb_define_method(cMatrix, "clone", matrix_copy, 0);
-	rb_define_method(cMatrix, "transpose", transpose, 0);
-	rb_define_method(cMatrix, "+", matrix_add_with, 1);
-	rb_define_method(cMatrix, "+=", matrix_add_from, 1);
-	rb_define_method(cMatrix, "-", matrix_sub_with, 1);
-	rb_define_method(cMatrix, "-=", matrix_sub_from, 1);
-	rb_define_method(cMatrix, "fill!", matrix_fill, 1);
-    rb_define_method(cMatrix, "strassen", strassen, 1);
-    rb_define_method(cMatrix, "abs", matrix_abs, 0);
-    rb_define_method(cMatrix, ">=", matrix_greater_or_equal, 1);
-    rb_define_method(cMatrix, "determinant", matrix_determinant, 0);
-    rb_define_method(cMatrix, "eql?", matrix_equal, 1);
-}
+#include "matrix.h"
+#include "c_array_operations.h"
+#include "errors.h"
+#include "vector.h"
+#include "eigen.h"
+#include "parallel.h"
+#include "random.h"
+#include "lu.h"
+#include "profile.h"
+#include "cache.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+VALUE cMatrix;
+
+void matrix_free(void* data);
+size_t matrix_size(const void* data);
+
+const rb_data_type_t matrix_type =
+{
+    .wrap_struct_name = "matrix",
+    .function =
+    {
+        .dmark = NULL,
+        .dfree = matrix_free,
+        .dsize = matrix_size,
+    },
+    .data = NULL,
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_FROZEN_SHAREABLE,
+#else
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+#endif
+};
+
+void matrix_free(void* data)
+{
+    struct matrix* M = data;
+    release_d_array(M->data, M->shared);
+    c_matrix_cache_free(M->cache);
+    free(data);
+}
+
+size_t matrix_size(const void* data)
+{
+	return sizeof(struct matrix);
+}
+
+VALUE matrix_alloc(VALUE self)
+{
+	struct matrix* mtx = malloc(sizeof(struct matrix));
+    mtx->data = NULL;
+    mtx->shared = NULL;
+    mtx->version = 0;
+    mtx->cache = NULL;
+	return TypedData_Wrap_Struct(self, &matrix_type, mtx);
+}
+
+//  every dense matrix is allocated here, so the element count is checked once for all
+void c_matrix_init(struct matrix* mtr, int m, int n)
+{
+    if(n > 0 && m > INT_MAX / n)
+        rb_raise(fm_eIndexError, "Matrix is too large");
+    mtr->m = m;
+    mtr->n = n;
+    mtr->data = malloc(m * n * sizeof(double));
+    mtr->shared = NULL;
+    mtr->version = 0;
+    mtr->cache = NULL;
+}
+
+//  a frozen matrix is never changed, so the cache is dropped only
+//  by the ractor which owns the matrix
+void c_matrix_modify(struct matrix* A)
+{
+    unshare_d_array(A->m * A->n, &A->data, &A->shared);
+    ++A->version;
+    if(A->cache != NULL)
+    {
+        c_matrix_cache_free(A->cache);
+        A->cache = NULL;
+    }
+}
+
+VALUE matrix_initialize(VALUE self, VALUE rows_count, VALUE columns_count)
+{
+	struct matrix* data;
+    int m = raise_rb_value_to_int(columns_count);
+    int n = raise_rb_value_to_int(rows_count);
+
+    if(m <= 0 || n <= 0)
+        rb_raise(fm_eIndexError, "Size cannot be negative or zero");
+
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
+
+    unsigned long long start = PROFILE_START();
+    c_matrix_init(data, m, n);
+    PROFILE_FINISH(PROFILE_MATRIX_NEW, start, n, m, 0, 8ULL * m * n);
+
+	return self;
+}
+
+//  []=
+VALUE matrix_set(VALUE self, VALUE row, VALUE column, VALUE v)
+{
+    rb_check_frozen(self);
+    int m = raise_rb_value_to_int(column);
+    int n = raise_rb_value_to_int(row);
+    double x = raise_rb_value_to_double(v);
+
+	struct matrix* data;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
+    
+    m = (m < 0) ? data->m + m : m;
+    n = (n < 0) ? data->n + n : n;
+
+    raise_check_range(m, 0, data->m);
+    raise_check_range(n, 0, data->n);
+
+    c_matrix_modify(data);
+    data->data[m + data->m * n] = x;
+    return v;
+}
+
+// R[i, j] = A[i, columns[j]]
+// A - matrix m x n
+// R - matrix count x n
+void c_matrix_gather_columns(int m, int n, const double* A, int count, const int* columns, double* R)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        const double* p_a = A + (size_t)m * i;
+        double* p_r = R + (size_t)count * i;
+        for(int j = 0; j < count; ++j)
+            p_r[j] = p_a[columns[j]];
+    }
+}
+
+// R[i] = A[rows[i]], rows are copied whole
+// A - matrix m x n
+// R - matrix m x count
+void c_matrix_gather_rows(int m, const double* A, int count, const int* rows, double* R)
+{
+    for(int i = 0; i < count; ++i)
+        memcpy(R + (size_t)m * i, A + (size_t)m * rows[i], m * sizeof(double));
+}
+
+// range -> (begin, length) in [0, size), false if it starts out of range
+static bool matrix_range_arg(VALUE range, int size, long* begin, long* len)
+{
+    if(rb_obj_is_kind_of(range, rb_cRange))
+        return rb_range_beg_len(range, begin, len, size, 0) == Qtrue && *len > 0;
+
+    int i = raise_rb_value_to_int(range);
+    i = (i < 0) ? size + i : i;
+    *begin = i;
+    *len = 1;
+    return i >= 0 && i < size;
+}
+
+static VALUE matrix_slice(VALUE self, VALUE row, VALUE column)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    long row_begin, row_count, column_begin, column_count;
+    if(!matrix_range_arg(row, A->n, &row_begin, &row_count)
+        || !matrix_range_arg(column, A->m, &column_begin, &column_count))
+        return Qnil;
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, column_count, row_count);
+
+    for(int i = 0; i < row_count; ++i)
+        memcpy(R->data + (size_t)column_count * i,
+               A->data + (size_t)A->m * (row_begin + i) + column_begin,
+               column_count * sizeof(double));
+    return result;
+}
+
+//  []
+VALUE matrix_get(VALUE self, VALUE row, VALUE column)
+{
+    if(rb_obj_is_kind_of(row, rb_cRange) || rb_obj_is_kind_of(column, rb_cRange))
+        return matrix_slice(self, row, column);
+
+    int m = raise_rb_value_to_int(column);
+    int n = raise_rb_value_to_int(row);
+
+	struct matrix* data;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
+    
+    m = (m < 0) ? data->m + m : m;
+    n = (n < 0) ? data->n + n : n;
+    
+    if(m < 0 || n < 0 || n >= data->n || m >= data->m)
+        return Qnil;
+
+    return DBL2NUM(data->data[m + data->m * n]);
+}
+
+// in  - matrix m x n
+// out - matrix n x m
+void matrix_transpose(int m, int n, const double* in, double* out)
+{
+    for(int i = 0; i < m; ++i)
+        for(int j = 0; j < n; ++j)
+            out[j + n * i] = in[i + m * j];
+}
+
+// A - matrix k x n
+// B - matrix m x k
+// C - matrix m x n
+void c_matrix_multiply(int n, int k, int m, const double* A, const double* B, double* C)
+{
+    fill_d_array(m * n, C, 0);
+
+    for(int j = 0; j < n; ++j)
+    {
+        double* p_c = C + m * j;
+        const double* p_a = A + k * j;
+
+        for(int t = 0; t < k; ++t)
+        {
+            const double* p_b = B + m * t;
+            double d_a = p_a[t];
+            for(int i = 0; i < m; ++i)
+                p_c[i] += d_a * p_b[i];
+        }
+    }
+}
+
+struct matrix_vector_args
+{
+    int n;
+    int m;
+    int tasks;
+    const double* M;
+    const double* V;
+    double* R;
+};
+
+static void matrix_vector_task(void* data, int task)
+{
+    struct matrix_vector_args* args = data;
+    int begin = (int)((long long)args->n * task / args->tasks);
+    int end = (int)((long long)args->n * (task + 1) / args->tasks);
+
+    for(int j = begin; j < end; ++j)
+        args->R[j] = dot_d_arrays(args->m, args->M + (size_t)args->m * j, args->V);
+}
+
+// M - matrix m x n
+// V - vector m
+// R - vector n
+void c_matrix_vector_multiply(int n, int m, const double* M, const double* V, double* R)
+{
+    struct matrix_vector_args args = { n, m, 1, M, V, R };
+    if((double)m * n > 1 << 17)
+        args.tasks = parallel_threads_count();
+    if(args.tasks > n)
+        args.tasks = n;
+
+    parallel_for(args.tasks, matrix_vector_task, &args);
+}
+
+VALUE matrix_multiply_mv(VALUE self, VALUE other)
+{
+    struct matrix* M;
+    struct vector* V;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, M);
+    TypedData_Get_Struct(other, struct vector, &vector_type, V);
+
+    if(M->m != V->n)
+        rb_raise(fm_eIndexError, "Matrix columns differs from vector size");
+
+    int m = M->m;
+    int n = M->n;
+
+    unsigned long long start = PROFILE_START();
+    struct vector* R;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+
+    c_vector_init(R, n);
+    c_matrix_vector_multiply(n, m, M->data, V->data, R->data);
+    PROFILE_FINISH(PROFILE_MATRIX_MULTIPLY, start, n, m, 2ULL * m * n, 8ULL * n);
+
+    return result;
+}
+
+// A - matrix k x n
+// B - matrix m x k
+// C - matrix m x n
+void strassen_iteration(int n, int k, int m, const double* A, const double* B, double* C, int s_a, int s_b, int s_c)
+{
+    for(int j = 0; j < n; ++j)
+    {
+        double* p_c = C + s_c * j;
+        const double* p_a = A + s_a * j;
+
+        for(int t = 0; t < k; ++t)
+        {
+            const double* p_b = B + s_b * t;
+            double d_a = p_a[t];
+            for(int i = 0; i < m; ++i)
+                p_c[i] += d_a * p_b[i];
+        }
+    }
+}
+
+bool check_strassen(int m, int n, int k)
+{
+    return n > 2 && m > 2 && k > 2 && (double)m * (double)n * (double)k > 100000000;
+}
+
+
+void strassen_copy(int m, int n, const double* A, double* B, int s_a, int s_b)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        const double* p_A = A + i * s_a;
+        double* p_B = B + i * s_b;
+        for(int j = 0; j < m; ++j)
+            p_B[j] = p_A[j];
+    }
+}
+
+void strassen_sum_to_first(int m, int n, double* A, const double* B, int s_a, int s_b)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        double* p_A = A + i * s_a;
+        const double* p_B = B + i * s_b;
+        for(int j = 0; j < m; ++j)
+            p_A[j] += p_B[j];
+    }
+}
+
+void strassen_sub_to_first(int m, int n, double* A, const double* B, int s_a, int s_b)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        double* p_A = A + i * s_a;
+        const double* p_B = B + i * s_b;
+        for(int j = 0; j < m; ++j)
+            p_A[j] -= p_B[j];
+    }
+}
+
+// A - matrix k x n
+// B - matrix m x k
+// C - matrix m x n
+void recursive_strassen(int n, int k, int m, const double* A, const double* B, double* C)
+{
+    if(!check_strassen(m, n, k))
+        return c_matrix_multiply(n, k, m, A, B, C);
+
+    int k2 = k / 2;
+    int k1 = k - k2;
+    int m2 = m / 2;
+    int m1 = m - m2;
+    int n2 = n / 2;
+    int n1 = n - n2;
+
+    double* termA = malloc(k1 * n1 * sizeof(double));
+    double* termB = malloc(m1 * k1 * sizeof(double));
+
+    double* P1 = malloc(7 * m1 * n1 * sizeof(double));
+    double* P2 = P1 + m1 * n1;
+    double* P3 = P2 + m1 * n1;
+    double* P4 = P3 + m1 * n1;
+    double* P5 = P4 + m1 * n1;
+    double* P6 = P5 + m1 * n1;
+    double* P7 = P6 + m1 * n1;
+    fill_d_array(7 * m1 * n1, P1, 0);
+    fill_d_array(k1 * n1, termA, 0);
+    fill_d_array(m1 * k1, termB, 0);
+
+    //  -----------P1-----------
+    strassen_copy(k1, n1, A, termA, k, k1);
+    strassen_sum_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
+    
+    strassen_copy(m1, k1, B, termB, m, m1);
+    strassen_sum_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
+
+    recursive_strassen(n1, k1, m1, termA, termB, P1);
+    fill_d_array(k1 * n1, termA, 0);
+    //  -----------P2-----------
+    strassen_copy(k1, n2, A + k * n1, termA, k, k1);
+    strassen_sum_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
+    
+    strassen_copy(m1, k1, B, termB, m, m1);
+
+    recursive_strassen(n1, k1, m1, termA, termB, P2);
+    fill_d_array(m1 * k1, termB, 0);
+    //  -----------P3-----------
+    strassen_copy(k1, n1, A, termA, k, k1);
+    
+    strassen_copy(m2, k1, B + m1, termB, m, m1);
+    strassen_sub_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
+    
+    recursive_strassen(n1, k1, m1, termA, termB, P3);
+    fill_d_array(k1 * n1, termA, 0);
+    fill_d_array(m1 * k1, termB, 0);
+    //  -----------P4-----------
+    strassen_copy(k2, n2, A + k1 + k * n1, termA, k, k1);
+    
+    strassen_copy(m1, k2, B + m * k1, termB, m, m1);
+    strassen_sub_to_first(m1, k1, termB, B, m1, m);
+    
+    recursive_strassen(n1, k1, m1, termA, termB, P4);
+    fill_d_array(m1 * k1, termB, 0);
+    //  -----------P5-----------
+    strassen_copy(k1, n1, A, termA, k, k1);
+    strassen_sum_to_first(k2, n1, termA, A + k1, k1, k);
+    
+    strassen_copy(m2, k2, B + m1 + m * k1, termB, m, m1);
+    
+    recursive_strassen(n1, k1, m1, termA, termB, P5);
+    fill_d_array(k1 * n1, termA, 0);
+    //  -----------P6-----------
+    strassen_copy(k1, n2, A + k * n1, termA, k, k1);
+    strassen_sub_to_first(k1, n1, termA, A, k1, k);
+    
+    strassen_copy(m1, k1, B, termB, m, m1);
+    strassen_sum_to_first(m2, k1, termB, B + m1, m1, m);
+    
+    recursive_strassen(n1, k1, m1, termA, termB, P6);
+    fill_d_array(k1 * n1, termA, 0);
+    fill_d_array(m1 * k1, termB, 0);
+    //  -----------P7-----------
+    strassen_copy(k2, n1, A + k1, termA, k, k1);
+    strassen_sub_to_first(k2, n2, termA, A + k1 + k * n1, k1, k);
+    
+    strassen_copy(m1, k2, B + k1 * m, termB, m, m1);
+    strassen_sum_to_first(m2, k2, termB, B + m1 + m * k1, m1, m);
+    
+    recursive_strassen(n1, k1, m1, termA, termB, P7);
+
+    //  -----------C11-----------
+    double* C11 = C;
+    strassen_copy(m1, n1, P1, C11, m1, m);
+    strassen_sum_to_first(m1, n1, C11, P4, m, m1);
+    strassen_sub_to_first(m1, n1, C11, P5, m, m1);
+    strassen_sum_to_first(m1, n1, C11, P7, m, m1);
+    //  -----------C12-----------
+    double* C12 = C + m1;
+    strassen_copy(m2, n1, P3, C12, m1, m);
+    strassen_sum_to_first(m2, n1, C12, P5, m, m1);
+    //  -----------C21-----------
+    double* C21 = C + m * n1;
+    strassen_copy(m1, n2, P2, C21, m1, m);
+    strassen_sum_to_first(m1, n2, C21, P4, m, m1);
+    //  -----------C22-----------
+    double* C22 = C + m1 + m * n1;
+    strassen_copy(m2, n2, P1, C22, m1, m);
+    strassen_sub_to_first(m2, n2, C22, P2, m, m1);
+    strassen_sum_to_first(m2, n2, C22, P3, m, m1);
+    strassen_sum_to_first(m2, n2, C22, P6, m, m1);
+    
+    free(termA);
+    free(termB);
+    free(P1);
+}
+
+VALUE strassen(VALUE self, VALUE other)
+{
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
+
+    if(A->m != B->n)
+        rb_raise(fm_eIndexError, "First columns differs from second rows");
+
+    int m = B->m;
+    int k = A->m;
+    int n = A->n;
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* C;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
+
+    c_matrix_init(C, m, n);
+    fill_d_array(m * n, C->data, 0);
+    recursive_strassen(n, k, m, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_MATRIX_STRASSEN, start, n, k, 2ULL * m * n * k, 8ULL * m * n);
+    return result;
+}
+
+VALUE matrix_multiply_mm(VALUE self, VALUE other)
+{
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
+
+    if(A->m != B->n)
+        rb_raise(fm_eIndexError, "First columns differs from second rows");
+
+    int m = B->m;
+    int k = A->m;
+    int n = A->n;
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* C;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
+
+    c_matrix_init(C, m, n);
+    c_matrix_multiply(n, k, m, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_MATRIX_MULTIPLY, start, n, k, 2ULL * m * n * k, 8ULL * m * n);
+
+    return result;
+}
+
+VALUE matrix_multiply_mn(VALUE self, VALUE value)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    double d = NUM2DBL(value);
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+
+    c_matrix_init(R, A->m, A->n);
+    copy_d_array(A->m * A->n, A->data, R->data);
+    multiply_d_array(R->m * R->n, R->data, d);
+    PROFILE_FINISH(PROFILE_MATRIX_MULTIPLY, start, A->n, A->m, 1ULL * A->m * A->n, 8ULL * A->m * A->n);
+
+    return result;
+}
+
+VALUE matrix_multiply(VALUE self, VALUE v)
+{
+    if(RB_FLOAT_TYPE_P(v) || FIXNUM_P(v)
+        || RB_TYPE_P(v, T_BIGNUM))
+        return matrix_multiply_mn(self, v);
+    if(RBASIC_CLASS(v) == cMatrix)
+        return matrix_multiply_mm(self, v);
+    if(RBASIC_CLASS(v) == cVector);
+        return matrix_multiply_mv(self, v);
+    rb_raise(fm_eTypeError, "Invalid klass for multiply");
+}
+
+// the clone shares the buffer until one of them is changed
+VALUE matrix_copy(VALUE mtrx)
+{
+	struct matrix* M;
+	TypedData_Get_Struct(mtrx, struct matrix, &matrix_type, M);
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+
+    R->m = M->m;
+    R->n = M->n;
+    R->shared = share_d_array(&M->shared);
+    R->data = M->data;
+    PROFILE_FINISH(PROFILE_MATRIX_CLONE, start, M->n, M->m, 0, 0);
+
+    return result;
+}
+
+VALUE row_size(VALUE self)
+{
+	struct matrix* data;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
+    return INT2NUM(data->m);
+}
+
+VALUE column_size(VALUE self)
+{
+	struct matrix* data;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, data);
+    return INT2NUM(data->n);
+}
+
+VALUE transpose(VALUE self)
+{
+	struct matrix* M;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, M);
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+
+    R->m = M->n;
+    R->n = M->m;
+    R->data = c_matrix_transposed(M, &R->shared);
+    PROFILE_FINISH(PROFILE_MATRIX_TRANSPOSE, start, M->n, M->m, 0, 8ULL * M->m * M->n);
+
+    return result;
+}
+
+// A - matrix m x n
+// C - matrix n x n, rows [i0, i1) of lower triangle of A * A^T
+void c_matrix_syrk_rows(int n, int m, const double* A, double* C, int i0, int i1)
+{
+    const int block = 32;
+    for(int jb = 0; jb < i1; jb += block)
+    {
+        int je = (jb + block < i1) ? jb + block : i1;
+        for(int i = (i0 > jb) ? i0 : jb; i < i1; ++i)
+        {
+            const double* p_i = A + m * i;
+            double* p_c = C + n * i;
+            int end = (je < i + 1) ? je : i + 1;
+            for(int j = jb; j < end; ++j)
+            {
+                const double* p_j = A + m * j;
+                double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                int t = 0;
+                for(; t + 3 < m; t += 4)
+                {
+                    s0 += p_i[t] * p_j[t];
+                    s1 += p_i[t + 1] * p_j[t + 1];
+                    s2 += p_i[t + 2] * p_j[t + 2];
+                    s3 += p_i[t + 3] * p_j[t + 3];
+                }
+                for(; t < m; ++t)
+                    s0 += p_i[t] * p_j[t];
+                p_c[j] = (s0 + s1) + (s2 + s3);
+            }
+        }
+    }
+}
+
+// A - matrix m x n
+// C - matrix m x m, rows [i0, i1) of lower triangle of A^T * A
+void c_matrix_syrk_columns(int n, int m, const double* A, double* C, int i0, int i1)
+{
+    const int block = 64;
+    for(int i = i0; i < i1; ++i)
+        fill_d_array(i + 1, C + m * i, 0);
+
+    for(int ib = i0; ib < i1; ib += block)
+    {
+        int ie = (ib + block < i1) ? ib + block : i1;
+        for(int r = 0; r < n; ++r)
+        {
+            const double* p_a = A + m * r;
+            for(int i = ib; i < ie; ++i)
+            {
+                double d_a = p_a[i];
+                double* p_c = C + m * i;
+                for(int j = 0; j <= i; ++j)
+                    p_c[j] += d_a * p_a[j];
+            }
+        }
+    }
+}
+
+struct syrk_args
+{
+    int n;
+    int m;
+    bool trans;
+    int tasks;
+    const double* A;
+    double* C;
+};
+
+static void syrk_task(void* data, int task)
+{
+    struct syrk_args* args = data;
+    int size = args->trans ? args->m : args->n;
+
+    //  rows are split so that every task gets the same part of the triangle
+    int i0 = (int)(size * sqrt((double)task / args->tasks));
+    int i1 = (task + 1 == args->tasks) ? size : (int)(size * sqrt((double)(task + 1) / args->tasks));
+
+    if(args->trans)
+        c_matrix_syrk_columns(args->n, args->m, args->A, args->C, i0, i1);
+    else
+        c_matrix_syrk_rows(args->n, args->m, args->A, args->C, i0, i1);
+}
+
+// A - matrix m x n
+// C - matrix n x n equal A * A^T or matrix m x m equal A^T * A if trans
+void c_matrix_syrk(int n, int m, bool trans, const double* A, double* C)
+{
+    int size = trans ? m : n;
+    int depth = trans ? n : m;
+
+    struct syrk_args args = { n, m, trans, 1, A, C };
+    if((double)size * size * depth > 4000000)
+        args.tasks = parallel_threads_count();
+    if(args.tasks > size)
+        args.tasks = size;
+
+    parallel_for(args.tasks, syrk_task, &args);
+
+    for(int i = 0; i < size; ++i)
+        for(int j = i + 1; j < size; ++j)
+            C[j + size * i] = C[i + size * j];
+}
+
+VALUE matrix_syrk(VALUE self, VALUE trans)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    bool t = RTEST(trans);
+    int size = t ? A->m : A->n;
+
+    struct matrix* C;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
+
+    c_matrix_init(C, size, size);
+    c_matrix_syrk(A->n, A->m, t, A->data, C->data);
+
+    return result;
+}
+
+VALUE matrix_add_with(VALUE self, VALUE value)
+{
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->m != B->m && A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int m = B->m;
+    int n = A->n;
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* C;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
+
+    c_matrix_init(C, m, n);
+    add_d_arrays_to_result(n * m, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_MATRIX_ADD, start, n, m, 1ULL * m * n, 8ULL * m * n);
+
+    return result;
+}
+
+VALUE matrix_add_from(VALUE self, VALUE value)
+{
+    rb_check_frozen(self);
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->m != B->m && A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int m = B->m;
+    int n = A->n;
+
+    c_matrix_modify(A);
+    unsigned long long start = PROFILE_START();
+    add_d_arrays_to_first(n * m, A->data, B->data);
+    PROFILE_FINISH(PROFILE_MATRIX_ADD_FROM, start, n, m, 1ULL * m * n, 0);
+
+    return self;
+}
+
+
+VALUE matrix_sub_with(VALUE self, VALUE value)
+{
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->m != B->m && A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int m = B->m;
+    int n = A->n;
+
+    unsigned long long start = PROFILE_START();
+    struct matrix* C;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, C);
+
+    c_matrix_init(C, m, n);
+    sub_d_arrays_to_result(n * m, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_MATRIX_SUB, start, n, m, 1ULL * m * n, 8ULL * m * n);
+
+    return result;
+}
+
+// the receiver itself for in-place variants, otherwise a new matrix of the same size
+static VALUE matrix_result_for(VALUE self, bool in_place, struct matrix** R)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    if(in_place)
+    {
+        rb_check_frozen(self);
+        c_matrix_modify(A);
+        *R = A;
+        return self;
+    }
+
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, *R);
+    c_matrix_init(*R, A->m, A->n);
+    return result;
+}
+
+static VALUE matrix_hadamard_product_to(VALUE self, VALUE other, bool in_place)
+{
+	struct matrix* A;
+	struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
+
+    if(A->n != B->n || A->m != B->m)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    struct matrix* R;
+    VALUE result = matrix_result_for(self, in_place, &R);
+    hadamard_d_arrays_to_result(A->m * A->n, A->data, B->data, R->data);
+    return result;
+}
+
+VALUE matrix_hadamard_product(VALUE self, VALUE other)
+{
+    return matrix_hadamard_product_to(self, other, false);
+}
+
+VALUE matrix_hadamard_product_self(VALUE self, VALUE other)
+{
+    return matrix_hadamard_product_to(self, other, true);
+}
+
+enum d_function d_function_arg(VALUE name)
+{
+    if(SYMBOL_P(name))
+    {
+        ID id = SYM2ID(name);
+        if(id == rb_intern("exp"))
+            return D_EXP;
+        if(id == rb_intern("log"))
+            return D_LOG;
+        if(id == rb_intern("sqrt"))
+            return D_SQRT;
+        if(id == rb_intern("tanh"))
+            return D_TANH;
+        if(id == rb_intern("sin"))
+            return D_SIN;
+        if(id == rb_intern("cos"))
+            return D_COS;
+        if(id == rb_intern("abs"))
+            return D_ABS;
+    }
+    rb_raise(rb_eArgError, "expected :exp, :log, :sqrt, :tanh, :sin, :cos or :abs");
+    return D_ABS;
+}
+
+static VALUE matrix_map_fn_to(VALUE self, VALUE name, bool in_place)
+{
+    enum d_function function = d_function_arg(name);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    struct matrix* R;
+    VALUE result = matrix_result_for(self, in_place, &R);
+    apply_d_array(A->m * A->n, A->data, R->data, function);
+    return result;
+}
+
+VALUE matrix_map_fn(VALUE self, VALUE name)
+{
+    return matrix_map_fn_to(self, name, false);
+}
+
+VALUE matrix_map_fn_self(VALUE self, VALUE name)
+{
+    return matrix_map_fn_to(self, name, true);
+}
+
+static VALUE matrix_pow_to(VALUE self, VALUE power, bool in_place)
+{
+    double p = raise_rb_value_to_double(power);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    struct matrix* R;
+    VALUE result = matrix_result_for(self, in_place, &R);
+    pow_d_array(A->m * A->n, A->data, R->data, p);
+    return result;
+}
+
+VALUE matrix_pow(VALUE self, VALUE power)
+{
+    return matrix_pow_to(self, power, false);
+}
+
+VALUE matrix_pow_self(VALUE self, VALUE power)
+{
+    return matrix_pow_to(self, power, true);
+}
+
+static VALUE matrix_clamp_to(VALUE self, VALUE min, VALUE max, bool in_place)
+{
+    double lo = raise_rb_value_to_double(min);
+    double hi = raise_rb_value_to_double(max);
+    if(lo > hi)
+        rb_raise(rb_eArgError, "min argument must be less than or equal to max argument");
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    struct matrix* R;
+    VALUE result = matrix_result_for(self, in_place, &R);
+    clamp_d_array(A->m * A->n, A->data, R->data, lo, hi);
+    return result;
+}
+
+VALUE matrix_clamp(VALUE self, VALUE min, VALUE max)
+{
+    return matrix_clamp_to(self, min, max, false);
+}
+
+VALUE matrix_clamp_self(VALUE self, VALUE min, VALUE max)
+{
+    return matrix_clamp_to(self, min, max, true);
+}
+
+enum broadcast_op
+{
+    BROADCAST_ADD,
+    BROADCAST_SUB,
+    BROADCAST_MUL,
+    BROADCAST_DIV,
+};
+
+struct broadcast_args
+{
+    int m;
+    int n;
+    int tasks;
+    bool rows;
+    enum broadcast_op op;
+    const double* A;
+    const double* V;
+    double* R;
+};
+
+static void broadcast_row(int m, enum broadcast_op op, const double* a, const double* v, double* r)
+{
+    switch(op)
+    {
+    case BROADCAST_ADD:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] + v[j];
+        break;
+    case BROADCAST_SUB:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] - v[j];
+        break;
+    case BROADCAST_MUL:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] * v[j];
+        break;
+    case BROADCAST_DIV:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] / v[j];
+        break;
+    }
+}
+
+static void broadcast_column(int m, enum broadcast_op op, const double* a, double v, double* r)
+{
+    switch(op)
+    {
+    case BROADCAST_ADD:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] + v;
+        break;
+    case BROADCAST_SUB:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] - v;
+        break;
+    case BROADCAST_MUL:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] * v;
+        break;
+    case BROADCAST_DIV:
+        for(int j = 0; j < m; ++j)
+            r[j] = a[j] / v;
+        break;
+    }
+}
+
+static void broadcast_task(void* data, int task)
+{
+    struct broadcast_args* args = data;
+    int begin = (int)((long long)args->n * task / args->tasks);
+    int end = (int)((long long)args->n * (task + 1) / args->tasks);
+
+    for(int i = begin; i < end; ++i)
+    {
+        const double* a = args->A + (size_t)args->m * i;
+        double* r = args->R + (size_t)args->m * i;
+        if(args->rows)
+            broadcast_row(args->m, args->op, a, args->V, r);
+        else
+            broadcast_column(args->m, args->op, a, args->V[i], r);
+    }
+}
+
+// rows:  R[i, j] = A[i, j] op V[j], V - vector m
+// !rows: R[i, j] = A[i, j] op V[i], V - vector n
+// A - matrix m x n
+// R - matrix m x n, may be A
+void c_matrix_broadcast(int m, int n, const double* A, const double* V, bool rows, enum broadcast_op op, double* R)
+{
+    struct broadcast_args args = { m, n, 1, rows, op, A, V, R };
+    if((double)m * n > 1 << 17)
+        args.tasks = parallel_threads_count();
+    if(args.tasks > n)
+        args.tasks = n;
+
+    parallel_for(args.tasks, broadcast_task, &args);
+}
+
+static enum broadcast_op broadcast_op_arg(VALUE op)
+{
+    if(SYMBOL_P(op))
+    {
+        ID id = SYM2ID(op);
+        if(id == rb_intern("+"))
+            return BROADCAST_ADD;
+        if(id == rb_intern("-"))
+            return BROADCAST_SUB;
+        if(id == rb_intern("*"))
+            return BROADCAST_MUL;
+        if(id == rb_intern("/"))
+            return BROADCAST_DIV;
+    }
+    rb_raise(rb_eArgError, "expected :+, :-, :* or :/");
+    return BROADCAST_ADD;
+}
+
+static bool broadcast_rows_arg(VALUE axis)
+{
+    if(SYMBOL_P(axis))
+    {
+        ID id = SYM2ID(axis);
+        if(id == rb_intern("rows"))
+            return true;
+        if(id == rb_intern("columns"))
+            return false;
+    }
+    rb_raise(rb_eArgError, "expected :rows or :columns");
+    return true;
+}
+
+// vector is applied to every row (:rows) or every column (:columns)
+VALUE matrix_broadcast(VALUE self, VALUE op, VALUE vector, VALUE axis, VALUE in_place)
+{
+    enum broadcast_op o = broadcast_op_arg(op);
+    bool rows = broadcast_rows_arg(axis);
+	struct matrix* A;
+	struct vector* V;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(vector, struct vector, &vector_type, V);
+
+    if(V->n != (rows ? A->m : A->n))
+        rb_raise(fm_eIndexError, "Vector size must match the broadcast axis");
+
+    struct matrix* R;
+    VALUE result = matrix_result_for(self, RTEST(in_place), &R);
+    c_matrix_broadcast(A->m, A->n, A->data, V->data, rows, o, R->data);
+    return result;
+}
+
+// by a number, entrywise by a matrix, or by a vector broadcast across rows
+VALUE matrix_divide(VALUE self, VALUE v)
+{
+    if(RB_FLOAT_TYPE_P(v) || FIXNUM_P(v)
+        || RB_TYPE_P(v, T_BIGNUM))
+    {
+        VALUE result = matrix_copy(self);
+        struct matrix* R;
+        TypedData_Get_Struct(result, struct matrix, &matrix_type, R);
+        c_matrix_modify(R);
+        divide_d_array(R->m * R->n, R->data, NUM2DBL(v));
+        return result;
+    }
+    if(RBASIC_CLASS(v) == cMatrix)
+    {
+        struct matrix* A;
+        struct matrix* B;
+        TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+        TypedData_Get_Struct(v, struct matrix, &matrix_type, B);
+        if(A->n != B->n || A->m != B->m)
+            rb_raise(fm_eIndexError, "Different sizes matrices");
+
+        struct matrix* R;
+        VALUE result = matrix_result_for(self, false, &R);
+        divide_d_arrays_to_result(A->m * A->n, A->data, B->data, R->data);
+        return result;
+    }
+    if(RBASIC_CLASS(v) == cVector)
+        return matrix_broadcast(self, ID2SYM(rb_intern("/")), v, ID2SYM(rb_intern("rows")), Qfalse);
+    rb_raise(fm_eTypeError, "Invalid klass for divide");
+}
+
+double determinant(int n, const double* A)
+{
+    double* M = malloc(n * n * sizeof(double));
+    double det = 1;
+    copy_d_array(n * n, A, M);
+
+    for(int i = 0; i < n; ++i)
+    {
+        const double* line_p = M + i + i * n;
+        double current = *line_p; 
+        det *= current;
+
+        if(current == 0)
+        {
+            free(M);
+            return 0;
+        }
+
+        for(int j = i + 1; j < n; ++j)
+        {
+            double* t_line = M + i + j * n;
+            double head = *t_line;
+            for(int k = 1; k < n - i; ++k)
+                t_line[k] -= line_p[k] * head / current;
+        }
+    }
+
+    free(M);
+    return det;
+}
+
+VALUE matrix_determinant(VALUE self)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    
+    int m = A->m;
+    int n = A->n;
+    if(m != n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    unsigned long long start = PROFILE_START();
+    double det = c_matrix_determinant(A);
+    PROFILE_FINISH(PROFILE_MATRIX_DETERMINANT, start, n, n, 2ULL * n * n * n / 3, 8ULL * n * n);
+
+    return DBL2NUM(det);
+}
+
+VALUE matrix_inverse(VALUE self)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    int n = A->n;
+    int* shared;
+    double* LU = c_matrix_lu(A, &shared);
+    if(LU == NULL)
+        rb_raise(fm_eError, "Matrix is singular");
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, n, n);
+    c_lu_inverse(n, LU, (const int*)(LU + (size_t)n * n), R->data);
+    release_d_array(LU, shared);
+    return result;
+}
+
+// iterative refinement stops after this many corrections
+#define REFINE_ITERATIONS 30
+
+static double c_matrix_inf_norm(int n, const double* A)
+{
+    double norm = 0;
+    for(int i = 0; i < n; ++i)
+    {
+        double sum = 0;
+        for(int j = 0; j < n; ++j)
+            sum += fabs(A[j + (size_t)n * i]);
+        norm = (sum > norm) ? sum : norm;
+    }
+    return norm;
+}
+
+// solves A X = B in single precision and refines X with residuals
+// computed in double precision, as LAPACK dsgesv does
+// A - matrix n x n
+// B - matrix k x n
+// X - matrix k x n
+// returns false if the float factorization fails or refinement stalls
+static bool c_matrix_mixed_solve(int n, int k, const double* A, const double* B, double* X)
+{
+    size_t size = (size_t)n * n;
+    size_t len = (size_t)n * k;
+    double a_norm = c_matrix_inf_norm(n, A);
+    if(!(a_norm <= FLT_MAX))
+        return false;
+
+    float* LU = malloc(size * sizeof(float));
+    int* perm = malloc(n * sizeof(int));
+    float* W = malloc(len * sizeof(float));
+    double* R = malloc(len * sizeof(double));
+    for(size_t i = 0; i < size; ++i)
+        LU[i] = (float)A[i];
+
+    bool converged = false;
+    if(c_lu_decompose_f(n, LU, perm))
+    {
+        for(size_t i = 0; i < len; ++i)
+            W[i] = (float)B[i];
+        c_lu_solve_f(n, LU, perm, k, W);
+        for(size_t i = 0; i < len; ++i)
+            X[i] = W[i];
+
+        //  every column must satisfy |r| <= |x| |A| eps sqrt(n)
+        double tolerance = a_norm * DBL_EPSILON * sqrt((double)n);
+        double previous = INFINITY;
+        for(int iteration = 0; iteration < REFINE_ITERATIONS; ++iteration)
+        {
+            if(k == 1)
+                c_matrix_vector_multiply(n, n, A, X, R);
+            else
+                c_matrix_multiply(n, n, k, A, X, R);
+            for(size_t i = 0; i < len; ++i)
+                R[i] = B[i] - R[i];
+
+            converged = true;
+            double r_max = 0;
+            for(int t = 0; t < k; ++t)
+            {
+                double r_norm = 0, x_norm = 0;
+                for(int i = 0; i < n; ++i)
+                {
+                    r_norm = fmax(r_norm, fabs(R[t + (size_t)k * i]));
+                    x_norm = fmax(x_norm, fabs(X[t + (size_t)k * i]));
+                }
+                converged = converged && r_norm <= x_norm * tolerance;
+                r_max = fmax(r_max, r_norm);
+            }
+            //  a correction which does not halve the residual means
+            //  A is too ill-conditioned for single precision
+            if(converged || !(r_max <= FLT_MAX) || !(r_max < previous / 2))
+                break;
+            previous = r_max;
+
+            for(size_t i = 0; i < len; ++i)
+                W[i] = (float)R[i];
+            c_lu_solve_f(n, LU, perm, k, W);
+            for(size_t i = 0; i < len; ++i)
+                X[i] += W[i];
+        }
+    }
+
+    free(LU);
+    free(perm);
+    free(W);
+    free(R);
+    return converged;
+}
+
+// :double or :mixed, raises ArgumentError otherwise
+static bool mixed_precision_arg(VALUE precision)
+{
+    if(SYMBOL_P(precision))
+    {
+        ID id = SYM2ID(precision);
+        if(id == rb_intern("double"))
+            return false;
+        if(id == rb_intern("mixed"))
+            return true;
+    }
+    rb_raise(rb_eArgError, "Expected :double or :mixed precision");
+}
+
+// B - matrix k x n
+// X - matrix k x n
+static void c_matrix_solve(struct matrix* A, int k, const double* B, double* X, bool mixed)
+{
+    int n = A->n;
+    if(mixed && c_matrix_mixed_solve(n, k, A->data, B, X))
+        return;
+
+    int* shared;
+    double* LU = c_matrix_lu(A, &shared);
+    if(LU == NULL)
+        rb_raise(fm_eError, "Matrix is singular");
+    copy_d_array(n * k, B, X);
+    c_lu_solve(n, LU, (const int*)(LU + (size_t)n * n), k, X);
+    release_d_array(LU, shared);
+}
+
+// solves self * x = b for a vector or for every column of a matrix
+VALUE matrix_solve(VALUE self, VALUE b, VALUE precision)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    bool mixed = mixed_precision_arg(precision);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    if(rb_typeddata_is_kind_of(b, &vector_type))
+    {
+        struct vector* B;
+        TypedData_Get_Struct(b, struct vector, &vector_type, B);
+        if(B->n != A->n)
+            rb_raise(fm_eIndexError, "Matrix size differs from vector size");
+
+        struct vector* X;
+        VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, X);
+        c_vector_init(X, A->n);
+        c_matrix_solve(A, 1, B->data, X->data, mixed);
+        return result;
+    }
+    if(rb_typeddata_is_kind_of(b, &matrix_type))
+    {
+        struct matrix* B;
+        TypedData_Get_Struct(b, struct matrix, &matrix_type, B);
+        if(B->n != A->n)
+            rb_raise(fm_eIndexError, "Matrix rows differ from right-hand side rows");
+
+        struct matrix* X;
+        VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, X);
+        c_matrix_init(X, B->m, B->n);
+        c_matrix_solve(A, B->m, B->data, X->data, mixed);
+        return result;
+    }
+    rb_raise(fm_eTypeError, "Invalid klass for solve");
+}
+
+// binary exponentiation, products alternate between
+// the result, the current square and one scratch buffer
+// A - matrix n x n
+// R - matrix n x n, A^p
+void c_matrix_power(int n, const double* A, unsigned long p, double* R)
+{
+    size_t size = (size_t)n * n;
+    double* buffers = malloc(2 * size * sizeof(double));
+    double* base = buffers;
+    double* scratch = buffers + size;
+    double* result = R;
+    bool empty = true;
+
+    copy_d_array(n * n, A, base);
+    while(p > 0)
+    {
+        if(p & 1)
+        {
+            if(empty)
+                copy_d_array(n * n, base, result);
+            else
+            {
+                c_matrix_multiply(n, n, n, result, base, scratch);
+                double* t = result;
+                result = scratch;
+                scratch = t;
+            }
+            empty = false;
+        }
+        p >>= 1;
+        if(p > 0)
+        {
+            c_matrix_multiply(n, n, n, base, base, scratch);
+            double* t = base;
+            base = scratch;
+            scratch = t;
+        }
+    }
+
+    if(empty)
+    {
+        fill_d_array(n * n, result, 0);
+        for(int i = 0; i < n; ++i)
+            result[i + (size_t)n * i] = 1;
+    }
+    if(result != R)
+        copy_d_array(n * n, result, R);
+    free(buffers);
+}
+
+//  **
+VALUE matrix_power(VALUE self, VALUE exponent)
+{
+    if(!FIXNUM_P(exponent))
+        rb_raise(fm_eTypeError, "Exponent must be an integer");
+    long p = FIX2LONG(exponent);
+
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    VALUE base = self;
+    if(p < 0)
+        base = matrix_inverse(self);
+    TypedData_Get_Struct(base, struct matrix, &matrix_type, A);
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, A->m, A->n);
+    c_matrix_power(A->n, A->data, p < 0 ? -(unsigned long)p : (unsigned long)p, R->data);
+
+    RB_GC_GUARD(base);
+    return result;
+}
+
+struct chain
+{
+    const double** data;
+    const int* dims;
+    const int* split;
+    int count;
+    double* arena;
+};
+
+// dims[i] x dims[i + 1] are sizes of i-th matrix (rows x columns)
+static size_t chain_size(const struct chain* c, int i, int j)
+{
+    return (size_t)c->dims[i] * c->dims[j + 1];
+}
+
+// scratch memory needed to evaluate the product of matrices i..j
+// besides its result: operands are kept below their own evaluation
+static size_t chain_scratch(const struct chain* c, int i, int j)
+{
+    if(i == j)
+        return 0;
+    int s = c->split[j + c->count * i];
+    size_t left = (s == i) ? 0 : chain_size(c, i, s);
+    size_t right = (s + 1 == j) ? 0 : chain_size(c, s + 1, j);
+    size_t first = left + chain_scratch(c, i, s);
+    size_t second = left + right + chain_scratch(c, s + 1, j);
+    return first > second ? first : second;
+}
+
+// product of matrices i..j into out, temporaries are taken from the
+// arena as a stack starting at top
+static void chain_evaluate(const struct chain* c, int i, int j, double* out, double* top)
+{
+    int s = c->split[j + c->count * i];
+    const double* left = c->data[i];
+    const double* right = c->data[j];
+
+    if(s != i)
+    {
+        double* buffer = top;
+        top += chain_size(c, i, s);
+        chain_evaluate(c, i, s, buffer, top);
+        left = buffer;
+    }
+    if(s + 1 != j)
+    {
+        double* buffer = top;
+        top += chain_size(c, s + 1, j);
+        chain_evaluate(c, s + 1, j, buffer, top);
+        right = buffer;
+    }
+
+    c_matrix_multiply(c->dims[i], c->dims[s + 1], c->dims[j + 1], left, right, out);
+}
+
+// the product of matrices with the minimal number of multiplications,
+// the order is found by the classic O(count^3) dynamic programming
+VALUE matrix_s_chain_multiply(int argc, VALUE* argv, VALUE klass)
+{
+    if(argc == 0)
+        rb_raise(rb_eArgError, "wrong number of arguments (given 0, expected 1+)");
+
+    const double** data = ALLOCA_N(const double*, argc);
+    int* dims = ALLOCA_N(int, argc + 1);
+    for(int t = 0; t < argc; ++t)
+    {
+        struct matrix* M;
+        TypedData_Get_Struct(argv[t], struct matrix, &matrix_type, M);
+        if(t > 0 && dims[t] != M->n)
+            rb_raise(fm_eIndexError, "First columns differs from second rows");
+        dims[t] = M->n;
+        dims[t + 1] = M->m;
+        data[t] = M->data;
+    }
+    if(argc == 1)
+        return matrix_copy(argv[0]);
+
+    double* cost = malloc((size_t)argc * argc * sizeof(double));
+    int* split = malloc((size_t)argc * argc * sizeof(int));
+    for(int i = 0; i < argc; ++i)
+        cost[i + argc * i] = 0;
+    for(int len = 2; len <= argc; ++len)
+        for(int i = 0; i + len <= argc; ++i)
+        {
+            int j = i + len - 1;
+            cost[j + argc * i] = INFINITY;
+            for(int s = i; s < j; ++s)
+            {
+                double c = cost[s + argc * i] + cost[j + argc * (s + 1)]
+                         + (double)dims[i] * dims[s + 1] * dims[j + 1];
+                if(c < cost[j + argc * i])
+                {
+                    cost[j + argc * i] = c;
+                    split[j + argc * i] = s;
+                }
+            }
+        }
+
+    struct chain c = { data, dims, split, argc, NULL };
+    c.arena = malloc((chain_scratch(&c, 0, argc - 1) + 1) * sizeof(double));
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, dims[argc], dims[0]);
+    chain_evaluate(&c, 0, argc - 1, R->data, c.arena);
+
+    free(c.arena);
+    free(cost);
+    free(split);
+    return result;
+}
+
+// eigenvalues in ascending order and matrix with eigenvectors as columns,
+// only the lower triangle of the matrix is read
+VALUE matrix_symmetric_eigen(VALUE self)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    int n = A->n;
+
+    struct vector* values;
+    VALUE rb_values = TypedData_Make_Struct(cVector, struct vector, &vector_type, values);
+    struct matrix* vectors;
+    VALUE rb_vectors = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, vectors);
+
+    c_vector_init(values, n);
+    c_matrix_init(vectors, n, n);
+
+    double* Z = malloc(n * n * sizeof(double));
+    bool converged = c_symmetric_eigen(n, A->data, values->data, Z);
+    matrix_transpose(n, n, Z, vectors->data);
+    free(Z);
+
+    if(!converged)
+        rb_raise(fm_eError, "Eigenvalues did not converge");
+
+    return rb_assoc_new(rb_values, rb_vectors);
+}
+
+VALUE matrix_top_eigen(VALUE self, VALUE count, VALUE tolerance, VALUE iterations)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    int n = A->n;
+    int k = raise_rb_value_to_int(count);
+    double tol = raise_rb_value_to_double(tolerance);
+    int max_iterations = raise_rb_value_to_int(iterations);
+    raise_check_range(k, 1, n + 1);
+
+    struct vector* values;
+    VALUE rb_values = TypedData_Make_Struct(cVector, struct vector, &vector_type, values);
+    struct matrix* vectors;
+    VALUE rb_vectors = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, vectors);
+
+    c_vector_init(values, k);
+    c_matrix_init(vectors, k, n);
+
+    double* X = malloc(k * n * sizeof(double));
+    bool converged = c_top_eigen(n, k, A->data, tol, max_iterations, values->data, X);
+    matrix_transpose(n, k, X, vectors->data);
+    free(X);
+
+    if(!converged)
+        rb_raise(fm_eError, "Eigenvalues did not converge");
+
+    return rb_assoc_new(rb_values, rb_vectors);
+}
+
+VALUE matrix_sub_from(VALUE self, VALUE value)
+{
+    rb_check_frozen(self);
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->m != B->m && A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int m = B->m;
+    int n = A->n;
+
+    c_matrix_modify(A);
+    unsigned long long start = PROFILE_START();
+    sub_d_arrays_to_first(n * m, A->data, B->data);
+    PROFILE_FINISH(PROFILE_MATRIX_SUB_FROM, start, n, m, 1ULL * m * n, 0);
+
+    return self;
+}
+
+VALUE matrix_fill(VALUE self, VALUE value)
+{
+    rb_check_frozen(self);
+    double d = raise_rb_value_to_double(value);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    c_matrix_modify(A);
+    fill_d_array(A->m * A->n, A->data, d);
+
+    return self;
+}
+
+VALUE matrix_random(VALUE self, VALUE distribution, VALUE seed)
+{
+    rb_check_frozen(self);
+    enum random_distribution d = random_distribution_arg(distribution);
+    uint64_t s = NUM2ULL(seed);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    c_matrix_modify(A);
+    c_random_fill(A->m * A->n, A->data, d, s);
+
+    return self;
+}
+
+// false for objects of other types, so matrices can be keys of Hash
+VALUE matrix_equal(VALUE self, VALUE value)
+{
+    if(!rb_typeddata_is_kind_of(value, &matrix_type))
+        return Qfalse;
+
+    struct matrix* A;
+    struct matrix* B;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->n != B->n || A->m != B->m)
+        return Qfalse;
+    if(c_matrix_hashes_differ(A, B))
+        return Qfalse;
+
+    int n = A->n;
+    int m = B->m;
+
+    if(equal_d_arrays(n * m, A->data, B->data))
+        return Qtrue;
+    return Qfalse;
+}
+
+// memoized, equal matrices of the same shape have equal hashes
+VALUE matrix_hash(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    st_index_t h = rb_hash_start(c_matrix_hash(A));
+    h = rb_hash_uint(h, A->m);
+    h = rb_hash_uint(h, A->n);
+    return ST2FIX(rb_hash_end(h));
+}
+
+VALUE matrix_abs(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    int m = A->m;
+    int n = A->n;
+
+    struct matrix* B;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, B);
+
+    c_matrix_init(B, m, n);
+    abs_d_array(n * m, A->data, B->data);
+
+    return result;
+}
+
+VALUE matrix_greater_or_equal(VALUE self, VALUE value)
+{
+	struct matrix* A;
+    struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(value, struct matrix, &matrix_type, B);
+
+    if(A->m != B->m && A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int m = B->m;
+    int n = A->n;
+
+    if(greater_or_equal_d_array(n * m, A->data, B->data))
+        return Qtrue;
+    return Qfalse;
+}
+
+VALUE matrix_sum(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    return DBL2NUM(sum_d_array(A->m * A->n, A->data));
+}
+
+VALUE matrix_mean(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    return DBL2NUM(sum_d_array(A->m * A->n, A->data) / ((double)A->m * A->n));
+}
+
+VALUE matrix_min(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    return DBL2NUM(min_d_array(A->m * A->n, A->data));
+}
+
+VALUE matrix_max(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    return DBL2NUM(max_d_array(A->m * A->n, A->data));
+}
+
+VALUE matrix_frobenius_norm(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+    return DBL2NUM(c_matrix_frobenius_norm(A));
+}
+
+// entrywise p-norm, p = Float::INFINITY gives maximum absolute value
+VALUE matrix_norm(int argc, VALUE* argv, VALUE self)
+{
+    VALUE rb_p;
+    rb_scan_args(argc, argv, "01", &rb_p);
+    double p = NIL_P(rb_p) ? 2 : raise_rb_value_to_double(rb_p);
+
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    int len = A->m * A->n;
+    if(!(p > 0))
+        rb_raise(rb_eArgError, "Norm order must be positive");
+    if(isinf(p))
+        return DBL2NUM(max_abs_d_array(len, A->data));
+    if(p == 2)
+        return DBL2NUM(c_matrix_frobenius_norm(A));
+    return DBL2NUM(pow(sum_pow_abs_d_array(len, A->data, p), 1 / p));
+}
+
+VALUE matrix_trace(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    if(A->m != A->n)
+        rb_raise(fm_eIndexError, "Not a square matrix");
+
+    double sum = 0;
+    for(int i = 0; i < A->n; ++i)
+        sum += A->data[i + A->m * i];
+    return DBL2NUM(sum);
+}
+
+// A - matrix m x n
+// R - vector n, reduction of every row
+void c_matrix_row_reduce(int m, int n, const double* A, double* R, double (*reduce)(int len, const double* a))
+{
+    for(int i = 0; i < n; ++i)
+        R[i] = reduce(m, A + m * i);
+}
+
+// A - matrix m x n
+// R - vector m, sums of columns with Kahan compensation
+void c_matrix_column_sums(int m, int n, const double* A, double* R)
+{
+    double* c = malloc(m * sizeof(double));
+    fill_d_array(m, c, 0);
+    fill_d_array(m, R, 0);
+
+    for(int i = 0; i < n; ++i)
+    {
+        const double* p_a = A + m * i;
+        for(int j = 0; j < m; ++j)
+        {
+            double y = p_a[j] - c[j];
+            double t = R[j] + y;
+            c[j] = (t - R[j]) - y;
+            R[j] = t;
+        }
+    }
+
+    free(c);
+}
+
+// A - matrix m x n
+// R - vector m, minimum (or maximum) of columns
+void c_matrix_column_extreme(int m, int n, const double* A, double* R, bool maximum)
+{
+    copy_d_array(m, A, R);
+    for(int i = 1; i < n; ++i)
+    {
+        const double* p_a = A + m * i;
+        if(maximum)
+            for(int j = 0; j < m; ++j)
+                R[j] = (p_a[j] > R[j]) ? p_a[j] : R[j];
+        else
+            for(int j = 0; j < m; ++j)
+                R[j] = (p_a[j] < R[j]) ? p_a[j] : R[j];
+    }
+}
+
+static VALUE matrix_row_reduce(VALUE self, double (*reduce)(int len, const double* a), bool mean)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    struct vector* R;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+
+    c_vector_init(R, A->n);
+    c_matrix_row_reduce(A->m, A->n, A->data, R->data, reduce);
+    if(mean)
+        multiply_d_array(R->n, R->data, 1.0 / A->m);
+
+    return result;
+}
+
+VALUE matrix_row_sums(VALUE self)
+{
+    return matrix_row_reduce(self, sum_d_array, false);
+}
+
+VALUE matrix_row_means(VALUE self)
+{
+    return matrix_row_reduce(self, sum_d_array, true);
+}
+
+VALUE matrix_row_min(VALUE self)
+{
+    return matrix_row_reduce(self, min_d_array, false);
+}
+
+VALUE matrix_row_max(VALUE self)
+{
+    return matrix_row_reduce(self, max_d_array, false);
+}
+
+static VALUE matrix_column_reduce(VALUE self, int kind)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    struct vector* R;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+
+    c_vector_init(R, A->m);
+    if(kind == 0 || kind == 1)
+        c_matrix_column_sums(A->m, A->n, A->data, R->data);
+    else
+        c_matrix_column_extreme(A->m, A->n, A->data, R->data, kind == 3);
+    if(kind == 1)
+        multiply_d_array(R->n, R->data, 1.0 / A->n);
+
+    return result;
+}
+
+VALUE matrix_column_sums(VALUE self)
+{
+    return matrix_column_reduce(self, 0);
+}
+
+VALUE matrix_column_means(VALUE self)
+{
+    return matrix_column_reduce(self, 1);
+}
+
+VALUE matrix_column_min(VALUE self)
+{
+    return matrix_column_reduce(self, 2);
+}
+
+VALUE matrix_column_max(VALUE self)
+{
+    return matrix_column_reduce(self, 3);
+}
+
+enum matrix_which
+{
+    WHICH_ALL,
+    WHICH_DIAGONAL,
+    WHICH_OFF_DIAGONAL,
+    WHICH_LOWER,
+    WHICH_STRICT_LOWER,
+    WHICH_STRICT_UPPER,
+    WHICH_UPPER,
+};
+
+// parse optional +which+ argument as in standard Matrix#each
+static enum matrix_which matrix_which_arg(int argc, VALUE* argv)
+{
+    VALUE which;
+    rb_scan_args(argc, argv, "01", &which);
+
+    if(NIL_P(which))
+        return WHICH_ALL;
+    if(SYMBOL_P(which))
+    {
+        ID id = SYM2ID(which);
+        if(id == rb_intern("all"))
+            return WHICH_ALL;
+        if(id == rb_intern("diagonal"))
+            return WHICH_DIAGONAL;
+        if(id == rb_intern("off_diagonal"))
+            return WHICH_OFF_DIAGONAL;
+        if(id == rb_intern("lower"))
+            return WHICH_LOWER;
+        if(id == rb_intern("strict_lower"))
+            return WHICH_STRICT_LOWER;
+        if(id == rb_intern("strict_upper"))
+            return WHICH_STRICT_UPPER;
+        if(id == rb_intern("upper"))
+            return WHICH_UPPER;
+    }
+    rb_raise(rb_eArgError, "expected :all, :diagonal, :off_diagonal, :lower, :strict_lower, :strict_upper or :upper");
+}
+
+static bool matrix_which_match(enum matrix_which which, int i, int j)
+{
+    switch(which)
+    {
+    case WHICH_DIAGONAL:
+        return i == j;
+    case WHICH_OFF_DIAGONAL:
+        return i != j;
+    case WHICH_LOWER:
+        return i >= j;
+    case WHICH_STRICT_LOWER:
+        return i > j;
+    case WHICH_STRICT_UPPER:
+        return i < j;
+    case WHICH_UPPER:
+        return i <= j;
+    default:
+        return true;
+    }
+}
+
+static VALUE matrix_enum_size(VALUE self, VALUE args, VALUE eobj)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    enum matrix_which which = WHICH_ALL;
+    if(RB_TYPE_P(args, T_ARRAY))
+        which = matrix_which_arg((int)RARRAY_LEN(args), RARRAY_PTR(args));
+    long count = 0;
+    for(int i = 0; i < A->n; ++i)
+        for(int j = 0; j < A->m; ++j)
+            count += matrix_which_match(which, i, j);
+    return LONG2NUM(count);
+}
+
+// the block may replace the buffer of the matrix,
+// so elements are always read through the structure
+VALUE matrix_each(int argc, VALUE* argv, VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, argc, argv, matrix_enum_size);
+    enum matrix_which which = matrix_which_arg(argc, argv);
+
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        for(int j = 0; j < A->m; ++j)
+            if(matrix_which_match(which, i, j))
+                rb_yield(DBL2NUM(A->data[j + A->m * i]));
+    return self;
+}
+
+VALUE matrix_each_with_index(int argc, VALUE* argv, VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, argc, argv, matrix_enum_size);
+    enum matrix_which which = matrix_which_arg(argc, argv);
+
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        for(int j = 0; j < A->m; ++j)
+            if(matrix_which_match(which, i, j))
+                rb_yield_values(3, DBL2NUM(A->data[j + A->m * i]), INT2NUM(i), INT2NUM(j));
+    return self;
+}
+
+VALUE matrix_each_with_index_self(VALUE self)
+{
+    rb_check_frozen(self);
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, matrix_enum_size);
+
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        for(int j = 0; j < A->m; ++j)
+        {
+            VALUE v = rb_yield_values(3, DBL2NUM(A->data[j + A->m * i]), INT2NUM(i), INT2NUM(j));
+            //  the block may clone the matrix
+            c_matrix_modify(A);
+            A->data[j + A->m * i] = raise_rb_value_to_double(v);
+        }
+    return self;
+}
+
+VALUE matrix_map_self(int argc, VALUE* argv, VALUE self)
+{
+    rb_check_frozen(self);
+    RETURN_SIZED_ENUMERATOR(self, argc, argv, matrix_enum_size);
+    enum matrix_which which = matrix_which_arg(argc, argv);
+
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        for(int j = 0; j < A->m; ++j)
+            if(matrix_which_match(which, i, j))
+            {
+                VALUE v = rb_yield(DBL2NUM(A->data[j + A->m * i]));
+                c_matrix_modify(A);
+                A->data[j + A->m * i] = raise_rb_value_to_double(v);
+            }
+    return self;
+}
+
+VALUE matrix_map(int argc, VALUE* argv, VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, argc, argv, matrix_enum_size);
+    return matrix_map_self(argc, argv, matrix_copy(self));
+}
+
+VALUE matrix_to_a(VALUE self)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    VALUE rows = rb_ary_new_capa(A->n);
+    for(int i = 0; i < A->n; ++i)
+    {
+        VALUE row = rb_ary_new_capa(A->m);
+        for(int j = 0; j < A->m; ++j)
+            rb_ary_push(row, DBL2NUM(A->data[j + A->m * i]));
+        rb_ary_push(rows, row);
+    }
+    return rows;
+}
+
+// fold matrices entrywise: result = yield(result, next)
+VALUE matrix_s_combine(int argc, VALUE* argv, VALUE klass)
+{
+    RETURN_ENUMERATOR(klass, argc, argv);
+    if(argc == 0)
+        return rb_funcall(klass, rb_intern("empty"), 0);
+
+    VALUE matrices = rb_ary_new_capa(argc);
+    for(int t = 0; t < argc; ++t)
+    {
+        VALUE x = argv[t];
+        if(!rb_obj_is_kind_of(x, cMatrix))
+            x = rb_funcall(cMatrix, rb_intern("convert"), 1, x);
+        rb_ary_push(matrices, x);
+    }
+
+    VALUE result = matrix_copy(rb_ary_entry(matrices, 0));
+	struct matrix* R;
+	TypedData_Get_Struct(result, struct matrix, &matrix_type, R);
+    c_matrix_modify(R);
+
+    for(int t = 1; t < argc; ++t)
+    {
+        struct matrix* M;
+        TypedData_Get_Struct(rb_ary_entry(matrices, t), struct matrix, &matrix_type, M);
+        if(M->m != R->m || M->n != R->n)
+            rb_raise(fm_eIndexError, "Different sizes matrices");
+
+        int len = R->m * R->n;
+        for(int k = 0; k < len; ++k)
+        {
+            VALUE v = rb_yield_values(2, DBL2NUM(R->data[k]), DBL2NUM(M->data[k]));
+            R->data[k] = raise_rb_value_to_double(v);
+        }
+    }
+    return result;
+}
+
+// Array of indices in [-size, size), the buffer is freed by GC
+// if an index is invalid
+static int* matrix_indices_arg(VALUE indices, int size, int* count, volatile VALUE* buffer)
+{
+    if(!RB_TYPE_P(indices, T_ARRAY))
+        rb_raise(fm_eTypeError, "Indices must be an array");
+    long len = RARRAY_LEN(indices);
+    if(len == 0)
+        rb_raise(fm_eIndexError, "Indices cannot be empty");
+    if(len > INT_MAX)
+        rb_raise(fm_eIndexError, "Too many indices");
+
+    int* result = rb_alloc_tmp_buffer(buffer, len * sizeof(int));
+    for(long t = 0; t < len; ++t)
+    {
+        int i = raise_rb_value_to_int(rb_ary_entry(indices, t));
+        i = (i < 0) ? size + i : i;
+        raise_check_range(i, 0, size);
+        result[t] = i;
+    }
+    *count = (int)len;
+    return result;
+}
+
+VALUE matrix_select_rows(VALUE self, VALUE indices)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    volatile VALUE buffer = 0;
+    int count;
+    int* rows = matrix_indices_arg(indices, A->n, &count, &buffer);
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, A->m, count);
+    c_matrix_gather_rows(A->m, A->data, count, rows, R->data);
+
+    ALLOCV_END(buffer);
+    return result;
+}
+
+VALUE matrix_select_columns(VALUE self, VALUE indices)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    volatile VALUE buffer = 0;
+    int count;
+    int* columns = matrix_indices_arg(indices, A->m, &count, &buffer);
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, count, A->n);
+    c_matrix_gather_columns(A->m, A->n, A->data, count, columns, R->data);
+
+    ALLOCV_END(buffer);
+    return result;
+}
+
+// rows of other are written to rows of self with given indices,
+// the last one wins for repeated indices
+VALUE matrix_scatter_rows(VALUE self, VALUE indices, VALUE other)
+{
+    rb_check_frozen(self);
+	struct matrix* A;
+	struct matrix* B;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+	TypedData_Get_Struct(other, struct matrix, &matrix_type, B);
+
+    volatile VALUE buffer = 0;
+    int count;
+    int* rows = matrix_indices_arg(indices, A->n, &count, &buffer);
+    if(B->n != count || B->m != A->m)
+        rb_raise(fm_eIndexError, "Source must have a row for each index and the same columns");
+
+    c_matrix_modify(A);
+    for(int i = 0; i < count; ++i)
+        memmove(A->data + (size_t)A->m * rows[i], B->data + (size_t)B->m * i, A->m * sizeof(double));
+
+    ALLOCV_END(buffer);
+    return self;
+}
+
+// R[i] = A[perm[i]], perm must contain every row once
+VALUE matrix_permute_rows(VALUE self, VALUE perm)
+{
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    volatile VALUE buffer = 0;
+    int count;
+    int* rows = matrix_indices_arg(perm, A->n, &count, &buffer);
+    if(count != A->n)
+        rb_raise(fm_eIndexError, "Permutation must contain every row");
+
+    volatile VALUE seen_buffer = 0;
+    char* seen = ALLOCV_N(char, seen_buffer, count);
+    memset(seen, 0, count);
+    for(int i = 0; i < count; ++i)
+    {
+        if(seen[rows[i]])
+            rb_raise(fm_eIndexError, "Permutation must contain every row once");
+        seen[rows[i]] = 1;
+    }
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+    c_matrix_init(R, A->m, A->n);
+    c_matrix_gather_rows(A->m, A->data, count, rows, R->data);
+
+    ALLOCV_END(seen_buffer);
+    ALLOCV_END(buffer);
+    return result;
+}
+
+VALUE matrix_swap_rows(VALUE self, VALUE first, VALUE second)
+{
+    rb_check_frozen(self);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    int i = raise_rb_value_to_int(first);
+    int j = raise_rb_value_to_int(second);
+    i = (i < 0) ? A->n + i : i;
+    j = (j < 0) ? A->n + j : j;
+    raise_check_range(i, 0, A->n);
+    raise_check_range(j, 0, A->n);
+
+    c_matrix_modify(A);
+    double* p_i = A->data + (size_t)A->m * i;
+    double* p_j = A->data + (size_t)A->m * j;
+    for(int k = 0; k < A->m; ++k)
+    {
+        double t = p_i[k];
+        p_i[k] = p_j[k];
+        p_j[k] = t;
+    }
+    return self;
+}
+
+VALUE matrix_swap_columns(VALUE self, VALUE first, VALUE second)
+{
+    rb_check_frozen(self);
+	struct matrix* A;
+	TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    int i = raise_rb_value_to_int(first);
+    int j = raise_rb_value_to_int(second);
+    i = (i < 0) ? A->m + i : i;
+    j = (j < 0) ? A->m + j : j;
+    raise_check_range(i, 0, A->m);
+    raise_check_range(j, 0, A->m);
+
+    c_matrix_modify(A);
+    for(int k = 0; k < A->n; ++k)
+    {
+        double* p = A->data + (size_t)A->m * k;
+        double t = p[i];
+        p[i] = p[j];
+        p[j] = t;
+    }
+    return self;
+}
+
+void init_fm_matrix()
+{
+    VALUE  mod = rb_define_module("FastMatrix");
+	cMatrix = rb_define_class_under(mod, "Matrix", rb_cObject);
+
+	rb_define_alloc_func(cMatrix, matrix_alloc);
+
+	rb_define_method(cMatrix, "initialize", matrix_initialize, 2);
+	rb_define_method(cMatrix, "[]", matrix_get, 2);
+	rb_define_method(cMatrix, "[]=", matrix_set, 3);
+	rb_define_method(cMatrix, "*", matrix_multiply, 1);
+	rb_define_method(cMatrix, "column_count", row_size, 0);
+	rb_define_method(cMatrix, "row_count", column_size, 0);
+	rb_define_method(cMatrix, "clone", matrix_copy, 0);
+	rb_define_method(cMatrix, "transpose", transpose, 0);
+	rb_define_method(cMatrix, "+", matrix_add_with, 1);
+	rb_define_method(cMatrix, "+=", matrix_add_from, 1);
+	rb_define_method(cMatrix, "-", matrix_sub_with, 1);
+	rb_define_method(cMatrix, "-=", matrix_sub_from, 1);
+	rb_define_method(cMatrix, "fill!", matrix_fill, 1);
+    rb_define_private_method(cMatrix, "random_impl", matrix_random, 2);
+    rb_define_method(cMatrix, "strassen", strassen, 1);
+    rb_define_method(cMatrix, "abs", matrix_abs, 0);
+    rb_define_method(cMatrix, "/", matrix_divide, 1);
+    rb_define_method(cMatrix, "hadamard_product", matrix_hadamard_product, 1);
+    rb_define_method(cMatrix, "hadamard_product!", matrix_hadamard_product_self, 1);
+    rb_define_method(cMatrix, "map_fn", matrix_map_fn, 1);
+    rb_define_method(cMatrix, "map_fn!", matrix_map_fn_self, 1);
+    rb_define_method(cMatrix, "pow", matrix_pow, 1);
+    rb_define_method(cMatrix, "pow!", matrix_pow_self, 1);
+    rb_define_method(cMatrix, "clamp", matrix_clamp, 2);
+    rb_define_method(cMatrix, "clamp!", matrix_clamp_self, 2);
+    rb_define_private_method(cMatrix, "broadcast_impl", matrix_broadcast, 4);
+    rb_define_method(cMatrix, ">=", matrix_greater_or_equal, 1);
+    rb_define_method(cMatrix, "determinant", matrix_determinant, 0);
+    rb_define_method(cMatrix, "inverse", matrix_inverse, 0);
+    rb_define_private_method(cMatrix, "solve_impl", matrix_solve, 2);
+    rb_define_method(cMatrix, "**", matrix_power, 1);
+    rb_define_singleton_method(cMatrix, "chain_multiply", matrix_s_chain_multiply, -1);
+    rb_define_method(cMatrix, "eql?", matrix_equal, 1);
+    rb_define_method(cMatrix, "hash", matrix_hash, 0);
+    rb_define_method(cMatrix, "symmetric_eigen", matrix_symmetric_eigen, 0);
+    rb_define_private_method(cMatrix, "top_eigen_impl", matrix_top_eigen, 3);
+    rb_define_private_method(cMatrix, "syrk_impl", matrix_syrk, 1);
+    rb_define_method(cMatrix, "dot_rows", matrix_multiply_mv, 1);
+    rb_define_method(cMatrix, "each", matrix_each, -1);
+    rb_define_method(cMatrix, "each_with_index", matrix_each_with_index, -1);
+    rb_define_method(cMatrix, "each_with_index!", matrix_each_with_index_self, 0);
+    rb_define_method(cMatrix, "map", matrix_map, -1);
+    rb_define_method(cMatrix, "map!", matrix_map_self, -1);
+    rb_define_method(cMatrix, "to_a", matrix_to_a, 0);
+    rb_define_singleton_method(cMatrix, "combine", matrix_s_combine, -1);
+    rb_define_private_method(cMatrix, "sum_impl", matrix_sum, 0);
+    rb_define_method(cMatrix, "mean", matrix_mean, 0);
+    rb_define_private_method(cMatrix, "min_impl", matrix_min, 0);
+    rb_define_private_method(cMatrix, "max_impl", matrix_max, 0);
+    rb_define_method(cMatrix, "frobenius_norm", matrix_frobenius_norm, 0);
+    rb_define_method(cMatrix, "norm", matrix_norm, -1);
+    rb_define_method(cMatrix, "trace", matrix_trace, 0);
+    rb_define_method(cMatrix, "row_sums", matrix_row_sums, 0);
+    rb_define_method(cMatrix, "row_means", matrix_row_means, 0);
+    rb_define_method(cMatrix, "row_min", matrix_row_min, 0);
+    rb_define_method(cMatrix, "row_max", matrix_row_max, 0);
+    rb_define_method(cMatrix, "column_sums", matrix_column_sums, 0);
+    rb_define_method(cMatrix, "column_means", matrix_column_means, 0);
+    rb_define_method(cMatrix, "column_min", matrix_column_min, 0);
+    rb_define_method(cMatrix, "column_max", matrix_column_max, 0);
+    rb_define_method(cMatrix, "select_rows", matrix_select_rows, 1);
+    rb_define_method(cMatrix, "select_columns", matrix_select_columns, 1);
+    rb_define_method(cMatrix, "scatter_rows!", matrix_scatter_rows, 2);
+    rb_define_method(cMatrix, "permute_rows", matrix_permute_rows, 1);
+    rb_define_method(cMatrix, "swap_rows!", matrix_swap_rows, 2);
+    rb_define_method(cMatrix, "swap_columns!", matrix_swap_columns, 2);
+}
@@ -1,28 +1,61 @@
-#ifndef FAST_MATRIX_MATRIX_H
-#define FAST_MATRIX_MATRIX_H 1
-
-#include "ruby.h"
-
-extern VALUE cMatrix;
-extern const rb_data_type_t matrix_type;
-
-// matrix
-//     m --->
-//   [ 0,    1, ..,  m-1]
-// n [ m,  m+1, .., 2m-1]
-// | [2m, 2m+1, .., 3m-1]
-// V [ . . . . .
-//         . . . .  nm-1]
-struct matrix
-{
-    int m;
-    int n;
-
-    double* data;
-};
-
-void c_matrix_init(struct matrix* mtr, int m, int n);
-
-void init_fm_matrix();
-
-#endif /* FAST_MATRIX_MATRIX_H */
+#ifndef FAST_MATRIX_MATRIX_H
+#define FAST_MATRIX_MATRIX_H 1
+
+#include "ruby.h"
+#include "c_array_operations.h"
+
+struct matrix_cache;
+
+extern VALUE cMatrix;
+extern const rb_data_type_t matrix_type;
+
+// matrix
+//     m --->
+//   [ 0,    1, ..,  m-1]
+// n [ m,  m+1, .., 2m-1]
+// | [2m, 2m+1, .., 3m-1]
+// V [ . . . . .
+//         . . . .  nm-1]
+struct matrix
+{
+    int m;
+    int n;
+
+    double* data;
+    // owners count of data shared by clones, NULL if data is not shared
+    int* shared;
+    // incremented by every change of data
+    unsigned long version;
+    // memoized results of the current version, see cache.h
+    struct matrix_cache* cache;
+};
+
+void c_matrix_init(struct matrix* mtr, int m, int n);
+// every method which changes the matrix in place calls it before writing,
+// it bumps the version and drops memoized results
+void c_matrix_modify(struct matrix* A);
+
+// A - matrix k x n
+// B - matrix m x k
+// C - matrix m x n
+void c_matrix_multiply(int n, int k, int m, const double* A, const double* B, double* C);
+// A - matrix k x n
+// B - matrix m x k
+// C - matrix m x n, must be filled with zeros
+void recursive_strassen(int n, int k, int m, const double* A, const double* B, double* C);
+// A - matrix n x n
+double determinant(int n, const double* A);
+// in - matrix m x n
+// out - matrix n x m
+void matrix_transpose(int m, int n, const double* in, double* out);
+// M - matrix m x n
+// V - vector m
+// R - vector n
+void c_matrix_vector_multiply(int n, int m, const double* M, const double* V, double* R);
+
+// :exp, :log, :sqrt, :tanh, :sin, :cos or :abs, raises ArgumentError otherwise
+enum d_function d_function_arg(VALUE name);
+
+void init_fm_matrix();
+
+#endif /* FAST_MATRIX_MATRIX_H */
@@ -0,0 +1,320 @@
+#include "npy.h"
+#include "errors.h"
+#include "matrix.h"
+#include "vector.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NPY_MAGIC "\x93NUMPY"
+#define NPY_MAGIC_LEN 6
+// data starts at a multiple of this offset
+#define NPY_ALIGN 64
+
+struct npy_header
+{
+    int ndim;
+    long shape[2];
+    bool fortran_order;
+    bool swap;
+    int item_size;
+    size_t data_offset;
+};
+
+static bool host_is_little_endian()
+{
+    uint16_t x = 1;
+    return *(unsigned char*)&x == 1;
+}
+
+// value of key in the header dictionary, NULL if there is no such key
+static const char* npy_header_value(const char* header, const char* key)
+{
+    const char* p = strstr(header, key);
+    if(p == NULL)
+        return NULL;
+    p += strlen(key);
+    while(*p == ' ' || *p == ':')
+        ++p;
+    return p;
+}
+
+// returns the error message or NULL
+static const char* npy_parse_header(const unsigned char* file, size_t size, struct npy_header* h)
+{
+    if(size < NPY_MAGIC_LEN + 4 || memcmp(file, NPY_MAGIC, NPY_MAGIC_LEN) != 0)
+        return "Not a .npy file";
+
+    int major = file[NPY_MAGIC_LEN];
+    size_t header_len, prefix;
+    if(major == 1)
+    {
+        header_len = file[8] | (file[9] << 8);
+        prefix = 10;
+    }
+    else if(major == 2 || major == 3)
+    {
+        if(size < 12)
+            return "Not a .npy file";
+        header_len = file[8] | (file[9] << 8) | ((size_t)file[10] << 16) | ((size_t)file[11] << 24);
+        prefix = 12;
+    }
+    else
+        return "Unsupported .npy format version";
+
+    if(prefix + header_len > size)
+        return "Truncated .npy header";
+    h->data_offset = prefix + header_len;
+
+    char* header = malloc(header_len + 1);
+    memcpy(header, file + prefix, header_len);
+    header[header_len] = 0;
+
+    const char* error = NULL;
+    const char* descr = npy_header_value(header, "'descr'");
+    const char* fortran = npy_header_value(header, "'fortran_order'");
+    const char* shape = npy_header_value(header, "'shape'");
+    if(descr == NULL || fortran == NULL || shape == NULL)
+        error = "Invalid .npy header";
+    else if(strncmp(descr + 1, "<f8", 3) != 0 && strncmp(descr + 1, ">f8", 3) != 0
+        && strncmp(descr + 1, "<f4", 3) != 0 && strncmp(descr + 1, ">f4", 3) != 0
+        && strncmp(descr + 1, "=f8", 3) != 0 && strncmp(descr + 1, "=f4", 3) != 0)
+        error = "Only float64 and float32 .npy data is supported";
+    else
+    {
+        bool little = descr[1] == '<' || (descr[1] == '=' && host_is_little_endian());
+        h->swap = little != host_is_little_endian();
+        h->item_size = descr[3] - '0';
+        h->fortran_order = strncmp(fortran, "True", 4) == 0;
+
+        h->ndim = 0;
+        const char* p = shape;
+        if(*p == '(')
+            ++p;
+        while(*p != ')' && *p != 0 && error == NULL)
+        {
+            char* end;
+            long d = strtol(p, &end, 10);
+            if(end == p)
+                break;
+            if(h->ndim == 2)
+                error = "Only 1 and 2 dimensional arrays are supported";
+            else
+                h->shape[h->ndim++] = d;
+            p = end;
+            while(*p == ',' || *p == ' ')
+                ++p;
+        }
+    }
+
+    free(header);
+    return error;
+}
+
+static void npy_read_values(const unsigned char* src, const struct npy_header* h, size_t i, double* out)
+{
+    if(h->item_size == 8)
+    {
+        uint64_t bits;
+        memcpy(&bits, src + 8 * i, 8);
+        if(h->swap)
+            bits = __builtin_bswap64(bits);
+        memcpy(out, &bits, 8);
+    }
+    else
+    {
+        uint32_t bits;
+        float f;
+        memcpy(&bits, src + 4 * i, 4);
+        if(h->swap)
+            bits = __builtin_bswap32(bits);
+        memcpy(&f, &bits, 4);
+        *out = f;
+    }
+}
+
+// copies rows x columns elements into data in row-major order
+static void npy_convert(const unsigned char* src, const struct npy_header* h, int rows, int columns, double* data)
+{
+    if(!h->fortran_order && h->item_size == 8 && !h->swap)
+    {
+        memcpy(data, src, (size_t)rows * columns * sizeof(double));
+        return;
+    }
+
+    for(int i = 0; i < rows; ++i)
+        for(int j = 0; j < columns; ++j)
+        {
+            size_t k = h->fortran_order ? i + (size_t)rows * j : j + (size_t)columns * i;
+            npy_read_values(src, h, k, data + j + (size_t)columns * i);
+        }
+}
+
+// the file is mapped and converted straight into the new object
+static VALUE npy_load(VALUE path, int ndim)
+{
+    FilePathValue(path);
+    const char* name = StringValueCStr(path);
+
+    int fd = open(name, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        rb_sys_fail(name);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        rb_raise(fm_eError, "Not a .npy file");
+    }
+    size_t size = st.st_size;
+    unsigned char* file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(file == MAP_FAILED)
+        rb_sys_fail(name);
+
+    struct npy_header h;
+    const char* error = npy_parse_header(file, size, &h);
+    long rows = 0, columns = 0;
+    if(error == NULL && h.ndim != ndim)
+        error = ndim == 2 ? "Expected 2 dimensional array" : "Expected 1 dimensional array";
+    if(error == NULL)
+    {
+        rows = ndim == 2 ? h.shape[0] : 1;
+        columns = ndim == 2 ? h.shape[1] : h.shape[0];
+        //  the product is formed only after it is known to fit
+        if(rows <= 0 || columns <= 0 || rows > INT_MAX || columns > INT_MAX || rows > INT_MAX / columns)
+            error = "Unsupported array size";
+        else if(h.data_offset + (size_t)rows * columns * h.item_size > size)
+            error = "Truncated .npy data";
+    }
+    if(error != NULL)
+    {
+        munmap(file, size);
+        rb_raise(fm_eError, "%s", error);
+    }
+
+    VALUE result;
+    double* data;
+    if(ndim == 2)
+    {
+        struct matrix* R;
+        result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+        c_matrix_init(R, (int)columns, (int)rows);
+        data = R->data;
+    }
+    else
+    {
+        struct vector* R;
+        result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
+        c_vector_init(R, (int)columns);
+        data = R->data;
+    }
+    npy_convert(file + h.data_offset, &h, (int)rows, (int)columns, data);
+
+    munmap(file, size);
+    return result;
+}
+
+static int npy_item_size_arg(VALUE dtype)
+{
+    if(SYMBOL_P(dtype))
+    {
+        ID id = SYM2ID(dtype);
+        if(id == rb_intern("float64"))
+            return 8;
+        if(id == rb_intern("float32"))
+            return 4;
+    }
+    rb_raise(rb_eArgError, "expected :float64 or :float32");
+    return 8;
+}
+
+// shape is "(n,)" for vectors
+static void npy_save(VALUE path, const char* shape, int len, const double* data, VALUE dtype)
+{
+    int item_size = npy_item_size_arg(dtype);
+    FilePathValue(path);
+    const char* name = StringValueCStr(path);
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header) - NPY_ALIGN,
+                              "{'descr': '%c%s', 'fortran_order': False, 'shape': %s, }",
+                              host_is_little_endian() ? '<' : '>', item_size == 8 ? "f8" : "f4", shape);
+    //  spaces and a newline pad the header to the alignment
+    while((10 + header_len + 1) % NPY_ALIGN != 0)
+        header[header_len++] = ' ';
+    header[header_len++] = '\n';
+
+    FILE* file = fopen(name, "wb");
+    if(file == NULL)
+        rb_sys_fail(name);
+
+    unsigned char prefix[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                                 header_len & 0xff, (header_len >> 8) & 0xff };
+    bool ok = fwrite(prefix, 1, 10, file) == 10
+           && fwrite(header, 1, header_len, file) == (size_t)header_len;
+
+    if(item_size == 8)
+        ok = ok && fwrite(data, sizeof(double), len, file) == (size_t)len;
+    else
+    {
+        float buffer[1024];
+        for(int i = 0; i < len && ok; i += 1024)
+        {
+            int count = (len - i < 1024) ? len - i : 1024;
+            for(int t = 0; t < count; ++t)
+                buffer[t] = (float)data[i + t];
+            ok = fwrite(buffer, sizeof(float), count, file) == (size_t)count;
+        }
+    }
+
+    if(fclose(file) != 0 || !ok)
+        rb_sys_fail(name);
+}
+
+VALUE matrix_s_load_npy(VALUE klass, VALUE path)
+{
+    return npy_load(path, 2);
+}
+
+VALUE vector_s_load_npy(VALUE klass, VALUE path)
+{
+    return npy_load(path, 1);
+}
+
+VALUE matrix_save_npy(VALUE self, VALUE path, VALUE dtype)
+{
+    struct matrix* A;
+    TypedData_Get_Struct(self, struct matrix, &matrix_type, A);
+
+    char shape[64];
+    snprintf(shape, sizeof(shape), "(%d, %d)", A->n, A->m);
+    npy_save(path, shape, A->m * A->n, A->data, dtype);
+    return self;
+}
+
+VALUE vector_save_npy(VALUE self, VALUE path, VALUE dtype)
+{
+    struct vector* A;
+    TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    char shape[64];
+    snprintf(shape, sizeof(shape), "(%d,)", A->n);
+    npy_save(path, shape, A->n, A->data, dtype);
+    return self;
+}
+
+void init_fm_npy()
+{
+    rb_define_singleton_method(cMatrix, "load_npy", matrix_s_load_npy, 1);
+    rb_define_private_method(cMatrix, "save_npy_impl", matrix_save_npy, 2);
+    rb_define_singleton_method(cVector, "load_npy", vector_s_load_npy, 1);
+    rb_define_private_method(cVector, "save_npy_impl", vector_save_npy, 2);
+}
@@ -0,0 +1,9 @@
+#ifndef FAST_MATRIX_NPY_H
+#define FAST_MATRIX_NPY_H 1
+
+// Reading and writing of NumPy .npy files (format versions 1.0-3.0)
+// with float64 and float32 data in either byte order and memory order.
+
+void init_fm_npy();
+
+#endif /* FAST_MATRIX_NPY_H */
@@ -0,0 +1,243 @@
+#include "parallel.h"
+#include "ruby.h"
+#include "ruby/thread.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Persistent pool of native workers, started on the first parallel job.
+// Only one job runs on the pool at a time: a concurrent or nested
+// parallel_for runs its tasks on the calling thread instead.
+
+struct parallel_job
+{
+    void (*fn)(void* arg, int task);
+    void* arg;
+    int tasks;
+    int next;
+    int done;
+    int active;
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t submit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static struct parallel_job* current_job = NULL;
+static unsigned long generation = 0;
+static int workers_count = 0;
+static int threads_count = 0;
+static bool pool_started = false;
+
+// set for pool workers and for threads which released the GVL in parallel_for
+static __thread bool inside_parallel = false;
+
+// buffers released while a job runs without the GVL, freed after it
+struct deferred_free
+{
+    struct deferred_free* next;
+    void* buffer;
+};
+
+static pthread_mutex_t deferred_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int jobs_without_gvl = 0;
+static struct deferred_free* deferred = NULL;
+
+int parallel_threads_count()
+{
+    if(threads_count > 0)
+        return threads_count;
+
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* env = getenv("FAST_MATRIX_NUM_THREADS");
+    if(env != NULL && atoi(env) > 0)
+        count = atoi(env);
+    if(count < 1)
+        count = 1;
+    threads_count = count > 64 ? 64 : (int)count;
+    return threads_count;
+}
+
+int parallel_tasks(long work, int rows)
+{
+    if(work < PARALLEL_THRESHOLD)
+        return 1;
+    int tasks = parallel_threads_count();
+    if(tasks > PARALLEL_MAX_TASKS)
+        tasks = PARALLEL_MAX_TASKS;
+    return tasks < rows ? tasks : rows;
+}
+
+static void parallel_run_tasks(struct parallel_job* job)
+{
+    int task;
+    while((task = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->tasks)
+    {
+        job->fn(job->arg, task);
+        __atomic_fetch_add(&job->done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void* parallel_worker(void* data)
+{
+    unsigned long seen = 0;
+    inside_parallel = true;
+
+    pthread_mutex_lock(&pool_mutex);
+    for(;;)
+    {
+        while(generation == seen)
+            pthread_cond_wait(&work_cond, &pool_mutex);
+        seen = generation;
+
+        struct parallel_job* job = current_job;
+        if(job == NULL)
+            continue;
+        ++job->active;
+        pthread_mutex_unlock(&pool_mutex);
+
+        parallel_run_tasks(job);
+
+        pthread_mutex_lock(&pool_mutex);
+        if(--job->active == 0)
+            pthread_cond_signal(&done_cond);
+    }
+    return NULL;
+}
+
+//  threads do not survive fork, the child starts a new pool on demand
+static void parallel_after_fork()
+{
+    pthread_mutex_init(&pool_mutex, NULL);
+    pthread_mutex_init(&submit_mutex, NULL);
+    pthread_mutex_init(&deferred_mutex, NULL);
+    pthread_cond_init(&work_cond, NULL);
+    pthread_cond_init(&done_cond, NULL);
+    current_job = NULL;
+    workers_count = 0;
+    pool_started = false;
+}
+
+static void parallel_start_pool()
+{
+    pool_started = true;
+    pthread_atfork(NULL, NULL, parallel_after_fork);
+
+    int count = parallel_threads_count() - 1;
+    for(int i = 0; i < count; ++i)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, parallel_worker, NULL) != 0)
+            break;
+        pthread_detach(thread);
+        ++workers_count;
+    }
+}
+
+static void* parallel_run_job(void* data)
+{
+    struct parallel_job* job = data;
+
+    pthread_mutex_lock(&pool_mutex);
+    current_job = job;
+    ++generation;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_mutex);
+
+    parallel_run_tasks(job);
+
+    pthread_mutex_lock(&pool_mutex);
+    while(__atomic_load_n(&job->done, __ATOMIC_ACQUIRE) < job->tasks || job->active > 0)
+        pthread_cond_wait(&done_cond, &pool_mutex);
+    current_job = NULL;
+    pthread_mutex_unlock(&pool_mutex);
+    return NULL;
+}
+
+static void* parallel_run_job_without_gvl(void* data)
+{
+    inside_parallel = true;
+    parallel_run_job(data);
+    inside_parallel = false;
+    return data;
+}
+
+void parallel_free(void* buffer)
+{
+    if(buffer == NULL)
+        return;
+    if(__atomic_load_n(&jobs_without_gvl, __ATOMIC_ACQUIRE) == 0)
+    {
+        free(buffer);
+        return;
+    }
+
+    pthread_mutex_lock(&deferred_mutex);
+    if(jobs_without_gvl == 0)
+    {
+        pthread_mutex_unlock(&deferred_mutex);
+        free(buffer);
+        return;
+    }
+    struct deferred_free* node = malloc(sizeof(struct deferred_free));
+    node->next = deferred;
+    node->buffer = buffer;
+    deferred = node;
+    pthread_mutex_unlock(&deferred_mutex);
+}
+
+//  the caller read its buffers under the GVL, other threads
+//  see the job before they can release any of them
+static void parallel_run_job_releasing_gvl(struct parallel_job* job)
+{
+    pthread_mutex_lock(&deferred_mutex);
+    __atomic_add_fetch(&jobs_without_gvl, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&deferred_mutex);
+
+    //  rb_thread_call_without_gvl would raise pending interrupts and skip
+    //  the cleanup below, the 2 version only returns NULL without running
+    //  the job, which then runs holding the GVL
+    if(rb_thread_call_without_gvl2(parallel_run_job_without_gvl, job, NULL, NULL) == NULL)
+        parallel_run_job(job);
+
+    struct deferred_free* list = NULL;
+    pthread_mutex_lock(&deferred_mutex);
+    if(__atomic_sub_fetch(&jobs_without_gvl, 1, __ATOMIC_RELEASE) == 0)
+    {
+        list = deferred;
+        deferred = NULL;
+    }
+    pthread_mutex_unlock(&deferred_mutex);
+
+    while(list != NULL)
+    {
+        struct deferred_free* next = list->next;
+        free(list->buffer);
+        free(list);
+        list = next;
+    }
+}
+
+void parallel_for(int tasks, void (*fn)(void* arg, int task), void* arg)
+{
+    if(tasks <= 1 || inside_parallel || pthread_mutex_trylock(&submit_mutex) != 0)
+    {
+        for(int i = 0; i < tasks; ++i)
+            fn(arg, i);
+        return;
+    }
+
+    if(!pool_started)
+        parallel_start_pool();
+
+    struct parallel_job job = { fn, arg, tasks, 0, 0, 0 };
+    if(workers_count == 0)
+        parallel_run_tasks(&job);
+    else if(ruby_native_thread_p())
+        parallel_run_job_releasing_gvl(&job);
+    else
+        parallel_run_job(&job);
+
+    pthread_mutex_unlock(&submit_mutex);
+}
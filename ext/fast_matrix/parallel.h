@@ -0,0 +1,27 @@
+#ifndef FAST_MATRIX_PARALLEL_H
+#define FAST_MATRIX_PARALLEL_H 1
+
+// number of native threads used for parallel kernels,
+// the FAST_MATRIX_NUM_THREADS environment variable overrides it
+int parallel_threads_count();
+
+// jobs with less work than this run on the calling thread
+#define PARALLEL_THRESHOLD (1 << 17)
+// maximum number of tasks of one job
+#define PARALLEL_MAX_TASKS 64
+
+// number of tasks to split work over rows independent rows into:
+// 1 below PARALLEL_THRESHOLD, otherwise one per thread, at most rows
+int parallel_tasks(long work, int rows);
+
+// call fn(arg, task) for every task in [0, tasks) on the shared
+// thread pool and wait for all of them; the calling thread takes part
+// and releases the GVL while waiting
+void parallel_for(int tasks, void (*fn)(void* arg, int task), void* arg);
+
+// frees a buffer of a matrix or vector. While parallel_for runs without
+// the GVL another Ruby thread may swap out and release a buffer the job
+// still reads, so such buffers are freed only after the job finishes
+void parallel_free(void* buffer);
+
+#endif /* FAST_MATRIX_PARALLEL_H */
@@ -0,0 +1,259 @@
+#include "profile.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_VALUE_NEWKEY
+#include "ruby/ractor.h"
+#endif
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#endif
+
+#define PROFILE_STATS 1
+#define PROFILE_HOOKS 2
+// shapes are counted in power of two buckets: 1, 2, 4, ..., 2^31
+#define PROFILE_BUCKETS 32
+
+int profile_enabled = 0;
+
+struct profile_stats
+{
+    unsigned long long calls;
+    unsigned long long nanoseconds;
+    unsigned long long flops;
+    unsigned long long bytes;
+    unsigned long long shapes[PROFILE_BUCKETS][PROFILE_BUCKETS];
+};
+
+static struct profile_stats stats[PROFILE_OPS_COUNT];
+
+static const char* const op_names[PROFILE_OPS_COUNT] =
+{
+    [PROFILE_MATRIX_NEW] = "Matrix.new",
+    [PROFILE_MATRIX_CLONE] = "Matrix#clone",
+    [PROFILE_MATRIX_MULTIPLY] = "Matrix#*",
+    [PROFILE_MATRIX_STRASSEN] = "Matrix#strassen",
+    [PROFILE_MATRIX_DETERMINANT] = "Matrix#determinant",
+    [PROFILE_MATRIX_TRANSPOSE] = "Matrix#transpose",
+    [PROFILE_MATRIX_ADD] = "Matrix#+",
+    [PROFILE_MATRIX_SUB] = "Matrix#-",
+    [PROFILE_MATRIX_ADD_FROM] = "Matrix#+=",
+    [PROFILE_MATRIX_SUB_FROM] = "Matrix#-=",
+    [PROFILE_VECTOR_NEW] = "Vector.new",
+    [PROFILE_VECTOR_CLONE] = "Vector#clone",
+    [PROFILE_VECTOR_MULTIPLY] = "Vector#*",
+    [PROFILE_VECTOR_ADD] = "Vector#+",
+    [PROFILE_VECTOR_SUB] = "Vector#-",
+    [PROFILE_VECTOR_ADD_FROM] = "Vector#+=",
+    [PROFILE_VECTOR_SUB_FROM] = "Vector#-=",
+};
+
+// frozen, so they can be passed to hooks of any ractor
+static VALUE op_strings[PROFILE_OPS_COUNT];
+
+//  every ractor has its own hook, a hook never runs in a foreign ractor
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_VALUE_NEWKEY
+static rb_ractor_local_key_t hook_key;
+#else
+static VALUE hook_value = Qnil;
+#endif
+static int hooks_count = 0;
+
+//  operations called from a hook are not reported again
+static __thread bool in_hook = false;
+
+static VALUE hook_get()
+{
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_VALUE_NEWKEY
+    return rb_ractor_local_storage_value(hook_key);
+#else
+    return hook_value;
+#endif
+}
+
+static void hook_set(VALUE hook)
+{
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_VALUE_NEWKEY
+    rb_ractor_local_storage_value_set(hook_key, hook);
+#else
+    hook_value = hook;
+#endif
+}
+
+unsigned long long profile_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int shape_bucket(int x)
+{
+    return x <= 1 ? 0 : 32 - __builtin_clz((unsigned)x - 1);
+}
+
+struct hook_call
+{
+    VALUE hook;
+    VALUE* args;
+};
+
+static VALUE hook_invoke(VALUE data)
+{
+    struct hook_call* call = (struct hook_call*)data;
+    return rb_funcallv(call->hook, rb_intern("call"), 5, call->args);
+}
+
+static VALUE hook_leave(VALUE data)
+{
+    in_hook = false;
+    return Qnil;
+}
+
+void profile_record(enum profile_op op, unsigned long long start, int rows, int columns,
+                    unsigned long long flops, unsigned long long bytes)
+{
+    unsigned long long nanoseconds = profile_clock() - start;
+
+#ifdef HAVE_SYS_SDT_H
+    DTRACE_PROBE6(fast_matrix, operation, op_names[op], nanoseconds, rows, columns, flops, bytes);
+#endif
+
+    if(profile_enabled & PROFILE_STATS)
+    {
+        struct profile_stats* s = stats + op;
+        __atomic_fetch_add(&s->calls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->nanoseconds, nanoseconds, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->flops, flops, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->shapes[shape_bucket(rows)][shape_bucket(columns)], 1, __ATOMIC_RELAXED);
+    }
+
+    if(!(profile_enabled & PROFILE_HOOKS) || in_hook)
+        return;
+    VALUE hook = hook_get();
+    if(NIL_P(hook))
+        return;
+
+    VALUE args[5] =
+    {
+        op_strings[op],
+        ULL2NUM(nanoseconds),
+        rb_assoc_new(INT2NUM(rows), INT2NUM(columns)),
+        ULL2NUM(flops),
+        ULL2NUM(bytes),
+    };
+    struct hook_call call = { hook, args };
+    in_hook = true;
+    rb_ensure(hook_invoke, (VALUE)&call, hook_leave, Qnil);
+}
+
+static void profile_update_enabled(bool stats_enabled)
+{
+    int flags = stats_enabled ? PROFILE_STATS : 0;
+    if(__atomic_load_n(&hooks_count, __ATOMIC_RELAXED) > 0)
+        flags |= PROFILE_HOOKS;
+    __atomic_store_n(&profile_enabled, flags, __ATOMIC_RELAXED);
+}
+
+static bool profile_stats_enabled()
+{
+    return __atomic_load_n(&profile_enabled, __ATOMIC_RELAXED) & PROFILE_STATS;
+}
+
+VALUE profile_set_stats_enabled(VALUE self, VALUE enabled)
+{
+    profile_update_enabled(RTEST(enabled));
+    return enabled;
+}
+
+VALUE profile_stats_enabled_p(VALUE self)
+{
+    return profile_stats_enabled() ? Qtrue : Qfalse;
+}
+
+// a hash from operation name to its counters, only called operations are listed
+VALUE profile_stats(VALUE self)
+{
+    VALUE result = rb_hash_new();
+    for(int op = 0; op < PROFILE_OPS_COUNT; ++op)
+    {
+        const struct profile_stats* s = stats + op;
+        unsigned long long calls = __atomic_load_n(&s->calls, __ATOMIC_RELAXED);
+        if(calls == 0)
+            continue;
+
+        VALUE shapes = rb_hash_new();
+        for(int i = 0; i < PROFILE_BUCKETS; ++i)
+            for(int j = 0; j < PROFILE_BUCKETS; ++j)
+            {
+                unsigned long long count = __atomic_load_n(&s->shapes[i][j], __ATOMIC_RELAXED);
+                if(count != 0)
+                    rb_hash_aset(shapes, rb_assoc_new(ULL2NUM(1ULL << i), ULL2NUM(1ULL << j)), ULL2NUM(count));
+            }
+
+        VALUE entry = rb_hash_new();
+        rb_hash_aset(entry, ID2SYM(rb_intern("calls")), ULL2NUM(calls));
+        rb_hash_aset(entry, ID2SYM(rb_intern("nanoseconds")), ULL2NUM(__atomic_load_n(&s->nanoseconds, __ATOMIC_RELAXED)));
+        rb_hash_aset(entry, ID2SYM(rb_intern("flops")), ULL2NUM(__atomic_load_n(&s->flops, __ATOMIC_RELAXED)));
+        rb_hash_aset(entry, ID2SYM(rb_intern("bytes")), ULL2NUM(__atomic_load_n(&s->bytes, __ATOMIC_RELAXED)));
+        rb_hash_aset(entry, ID2SYM(rb_intern("shapes")), shapes);
+        rb_hash_aset(result, op_strings[op], entry);
+    }
+    return result;
+}
+
+VALUE profile_reset_stats(VALUE self)
+{
+    for(int op = 0; op < PROFILE_OPS_COUNT; ++op)
+    {
+        unsigned long long* counters = (unsigned long long*)(stats + op);
+        int len = sizeof(struct profile_stats) / sizeof(unsigned long long);
+        for(int i = 0; i < len; ++i)
+            __atomic_store_n(counters + i, 0, __ATOMIC_RELAXED);
+    }
+    return Qnil;
+}
+
+// sets the hook of the current ractor from the block, removes it without a block
+VALUE profile_on_operation(VALUE self)
+{
+    VALUE hook = rb_block_given_p() ? rb_block_proc() : Qnil;
+    VALUE previous = hook_get();
+
+    if(NIL_P(previous) && !NIL_P(hook))
+        __atomic_fetch_add(&hooks_count, 1, __ATOMIC_RELAXED);
+    if(!NIL_P(previous) && NIL_P(hook))
+        __atomic_fetch_sub(&hooks_count, 1, __ATOMIC_RELAXED);
+
+    hook_set(hook);
+    profile_update_enabled(profile_stats_enabled());
+    return previous;
+}
+
+void init_fm_profile()
+{
+    VALUE mod = rb_define_module("FastMatrix");
+
+#ifdef HAVE_RB_RACTOR_LOCAL_STORAGE_VALUE_NEWKEY
+    hook_key = rb_ractor_local_storage_value_newkey();
+#else
+    rb_gc_register_address(&hook_value);
+#endif
+
+    for(int op = 0; op < PROFILE_OPS_COUNT; ++op)
+    {
+        op_strings[op] = rb_obj_freeze(rb_str_new_cstr(op_names[op]));
+        rb_gc_register_mark_object(op_strings[op]);
+    }
+
+    const char* env = getenv("FAST_MATRIX_STATS");
+    profile_update_enabled(env != NULL && strcmp(env, "") != 0 && strcmp(env, "0") != 0);
+
+    rb_define_module_function(mod, "stats", profile_stats, 0);
+    rb_define_module_function(mod, "reset_stats", profile_reset_stats, 0);
+    rb_define_module_function(mod, "stats_enabled=", profile_set_stats_enabled, 1);
+    rb_define_module_function(mod, "stats_enabled?", profile_stats_enabled_p, 0);
+    rb_define_module_function(mod, "on_operation", profile_on_operation, 0);
+}
@@ -0,0 +1,48 @@
+#ifndef FAST_MATRIX_PROFILE_H
+#define FAST_MATRIX_PROFILE_H 1
+
+#include "ruby.h"
+
+enum profile_op
+{
+    PROFILE_MATRIX_NEW,
+    PROFILE_MATRIX_CLONE,
+    PROFILE_MATRIX_MULTIPLY,
+    PROFILE_MATRIX_STRASSEN,
+    PROFILE_MATRIX_DETERMINANT,
+    PROFILE_MATRIX_TRANSPOSE,
+    PROFILE_MATRIX_ADD,
+    PROFILE_MATRIX_SUB,
+    PROFILE_MATRIX_ADD_FROM,
+    PROFILE_MATRIX_SUB_FROM,
+    PROFILE_VECTOR_NEW,
+    PROFILE_VECTOR_CLONE,
+    PROFILE_VECTOR_MULTIPLY,
+    PROFILE_VECTOR_ADD,
+    PROFILE_VECTOR_SUB,
+    PROFILE_VECTOR_ADD_FROM,
+    PROFILE_VECTOR_SUB_FROM,
+    PROFILE_OPS_COUNT,
+};
+
+// nonzero while stats are collected or some hook is set
+extern int profile_enabled;
+
+unsigned long long profile_clock();
+
+// start - value of PROFILE_START, rows x columns - shape of the receiver,
+// bytes - size of allocated result
+void profile_record(enum profile_op op, unsigned long long start, int rows, int columns,
+                    unsigned long long flops, unsigned long long bytes);
+
+// When profiling is disabled an operation pays for one load and one branch:
+//     unsigned long long start = PROFILE_START();
+//     ... operation ...
+//     PROFILE_FINISH(op, start, rows, columns, flops, bytes);
+#define PROFILE_START() (profile_enabled ? profile_clock() : 0)
+#define PROFILE_FINISH(op, start, rows, columns, flops, bytes) \
+    do { if(start) profile_record(op, start, rows, columns, flops, bytes); } while(0)
+
+void init_fm_profile();
+
+#endif /* FAST_MATRIX_PROFILE_H */
@@ -0,0 +1,121 @@
+#include "random.h"
+#include "parallel.h"
+#include <math.h>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). One block of four 32-bit words
+// gives two doubles with 53 random bits each.
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// arrays shorter than this are generated on the calling thread
+#define RANDOM_PARALLEL_THRESHOLD (1 << 16)
+
+static void philox(uint64_t counter, uint64_t seed, uint32_t out[4])
+{
+    uint32_t c0 = (uint32_t)counter;
+    uint32_t c1 = (uint32_t)(counter >> 32);
+    uint32_t c2 = 0;
+    uint32_t c3 = 0;
+    uint32_t k0 = (uint32_t)seed;
+    uint32_t k1 = (uint32_t)(seed >> 32);
+
+    for(int round = 0; round < 10; ++round)
+    {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t)p1;
+        c2 = n2;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// 53 random bits to [0, 1)
+static double to_unit(uint32_t hi, uint32_t lo)
+{
+    uint64_t bits = (((uint64_t)hi << 32) | lo) >> 11;
+    return (double)bits * (1.0 / 9007199254740992.0);
+}
+
+// block i fills a[2i] and a[2i + 1]
+static void random_block(uint64_t block, uint64_t seed, enum random_distribution distribution, double r[2])
+{
+    uint32_t words[4];
+    philox(block, seed, words);
+    double u1 = to_unit(words[0], words[1]);
+    double u2 = to_unit(words[2], words[3]);
+
+    if(distribution == RANDOM_UNIFORM)
+    {
+        r[0] = u1;
+        r[1] = u2;
+        return;
+    }
+
+    //  Box-Muller, 1 - u1 is in (0, 1]
+    double radius = sqrt(-2 * log(1 - u1));
+    double angle = 2 * M_PI * u2;
+    r[0] = radius * cos(angle);
+    r[1] = radius * sin(angle);
+}
+
+struct random_args
+{
+    int len;
+    int tasks;
+    double* a;
+    enum random_distribution distribution;
+    uint64_t seed;
+};
+
+static void random_task(void* data, int task)
+{
+    struct random_args* args = data;
+    int blocks = (args->len + 1) / 2;
+    int begin = (int)((long long)blocks * task / args->tasks);
+    int end = (int)((long long)blocks * (task + 1) / args->tasks);
+
+    double r[2];
+    for(int i = begin; i < end; ++i)
+    {
+        random_block(i, args->seed, args->distribution, r);
+        args->a[2 * i] = r[0];
+        if(2 * i + 1 < args->len)
+            args->a[2 * i + 1] = r[1];
+    }
+}
+
+void c_random_fill(int len, double* a, enum random_distribution distribution, uint64_t seed)
+{
+    struct random_args args = { len, 1, a, distribution, seed };
+    if(len >= RANDOM_PARALLEL_THRESHOLD)
+        args.tasks = parallel_threads_count();
+
+    parallel_for(args.tasks, random_task, &args);
+}
+
+enum random_distribution random_distribution_arg(VALUE distribution)
+{
+    if(SYMBOL_P(distribution))
+    {
+        ID id = SYM2ID(distribution);
+        if(id == rb_intern("uniform"))
+            return RANDOM_UNIFORM;
+        if(id == rb_intern("normal"))
+            return RANDOM_NORMAL;
+    }
+    rb_raise(rb_eArgError, "expected :uniform or :normal distribution");
+    return RANDOM_UNIFORM;
+}
@@ -0,0 +1,21 @@
+#ifndef FAST_MATRIX_RANDOM_H
+#define FAST_MATRIX_RANDOM_H 1
+
+#include "ruby.h"
+#include <stdint.h>
+
+enum random_distribution
+{
+    RANDOM_UNIFORM,
+    RANDOM_NORMAL,
+};
+
+// :uniform or :normal, raises ArgumentError otherwise
+enum random_distribution random_distribution_arg(VALUE distribution);
+
+// Element i depends only on seed and i (Philox4x32-10 keyed by seed,
+// counter i / 2), so results do not depend on the number of threads.
+// uniform - values in [0, 1), normal - standard normal values
+void c_random_fill(int len, double* a, enum random_distribution distribution, uint64_t seed);
+
+#endif /* FAST_MATRIX_RANDOM_H */
@@ -2,11 +2,15 @@
 #include "c_array_operations.h"
 #include "errors.h"
 #include "matrix.h"
+#include "profile.h"
+#include "random.h"
+#include <math.h>
 
 VALUE cVector;
 
 void vector_free(void* data);
 size_t vector_size(const void* data);
+VALUE vector_copy(VALUE v);
 
 const rb_data_type_t vector_type =
 {
@@ -18,12 +22,17 @@ const rb_data_type_t vector_type =
                 .dsize = vector_size,
         },
         .data = NULL,
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+        .flags = RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_FROZEN_SHAREABLE,
+#else
         .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+#endif
 };
 
 void vector_free(void* data)
 {
-	free(((*(struct vector*)data)).data);
+    struct vector* V = data;
+    release_d_array(V->data, V->shared);
     free(data);
 }
 
@@ -36,6 +45,7 @@ VALUE vector_alloc(VALUE self)
 {
 	struct vector* vct = malloc(sizeof(struct vector));
     vct->data = NULL;
+    vct->shared = NULL;
 	return TypedData_Wrap_Struct(self, &vector_type, vct);
 }
 
@@ -43,6 +53,12 @@ void c_vector_init(struct vector* vect, int n)
 {
     vect->n = n;
     vect->data = malloc(n * sizeof(double));
+    vect->shared = NULL;
+}
+
+void c_vector_modify(struct vector* V)
+{
+    unshare_d_array(V->n, &V->data, &V->shared);
 }
 
 VALUE vector_initialize(VALUE self, VALUE size)
@@ -55,7 +71,9 @@ VALUE vector_initialize(VALUE self, VALUE size)
 
 	TypedData_Get_Struct(self, struct vector, &vector_type, data);
 
+    unsigned long long start = PROFILE_START();
     c_vector_init(data, n);
+    PROFILE_FINISH(PROFILE_VECTOR_NEW, start, n, 1, 0, 8ULL * n);
 
 	return self;
 }
@@ -63,6 +81,7 @@ VALUE vector_initialize(VALUE self, VALUE size)
 //  []=
 VALUE vector_set(VALUE self, VALUE idx, VALUE v)
 {
+    rb_check_frozen(self);
     int i = raise_rb_value_to_int(idx);
     double x = raise_rb_value_to_double(v);
 
@@ -72,6 +91,7 @@ VALUE vector_set(VALUE self, VALUE idx, VALUE v)
     i = (i < 0) ? data->n + i : i;
     raise_check_range(i, 0, data->n);
 
+    c_vector_modify(data);
     data->data[i] = x;
     return v;
 }
@@ -112,11 +132,13 @@ VALUE vector_add_with(VALUE self, VALUE value)
 
     int n = A->n;
 
+    unsigned long long start = PROFILE_START();
     struct vector* C;
     VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, C);
 
     c_vector_init(C, n);
     add_d_arrays_to_result(n, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_VECTOR_ADD, start, n, 1, n, 8ULL * n);
 
     return result;
 }
@@ -124,6 +146,7 @@ VALUE vector_add_with(VALUE self, VALUE value)
 
 VALUE vector_add_from(VALUE self, VALUE value)
 {
+    rb_check_frozen(self);
 	struct vector* A;
     struct vector* B;
 	TypedData_Get_Struct(self, struct vector, &vector_type, A);
@@ -134,38 +157,169 @@ VALUE vector_add_from(VALUE self, VALUE value)
 
     int n = A->n;
 
+    c_vector_modify(A);
+    unsigned long long start = PROFILE_START();
     add_d_arrays_to_first(n, A->data, B->data);
+    PROFILE_FINISH(PROFILE_VECTOR_ADD_FROM, start, n, 1, n, 0);
 
     return self;
 }
 
-VALUE vector_equal(VALUE self, VALUE value)
+VALUE vector_sub_with(VALUE self, VALUE value)
+{
+	struct vector* A;
+    struct vector* B;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+	TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int n = A->n;
+
+    unsigned long long start = PROFILE_START();
+    struct vector* C;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, C);
+
+    c_vector_init(C, n);
+    sub_d_arrays_to_result(n, A->data, B->data, C->data);
+    PROFILE_FINISH(PROFILE_VECTOR_SUB, start, n, 1, n, 8ULL * n);
+
+    return result;
+}
+
+VALUE vector_sub_from(VALUE self, VALUE value)
+{
+    rb_check_frozen(self);
+	struct vector* A;
+    struct vector* B;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+	TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes matrices");
+
+    int n = A->n;
+
+    c_vector_modify(A);
+    unsigned long long start = PROFILE_START();
+    sub_d_arrays_to_first(n, A->data, B->data);
+    PROFILE_FINISH(PROFILE_VECTOR_SUB_FROM, start, n, 1, n, 0);
+
+    return self;
+}
+
+VALUE vector_dot(VALUE self, VALUE value)
+{
+	struct vector* A;
+    struct vector* B;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+	TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes vectors");
+
+    return DBL2NUM(dot_d_arrays(A->n, A->data, B->data));
+}
+
+VALUE vector_norm(VALUE self)
+{
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    return DBL2NUM(sqrt(sum_squares_d_array(A->n, A->data)));
+}
+
+VALUE vector_normalize_self(VALUE self)
+{
+    rb_check_frozen(self);
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    double norm = sqrt(sum_squares_d_array(A->n, A->data));
+    if(norm == 0)
+        rb_raise(fm_eError, "Zero vector can't be normalized");
+
+    c_vector_modify(A);
+    for(int i = 0; i < A->n; ++i)
+        A->data[i] /= norm;
+    return self;
+}
+
+VALUE vector_normalize(VALUE self)
+{
+    return vector_normalize_self(vector_copy(self));
+}
+
+VALUE vector_cross_product(VALUE self, VALUE value)
 {
 	struct vector* A;
     struct vector* B;
 	TypedData_Get_Struct(self, struct vector, &vector_type, A);
 	TypedData_Get_Struct(value, struct vector, &vector_type, B);
 
+    if(A->n != 3 || B->n != 3)
+        rb_raise(fm_eIndexError, "Cross product is defined for 3-dimensional vectors");
+
+    const double* a = A->data;
+    const double* b = B->data;
+
+    struct vector* C;
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, C);
+
+    c_vector_init(C, 3);
+    C->data[0] = a[1] * b[2] - a[2] * b[1];
+    C->data[1] = a[2] * b[0] - a[0] * b[2];
+    C->data[2] = a[0] * b[1] - a[1] * b[0];
+
+    return result;
+}
+
+// false for objects of other types, so vectors can be keys of Hash
+VALUE vector_equal(VALUE self, VALUE value)
+{
+    if(!rb_typeddata_is_kind_of(value, &vector_type))
+        return Qfalse;
+
+    struct vector* A;
+    struct vector* B;
+    TypedData_Get_Struct(self, struct vector, &vector_type, A);
+    TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
     if(A->n != B->n)
-		return Qfalse;
+        return Qfalse;
 
     int n = A->n;
 
     if(equal_d_arrays(n, A->data, B->data))
-		return Qtrue;
-	return Qfalse;
+        return Qtrue;
+    return Qfalse;
+}
+
+VALUE vector_hash(VALUE self)
+{
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    st_index_t h = rb_hash_start(hash_d_array(A->n, A->data));
+    h = rb_hash_uint(h, A->n);
+    return ST2FIX(rb_hash_end(h));
 }
 
+// the clone shares the buffer until one of them is changed
 VALUE vector_copy(VALUE v)
 {
 	struct vector* V;
 	TypedData_Get_Struct(v, struct vector, &vector_type, V);
 
+    unsigned long long start = PROFILE_START();
     struct vector* R;
     VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
 
-    c_vector_init(R, V->n);
-    copy_d_array(R->n, V->data, R->data);
+    R->n = V->n;
+    R->shared = share_d_array(&V->shared);
+    R->data = V->data;
+    PROFILE_FINISH(PROFILE_VECTOR_CLONE, start, V->n, 1, 0, 0);
 
     return result;
 }
@@ -200,11 +354,32 @@ VALUE vector_multiply_vm(VALUE self, VALUE other)
     int m = M->m;
     int n = V->n;
 
+    unsigned long long start = PROFILE_START();
     struct matrix* R;
     VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
 
     c_matrix_init(R, m, n);
     c_vector_matrix_multiply(n, m, V->data, M->data, R->data);
+    PROFILE_FINISH(PROFILE_VECTOR_MULTIPLY, start, n, 1, 1ULL * m * n, 8ULL * m * n);
+
+    return result;
+}
+
+VALUE vector_outer(VALUE self, VALUE other)
+{
+	struct vector* A;
+    struct vector* B;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+	TypedData_Get_Struct(other, struct vector, &vector_type, B);
+
+    int m = B->n;
+    int n = A->n;
+
+    struct matrix* R;
+    VALUE result = TypedData_Make_Struct(cMatrix, struct matrix, &matrix_type, R);
+
+    c_matrix_init(R, m, n);
+    c_vector_matrix_multiply(n, m, A->data, B->data, R->data);
 
     return result;
 }
@@ -216,12 +391,14 @@ VALUE vector_multiply_vn(VALUE self, VALUE value)
 
     double d = NUM2DBL(value);
 
+    unsigned long long start = PROFILE_START();
     struct vector* R;
     VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
 
     c_vector_init(R, A->n);
     copy_d_array(R->n, A->data, R->data);
     multiply_d_array(R->n, R->data, d);
+    PROFILE_FINISH(PROFILE_VECTOR_MULTIPLY, start, A->n, 1, A->n, 8ULL * A->n);
 
     return result;
 }
@@ -236,12 +413,14 @@ VALUE vector_multiply_vv(VALUE self, VALUE other)
     if(B->n != 1)
         rb_raise(fm_eIndexError, "Length of vector must be equal to 1");
 
+    unsigned long long start = PROFILE_START();
     struct vector* R;
     VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, R);
 
     c_vector_init(R, A->n);
     copy_d_array(A->n, A->data, R->data);
     multiply_d_array(R->n, R->data, B->data[0]);
+    PROFILE_FINISH(PROFILE_VECTOR_MULTIPLY, start, A->n, 1, A->n, 8ULL * A->n);
 
     return result;
 }
@@ -258,10 +437,265 @@ VALUE vector_multiply(VALUE self, VALUE v)
     rb_raise(fm_eTypeError, "Invalid klass for multiply");
 }
 
+static VALUE vector_enum_size(VALUE self, VALUE args, VALUE eobj)
+{
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+    return INT2NUM(A->n);
+}
+
+// the receiver itself for in-place variants, otherwise a new vector of the same size
+static VALUE vector_result_for(VALUE self, bool in_place, struct vector** R)
+{
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+    if(in_place)
+    {
+        rb_check_frozen(self);
+        c_vector_modify(A);
+        *R = A;
+        return self;
+    }
+
+    VALUE result = TypedData_Make_Struct(cVector, struct vector, &vector_type, *R);
+    c_vector_init(*R, A->n);
+    return result;
+}
+
+static VALUE vector_hadamard_product_to(VALUE self, VALUE value, bool in_place)
+{
+	struct vector* A;
+    struct vector* B;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+	TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes vectors");
+
+    struct vector* R;
+    VALUE result = vector_result_for(self, in_place, &R);
+    hadamard_d_arrays_to_result(A->n, A->data, B->data, R->data);
+    return result;
+}
+
+VALUE vector_hadamard_product(VALUE self, VALUE value)
+{
+    return vector_hadamard_product_to(self, value, false);
+}
+
+VALUE vector_hadamard_product_self(VALUE self, VALUE value)
+{
+    return vector_hadamard_product_to(self, value, true);
+}
+
+// by a number or entrywise by a vector
+VALUE vector_divide(VALUE self, VALUE value)
+{
+    if(RB_FLOAT_TYPE_P(value) || FIXNUM_P(value)
+        || RB_TYPE_P(value, T_BIGNUM))
+    {
+        VALUE result = vector_copy(self);
+        struct vector* R;
+        TypedData_Get_Struct(result, struct vector, &vector_type, R);
+        c_vector_modify(R);
+        divide_d_array(R->n, R->data, NUM2DBL(value));
+        return result;
+    }
+    if(RBASIC_CLASS(value) != cVector)
+        rb_raise(fm_eTypeError, "Invalid klass for divide");
+
+    struct vector* A;
+    struct vector* B;
+    TypedData_Get_Struct(self, struct vector, &vector_type, A);
+    TypedData_Get_Struct(value, struct vector, &vector_type, B);
+
+    if(A->n != B->n)
+        rb_raise(fm_eIndexError, "Different sizes vectors");
+
+    struct vector* R;
+    VALUE result = vector_result_for(self, false, &R);
+    divide_d_arrays_to_result(A->n, A->data, B->data, R->data);
+    return result;
+}
+
+static VALUE vector_map_fn_to(VALUE self, VALUE name, bool in_place)
+{
+    enum d_function function = d_function_arg(name);
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    struct vector* R;
+    VALUE result = vector_result_for(self, in_place, &R);
+    apply_d_array(A->n, A->data, R->data, function);
+    return result;
+}
+
+VALUE vector_map_fn(VALUE self, VALUE name)
+{
+    return vector_map_fn_to(self, name, false);
+}
+
+VALUE vector_map_fn_self(VALUE self, VALUE name)
+{
+    return vector_map_fn_to(self, name, true);
+}
+
+static VALUE vector_pow_to(VALUE self, VALUE power, bool in_place)
+{
+    double p = raise_rb_value_to_double(power);
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    struct vector* R;
+    VALUE result = vector_result_for(self, in_place, &R);
+    pow_d_array(A->n, A->data, R->data, p);
+    return result;
+}
+
+VALUE vector_pow(VALUE self, VALUE power)
+{
+    return vector_pow_to(self, power, false);
+}
+
+VALUE vector_pow_self(VALUE self, VALUE power)
+{
+    return vector_pow_to(self, power, true);
+}
+
+static VALUE vector_clamp_to(VALUE self, VALUE min, VALUE max, bool in_place)
+{
+    double lo = raise_rb_value_to_double(min);
+    double hi = raise_rb_value_to_double(max);
+    if(lo > hi)
+        rb_raise(rb_eArgError, "min argument must be less than or equal to max argument");
+    struct vector* A;
+    TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    struct vector* R;
+    VALUE result = vector_result_for(self, in_place, &R);
+    clamp_d_array(A->n, A->data, R->data, lo, hi);
+    return result;
+}
+
+VALUE vector_clamp(VALUE self, VALUE min, VALUE max)
+{
+    return vector_clamp_to(self, min, max, false);
+}
+
+VALUE vector_clamp_self(VALUE self, VALUE min, VALUE max)
+{
+    return vector_clamp_to(self, min, max, true);
+}
+
+// the block may replace the buffer of the vector,
+// so elements are always read through the structure
+VALUE vector_each(VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, vector_enum_size);
+
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        rb_yield(DBL2NUM(A->data[i]));
+    return self;
+}
+
+VALUE vector_each_with_index(VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, vector_enum_size);
+
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+        rb_yield_values(2, DBL2NUM(A->data[i]), INT2NUM(i));
+    return self;
+}
+
+VALUE vector_each_with_index_self(VALUE self)
+{
+    rb_check_frozen(self);
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, vector_enum_size);
+
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+    {
+        VALUE v = rb_yield_values(2, DBL2NUM(A->data[i]), INT2NUM(i));
+        //  the block may clone the vector
+        c_vector_modify(A);
+        A->data[i] = raise_rb_value_to_double(v);
+    }
+    return self;
+}
+
+VALUE vector_map_self(VALUE self)
+{
+    rb_check_frozen(self);
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, vector_enum_size);
+
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    for(int i = 0; i < A->n; ++i)
+    {
+        VALUE v = rb_yield(DBL2NUM(A->data[i]));
+        c_vector_modify(A);
+        A->data[i] = raise_rb_value_to_double(v);
+    }
+    return self;
+}
+
+VALUE vector_map(VALUE self)
+{
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, vector_enum_size);
+    return vector_map_self(vector_copy(self));
+}
+
+VALUE vector_to_a(VALUE self)
+{
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    VALUE result = rb_ary_new_capa(A->n);
+    for(int i = 0; i < A->n; ++i)
+        rb_ary_push(result, DBL2NUM(A->data[i]));
+    return result;
+}
+
+VALUE vector_fill(VALUE self, VALUE value)
+{
+    rb_check_frozen(self);
+    double d = raise_rb_value_to_double(value);
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    c_vector_modify(A);
+    fill_d_array(A->n, A->data, d);
+
+    return self;
+}
+
+VALUE vector_random(VALUE self, VALUE distribution, VALUE seed)
+{
+    rb_check_frozen(self);
+    enum random_distribution d = random_distribution_arg(distribution);
+    uint64_t s = NUM2ULL(seed);
+	struct vector* A;
+	TypedData_Get_Struct(self, struct vector, &vector_type, A);
+
+    c_vector_modify(A);
+    c_random_fill(A->n, A->data, d, s);
+
+    return self;
+}
+
 void init_fm_vector()
 {
     VALUE  mod = rb_define_module("FastMatrix");
-	cVector = rb_define_class_under(mod, "Vector", rb_cData);
+	cVector = rb_define_class_under(mod, "Vector", rb_cObject);
 
 	rb_define_alloc_func(cVector, vector_alloc);
 
@@ -272,6 +706,32 @@ void init_fm_vector()
 	rb_define_method(cVector, "+", vector_add_with, 1);
 	rb_define_method(cVector, "+=", vector_add_from, 1);
 	rb_define_method(cVector, "eql?", vector_equal, 1);
+	rb_define_method(cVector, "hash", vector_hash, 0);
 	rb_define_method(cVector, "clone", vector_copy, 0);
 	rb_define_method(cVector, "*", vector_multiply, 1);
+	rb_define_method(cVector, "-", vector_sub_with, 1);
+	rb_define_method(cVector, "-=", vector_sub_from, 1);
+	rb_define_method(cVector, "dot", vector_dot, 1);
+	rb_define_method(cVector, "norm", vector_norm, 0);
+	rb_define_method(cVector, "normalize", vector_normalize, 0);
+	rb_define_method(cVector, "normalize!", vector_normalize_self, 0);
+	rb_define_method(cVector, "cross_product", vector_cross_product, 1);
+	rb_define_method(cVector, "outer", vector_outer, 1);
+	rb_define_method(cVector, "each", vector_each, 0);
+	rb_define_method(cVector, "each_with_index", vector_each_with_index, 0);
+	rb_define_method(cVector, "each_with_index!", vector_each_with_index_self, 0);
+	rb_define_method(cVector, "map", vector_map, 0);
+	rb_define_method(cVector, "map!", vector_map_self, 0);
+	rb_define_method(cVector, "to_a", vector_to_a, 0);
+	rb_define_method(cVector, "fill!", vector_fill, 1);
+    rb_define_private_method(cVector, "random_impl", vector_random, 2);
+	rb_define_method(cVector, "/", vector_divide, 1);
+	rb_define_method(cVector, "hadamard_product", vector_hadamard_product, 1);
+	rb_define_method(cVector, "hadamard_product!", vector_hadamard_product_self, 1);
+	rb_define_method(cVector, "map_fn", vector_map_fn, 1);
+	rb_define_method(cVector, "map_fn!", vector_map_fn_self, 1);
+	rb_define_method(cVector, "pow", vector_pow, 1);
+	rb_define_method(cVector, "pow!", vector_pow_self, 1);
+	rb_define_method(cVector, "clamp", vector_clamp, 2);
+	rb_define_method(cVector, "clamp!", vector_clamp_self, 2);
 }
@@ -11,9 +11,13 @@ struct vector
 {
     int n;
     double* data;
+    // owners count of data shared by clones, NULL if data is not shared
+    int* shared;
 };
 
 void c_vector_init(struct vector* vect, int n);
+// every method which changes the vector in place calls it before writing
+void c_vector_modify(struct vector* V);
 
 void init_fm_vector();
 
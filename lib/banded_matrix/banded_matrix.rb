@@ -0,0 +1,53 @@
+require 'fast_matrix/fast_matrix'
+require 'errors'
+
+module FastMatrix
+  # Square band matrix, only diagonals from -lower_bandwidth
+  # to upper_bandwidth are stored, so memory is linear in size.
+  class BandedMatrix
+    alias row_size row_count
+    alias column_size column_count
+
+    #
+    # Creates a band matrix from a hash of diagonals,
+    # where key is the offset of diagonal from the main one.
+    #   BandedMatrix.from_diagonals(3, -1 => [1, 1], 0 => 4, 1 => [2, 2])
+    #     => 4 2 0
+    #        1 4 2
+    #        0 1 4
+    #
+    def self.from_diagonals(size, diagonals)
+      lower = -[0, *diagonals.keys].min
+      upper = [0, *diagonals.keys].max
+      matrix = new(size, lower, upper)
+      diagonals.each { |offset, values| matrix.set_diagonal(offset, values) }
+      matrix
+    end
+
+    def ==(other)
+      return eql?(other) if other.is_a?(BandedMatrix)
+
+      to_matrix == other
+    end
+  end
+
+  # Band matrix with one subdiagonal and one superdiagonal. Systems with
+  # a diagonally dominant matrix are solved with the Thomas algorithm,
+  # all others with the band LU decomposition with partial pivoting
+  class TridiagonalMatrix
+    #
+    # Creates a tridiagonal matrix from its subdiagonal, diagonal and superdiagonal.
+    #   TridiagonalMatrix.from_diagonals([1, 1], [4, 4, 4], [2, 2])
+    #     => 4 2 0
+    #        1 4 2
+    #        0 1 4
+    #
+    def self.from_diagonals(lower, diagonal, upper)
+      matrix = new(diagonal.size)
+      matrix.set_diagonal(-1, lower)
+      matrix.set_diagonal(0, diagonal)
+      matrix.set_diagonal(1, upper)
+      matrix
+    end
+  end
+end
@@ -2,8 +2,9 @@ module FastMatrix
   # From C:
   #   TypeError
   #   IndexError
+  #   Error < StandardError
+  #   Future::CancelledError < Error
 
-  class Error < StandardError; end
   class NotSupportedError < NotImplementedError; end
 
 end
@@ -1,4 +1,6 @@
 require 'fast_matrix/version'
 require 'vector/vector'
 require 'matrix/matrix'
+require 'banded_matrix/banded_matrix'
+require 'future/future'
 require 'scalar'
\ No newline at end of file
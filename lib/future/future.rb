@@ -0,0 +1,44 @@
+require 'fast_matrix/fast_matrix'
+require 'errors'
+require 'io/wait'
+
+module FastMatrix
+  #
+  # Result of an operation computed on a native background thread,
+  # returned by Matrix#multiply_async, Matrix#strassen_async
+  # and Matrix#determinant_async.
+  #
+  # Waiting goes through a descriptor which becomes readable when
+  # the future is resolved, so a future can be passed to IO.select
+  # and waiting does not block other threads and fibers.
+  #   future = a.multiply_async(b)
+  #   IO.select([future, socket])
+  #   future.value if future.ready?
+  #
+  class Future
+    #
+    # IO readable after the future is resolved.
+    # The descriptor belongs to the future and is closed with it.
+    #
+    def to_io
+      @io ||= IO.for_fd(fileno, autoclose: false)
+    end
+
+    #
+    # Waits at most timeout seconds (forever if nil), returns ready?
+    #
+    def wait(timeout = nil)
+      to_io.wait_readable(timeout) unless ready?
+      ready?
+    end
+
+    #
+    # Waits for the result, raises Future::CancelledError
+    # if the future was cancelled before it started.
+    #
+    def value
+      wait
+      value_impl
+    end
+  end
+end
@@ -10,7 +10,8 @@ module FastMatrix
     # Creates a matrix of size +row_count+ x +column_count+.
     # It fills the values by calling the given block,
     # passing the current row and column.
-    # Returns random matrix if no block is given.
+    # Returns an Enumerator if no block is given, as in the standard matrix;
+    # random matrices are made by Matrix.random.
     #
     #   m = Matrix.build(2, 4) {|row, col| col - row }
     #     => Matrix[[0, 1, 2, 3], [-1, 0, 1, 2]]
@@ -18,12 +19,22 @@ module FastMatrix
     #     => a 3x3 matrix with random elements
     #
     def self.build(row_count, column_count = row_count, &block)
-      matrix = create_with_check(row_count, column_count)
-      raise NotImplementedError, 'Issue#17' unless block_given?
+      check_dimensions(row_count, column_count)
+      return to_enum(:build, row_count, column_count) unless block_given?
 
+      matrix = new(row_count, column_count)
       matrix.each_with_index! { |_, i, j| block.call(i, j) }
     end
 
+    #
+    # Creates a matrix of size +row_count+ x +column_count+ with random
+    # elements, uniform in [0, 1) or standard normal, see Matrix#random!
+    #   Matrix.random(2, 3, distribution: :normal, seed: 42)
+    #
+    def self.random(row_count, column_count = row_count, distribution: :uniform, seed: nil)
+      create_with_check(row_count, column_count).random!(distribution: distribution, seed: seed)
+    end
+
     #
     # Creates a matrix where +rows+ is an array of arrays, each of which is a row
     # of the matrix.
@@ -92,7 +103,8 @@ module FastMatrix
     #         0  0 -3
     #
     def self.diagonal(*values)
-      build(values.size, values.size) { |i, j| i == j ? values[i] : 0 }
+      check_dimensions(values.size, values.size)
+      diagonal_impl(values)
     end
 
     #
@@ -103,7 +115,8 @@ module FastMatrix
     #        0 5
     #
     def self.scalar(n, value)
-      build(n, n) { |i, j| i == j ? value : 0 }
+      check_dimensions(n, n)
+      scalar_impl(n, value)
     end
 
     #
@@ -148,76 +161,35 @@ module FastMatrix
     end
 
     #
-    # Create a matrix by stacking matrices vertically
+    # Block assembly is implemented in C and copies whole rows:
     #
+    # Matrix.vstack(x, *matrices) stacks matrices vertically,
+    # Matrix.hstack(x, *matrices) stacks matrices horizontally
     #   x = Matrix[[1, 2], [3, 4]]
     #   y = Matrix[[5, 6], [7, 8]]
     #   Matrix.vstack(x, y) # => Matrix[[1, 2], [3, 4], [5, 6], [7, 8]]
-    # TODO: optimize (maybe in C)
-    def self.vstack(x, *matrices)
-      column_count = x.column_count
-      row_count = x.row_count
-      matrices.each do |matrix|
-        raise IndexError unless matrix.column_count == column_count
-
-        row_count += matrix.row_count
-      end
-      result = new(row_count, column_count)
-      m_i = 0
-      [x, *matrices].each do |matrix|
-        matrix.each_with_index do |elem, i, j|
-          result[m_i + i, j] = elem
-        end
-        m_i += matrix.row_count
-      end
-      result
-    end
-
-    #
-    # Create a matrix by stacking matrices horizontally
-    #
-    #   x = Matrix[[1, 2], [3, 4]]
-    #   y = Matrix[[5, 6], [7, 8]]
     #   Matrix.hstack(x, y) # => Matrix[[1, 2, 5, 6], [3, 4, 7, 8]]
     #
-    def self.hstack(x, *matrices)
-      column_count = x.column_count
-      row_count = x.row_count
-      matrices.each do |matrix|
-        raise IndexError unless matrix.row_count == row_count
-
-        column_count += matrix.column_count
-      end
-      result = new(row_count, column_count)
-      m_j = 0
-      [x, *matrices].each do |matrix|
-        matrix.each_with_index do |elem, i, j|
-          result[i, m_j + j] = elem
-        end
-        m_j += matrix.column_count
-      end
-      result
-    end
-
-    #
-    # Create a matrix by combining matrices entrywise, using the given block
+    # Matrix.block_matrix(blocks) joins an array of block rows, blocks of
+    # a block row must have equal rows count, blocks of a block column equal
+    # columns count
+    #   Matrix.block_matrix([[x, y], [y, x]])
+    #     => 1 2 5 6
+    #        3 4 7 8
+    #        5 6 1 2
+    #        7 8 3 4
+    #
+    # Matrix.block_diagonal(*matrices) puts matrices on the diagonal
+    #   Matrix.block_diagonal(Matrix[[1, 2]], Matrix[[3], [4]])
+    #     => 1 2 0
+    #        0 0 3
+    #        0 0 4
+    #
+    # Matrix#kronecker(other) is the Kronecker product
+    #   Matrix[[1, 2]].kronecker(Matrix[[1], [10]])
+    #     =>  1  2
+    #        10 20
     #
-    #   x = Matrix[[6, 6], [4, 4]]
-    #   y = Matrix[[1, 2], [3, 4]]
-    #   Matrix.combine(x, y) {|a, b| a - b} # => Matrix[[5, 4], [1, 0]]
-    # TODO: optimize in C
-    def self.combine(*matrices)
-      return empty if matrices.empty?
-
-      result = convert(matrices.first)
-      matrices[1..matrices.size].each do |m|
-        raise IndexError unless result.row_count == m.row_count &&
-                                result.column_count == m.column_count
-
-        result.each_with_index! { |elem, i, j| yield elem, m[i, j] }
-      end
-      result
-    end
 
     class << Matrix
       private
@@ -0,0 +1,80 @@
+require 'fast_matrix/fast_matrix'
+require 'errors'
+
+module FastMatrix
+  #
+  # Reading and writing of NumPy .npy files and CSV
+  #
+  class Matrix
+    private_constant :CSVParser
+
+    # bytes read from IO at once by read_csv
+    CSV_READ_SIZE = 1 << 16
+    # rows formatted at once by write_csv
+    CSV_WRITE_ROWS = 1024
+    private_constant :CSV_READ_SIZE, :CSV_WRITE_ROWS
+
+    #
+    # Saves the matrix as NumPy .npy file (C order),
+    # +dtype+ is :float64 or :float32.
+    # Matrix.load_npy(path) reads float64 or float32 files
+    # in any byte and memory order.
+    #
+    def save_npy(path, dtype: :float64)
+      save_npy_impl(path, dtype)
+    end
+
+    #
+    # Reads a matrix of numbers from CSV, +source+ is a path or IO.
+    # Empty fields are NaN, all lines must have the same number of fields.
+    # With +chunk_rows+ yields matrices of that many rows (the last one
+    # may be smaller) while reading, so the whole file is never in memory;
+    # returns an enumerator if no block is given.
+    #   Matrix.read_csv('data.csv')
+    #   Matrix.read_csv(io, chunk_rows: 1000) { |chunk| ... }
+    #
+    def self.read_csv(source, chunk_rows: nil, col_sep: ',', headers: false, &block)
+      if chunk_rows
+        raise ArgumentError, 'chunk_rows must be positive' unless chunk_rows.positive?
+        return enum_for(:read_csv, source, chunk_rows: chunk_rows, col_sep: col_sep, headers: headers) unless block
+
+        parse_csv(source, chunk_rows, col_sep, headers, &block)
+        return nil
+      end
+
+      result = nil
+      parse_csv(source, nil, col_sep, headers) { |matrix| result = matrix }
+      result || empty
+    end
+
+    #
+    # Writes the matrix as CSV to +target+, a path or IO.
+    # Numbers read back exactly, with 15 significant digits when that is enough.
+    #
+    def write_csv(target, col_sep: ',')
+      return File.open(target, 'w') { |file| write_csv(file, col_sep: col_sep) } unless target.respond_to?(:write)
+
+      (0...row_count).step(CSV_WRITE_ROWS) do |first|
+        target.write(csv_rows(first, [CSV_WRITE_ROWS, row_count - first].min, col_sep))
+      end
+      target
+    end
+
+    class << Matrix
+      private
+
+      def parse_csv(source, chunk_rows, col_sep, headers)
+        return File.open(source, 'rb') { |file| parse_csv(file, chunk_rows, col_sep, headers) { |m| yield m } } unless source.respond_to?(:read)
+
+        parser = CSVParser.new(col_sep, headers)
+        buffer = String.new
+        while source.read(CSV_READ_SIZE, buffer)
+          parser.feed(buffer)
+          yield parser.take(chunk_rows) while chunk_rows && parser.rows >= chunk_rows
+        end
+        parser.finish
+        yield parser.take(parser.rows) if parser.rows.positive?
+      end
+    end
+  end
+end
@@ -1,8 +1,10 @@
 require 'matrix/constructors'
+require 'matrix/io'
 
 module FastMatrix
   # Matrix with fast implementations of + - * determinate in C
   class Matrix
+    include Enumerable
 
     # Aliases just for compatibility with standard matrix
     #
@@ -15,14 +17,69 @@ module FastMatrix
     alias column_size column_count
     #
     # Returns element (+i+,+j+) of the matrix.  That is: row +i+, column +j+.
+    # With ranges returns a submatrix:
+    #   Matrix[[1, 2, 3], [4, 5, 6]][0..1, 1..2] # => Matrix[[2, 3], [5, 6]]
     #
     alias element []
     alias component []
+    #
+    # Returns the trace (sum of diagonal elements) of the matrix.
+    #
+    alias tr trace
+    #
+    # Returns the Frobenius norm of the matrix.
+    #
+    alias frobenius frobenius_norm
+    alias collect map
+    alias collect! map!
+    #
+    # Returns the inverse of the matrix, raises FastMatrix::Error if it is singular.
+    #   Matrix[[-1, -1], [0, -1]].inverse
+    #     => -1  1
+    #         0 -1
+    #
+    alias inv inverse
+    #
+    # Returns the entrywise product of this matrix with the other.
+    #   Matrix[[1, 2], [3, 4]].hadamard_product(Matrix[[1, 2], [3, 2]])
+    #     => 1 4
+    #        9 8
+    #
+    alias hadamard hadamard_product
+    alias entrywise_product hadamard_product
+    alias hadamard! hadamard_product!
+
+    #
+    # Elementwise math in C: exp, log, sqrt, tanh, sin, cos
+    # and in-place variants with !, see also map_fn
+    #   Matrix[[1, 4], [9, 16]].sqrt # => Matrix[[1, 2], [3, 4]]
+    #
+    %i[exp log sqrt tanh sin cos].each do |name|
+      define_method(name) { map_fn(name) }
+      define_method("#{name}!") { map_fn!(name) }
+    end
 
     def to_s
       convert.to_s
     end
 
+    #
+    # Returns a section of the matrix, as in standard matrix:
+    #   minor(start_row, nrows, start_col, ncols)
+    #   minor(row_range, col_range)
+    #
+    def minor(*param)
+      case param.size
+      when 2
+        self[param[0], param[1]]
+      when 4
+        start_row, row_count, start_column, column_count = param
+        self[start_row...start_row + row_count, start_column...start_column + column_count]
+      else
+        raise ArgumentError, 'wrong number of arguments'
+      end
+    end
+
     def inspect
       convert.inspect
     end
@@ -40,28 +97,132 @@ module FastMatrix
       fast_matrix
     end
 
-    def each_with_index
-      (0...row_count).each do |i|
-        (0...column_count).each do |j|
-          yield self[i, j], i, j
-        end
-      end
+    #
+    # Creates a matrix by combining this matrix with others entrywise,
+    # using the given block, see Matrix.combine
+    #
+    def combine(*matrices, &block)
+      Matrix.combine(self, *matrices, &block)
     end
 
-    def each_with_index!
-      (0...row_count).each do |i|
-        (0...column_count).each do |j|
-          self[i, j] = yield self[i, j], i, j
-        end
-      end
-      self
+    #
+    # Returns the +k+ eigenvalues of largest magnitude of a symmetric matrix
+    # and corresponding eigenvectors, found by block power iteration.
+    # Values are a Vector in descending order of magnitude,
+    # vectors are a Matrix with eigenvectors as columns.
+    #   values, vectors = Matrix[[2, 1], [1, 2]].top_eigen(1)
+    #     => [Vector[3.0], Matrix[[0.707...], [0.707...]]]
+    #
+    def top_eigen(k, tol: 1e-10, max_iterations: 1000)
+      top_eigen_impl(k, tol, max_iterations)
+    end
+
+    #
+    # Solves self * x = b for a Vector +b+, or for every column of a Matrix +b+.
+    # With precision: :mixed the matrix is factored in single precision and
+    # the solution is refined with double precision residuals until it is
+    # as accurate as a double solve; ill-conditioned matrices fall back
+    # to the double factorization, which is cached until the matrix changes.
+    #   Matrix[[2, 1], [1, 3]].solve(Vector[3, 5]) # => Vector[0.8, 1.4]
+    #
+    def solve(b, precision: :double)
+      solve_impl(b, precision)
+    end
+
+    #
+    # Two-dimensional convolution with +kernel+ (a Matrix).
+    # +mode+ selects the result size: :full (every overlap),
+    # :same (the size of self, the kernel centered) or :valid
+    # (only windows inside self). Outside of self elements are zeros
+    # with boundary: :zero, or self mirrored at its edges with :reflect.
+    #   Matrix[[1, 2], [3, 4]].convolve(Matrix[[1, 1]], mode: :full)
+    #     => 1 3 2
+    #        3 7 4
+    #
+    def convolve(kernel, mode: :same, boundary: :zero)
+      convolve_impl(kernel, mode, boundary, true)
+    end
+
+    #
+    # Two-dimensional cross-correlation, the same as convolve
+    # with the kernel rotated by 180 degrees.
+    #
+    def correlate(kernel, mode: :same, boundary: :zero)
+      convolve_impl(kernel, mode, boundary, false)
+    end
+
+    #
+    # Symmetric rank-k update: returns self * self.transpose, or
+    # self.transpose * self if +trans+ is true.
+    # Only one triangle is computed, the other is mirrored.
+    #   Matrix[[1, 2], [3, 4], [5, 6]].syrk
+    #     => Matrix[[5, 11, 17], [11, 25, 39], [17, 39, 61]]
+    #
+    def syrk(trans: false)
+      syrk_impl(trans)
+    end
+
+    #
+    # Fills the matrix with random elements, uniform in [0, 1)
+    # or standard normal. The same +seed+ gives the same matrix
+    # regardless of the number of threads; without it a new seed is taken.
+    #
+    def random!(distribution: :uniform, seed: nil)
+      seed = Random.new_seed if seed.nil?
+      random_impl(distribution, seed & 0xFFFF_FFFF_FFFF_FFFF)
+    end
+
+    #
+    # Applies +op+ (:+, :-, :* or :/) with +vector+ to every row
+    # (+axis+ is :rows, vector size is column_count) or to every
+    # column (+axis+ is :columns, vector size is row_count).
+    #   Matrix[[1, 2], [3, 4]].broadcast(:+, Vector[10, 20])
+    #     => 11 22
+    #        13 24
+    #
+    def broadcast(op, vector, axis: :rows)
+      broadcast_impl(op, vector, axis, false)
+    end
+
+    def broadcast!(op, vector, axis: :rows)
+      broadcast_impl(op, vector, axis, true)
+    end
+
+    #
+    # Gram matrix of columns, the same as self.transpose * self.
+    #
+    def gram
+      syrk(trans: true)
+    end
+
+    #
+    # Sum, minimum and maximum of all elements, computed in C.
+    # With arguments or a block they are the Enumerable ones:
+    #   Matrix[[1, 5], [3, 4]].max(2) # => [5, 4]
+    #
+    def sum(*args, &block)
+      return super if !args.empty? || block
+
+      sum_impl
+    end
+
+    def min(*args, &block)
+      return super if !args.empty? || block
+
+      min_impl
+    end
+
+    def max(*args, &block)
+      return super if !args.empty? || block
+
+      max_impl
     end
 
     #
     # Convert to standard ruby matrix.
     #
     def convert
-      ::Matrix.build(row_size, column_size) { |i, j| self[i, j] }
+      ::Matrix.rows(to_a, false)
     end
 
     # FIXME: for compare with standard matrix
@@ -40,9 +40,16 @@ module FastMatrix
     #    Vector.zero(3) => Vector[0, 0, 0]
     #
     def self.zero(size)
-      result = new(size)
-      result.each_with_index! { 0 }
-      result
+      new(size).fill!(0)
+    end
+
+    #
+    # Return a vector with random elements, see Vector#random!
+    #
+    #    Vector.random(3, seed: 42) => Vector[0.78..., 0.09..., 0.53...]
+    #
+    def self.random(size, distribution: :uniform, seed: nil)
+      new(size).random!(distribution: distribution, seed: seed)
     end
 
     class << Vector
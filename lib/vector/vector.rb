@@ -2,6 +2,41 @@ require 'vector/constructors'
 
 module FastMatrix
   class Vector
+    include Enumerable
+
+    alias collect map
+    alias collect! map!
+
+    #
+    # Returns the inner product of this vector with the other.
+    #   Vector[4,7].inner_product Vector[10,1] # => 47.0
+    #
+    alias inner_product dot
+    #
+    # Returns the modulus (Pythagorean distance) of the vector.
+    #   Vector[5,8,2].norm # => 9.643650761
+    #
+    alias magnitude norm
+    alias r norm
+    #
+    # Returns the cross product of this vector with the other,
+    # both vectors must be 3-dimensional.
+    #   Vector[1, 0, 0].cross Vector[0, 1, 0] # => Vector[0.0, 0.0, 1.0]
+    #
+    alias cross cross_product
+    #
+    # Returns the entrywise product of this vector with the other.
+    #
+    alias hadamard hadamard_product
+    alias hadamard! hadamard_product!
+
+    #
+    # Elementwise math in C, see Matrix#exp and others
+    #
+    %i[exp log sqrt tanh sin cos].each do |name|
+      define_method(name) { map_fn(name) }
+      define_method("#{name}!") { map_fn!(name) }
+    end
 
     #
     # Create fast vector from standard vector
@@ -17,21 +52,22 @@ module FastMatrix
       ::Vector.elements(self)
     end
 
-    def to_ary
-      Array.new(size) { |i| self[i] }
-    end
+    alias to_ary to_a
 
-    def each_with_index
-      (0...size).each do |i|
-        yield self[i], i
-      end
+    #
+    # Saves the vector as 1 dimensional NumPy .npy file,
+    # +dtype+ is :float64 or :float32, see Matrix#save_npy
+    #
+    def save_npy(path, dtype: :float64)
+      save_npy_impl(path, dtype)
     end
 
-    def each_with_index!
-      (0...size).each do |i|
-        self[i] = yield self[i], i
-      end
-      self
+    #
+    # Fills the vector with random elements, see Matrix#random!
+    #
+    def random!(distribution: :uniform, seed: nil)
+      seed = Random.new_seed if seed.nil?
+      random_impl(distribution, seed & 0xFFFF_FFFF_FFFF_FFFF)
     end
 
     # FIXME: for compare with standard vector
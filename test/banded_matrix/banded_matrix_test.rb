@@ -0,0 +1,79 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastBandedMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class BandedMatrixTest < Minitest::Test
+    include FastMatrix
+
+    def banded
+      BandedMatrix.from_diagonals(5, -2 => 1, -1 => [2, -1, 3, 1], 0 => [6, 7, 8, 9, 10], 1 => 2)
+    end
+
+    def test_init
+      m = BandedMatrix.new(4, 1, 2)
+      assert_equal 4, m.row_count
+      assert_equal 1, m.lower_bandwidth
+      assert_equal 2, m.upper_bandwidth
+      assert_equal 0, m[3, 0]
+    end
+
+    def test_index
+      m = BandedMatrix.new(4, 1, 1)
+      m[2, 3] = 5
+      assert_equal 5, m[2, 3]
+      assert_equal 0, m[0, 3]
+      assert_nil m[4, 0]
+      assert_raises(IndexError) { m[0, 3] = 1 }
+    end
+
+    def test_diagonal
+      assert_equal Vector[2, -1, 3, 1], banded.diagonal(-1)
+    end
+
+    def test_to_matrix
+      expected = Matrix[[6, 2, 0, 0, 0],
+                        [2, 7, 2, 0, 0],
+                        [1, -1, 8, 2, 0],
+                        [0, 1, 3, 9, 2],
+                        [0, 0, 1, 1, 10]]
+      assert_equal expected, banded.to_matrix
+    end
+
+    def test_multiply_mv
+      v = Vector[1, 2, 3, 4, 5]
+      assert_equal banded.to_matrix * v, banded * v
+    end
+
+    def test_solve
+      b = Vector[1, -2, 3, 0, 5]
+      x = banded.solve(b)
+      (banded * x).to_ary.zip(b.to_ary).each { |y, e| assert_in_delta e, y, 1e-12 }
+    end
+
+    def test_solve_with_pivoting
+      m = BandedMatrix.from_diagonals(3, -1 => [1, 1], 0 => [0, 0, 1], 1 => [1, 1])
+      x = m.solve(Vector[1, 2, 3])
+      (m * x).to_ary.zip([1, 2, 3]).each { |y, e| assert_in_delta e, y, 1e-12 }
+    end
+
+    def test_tridiagonal_solve_with_tiny_pivot
+      m = TridiagonalMatrix.from_diagonals([1, 1], [1e-17, 1, 1], [1, 1])
+      x = m.solve(Vector[1, 2, 3])
+      [-1, 1, 2].each_with_index { |e, i| assert_in_delta e, x[i], 1e-12 }
+    end
+
+    def test_solve_singular
+      assert_raises(Error) { BandedMatrix.new(3, 1, 0).solve(Vector[1, 2, 3]) }
+    end
+
+    def test_tridiagonal_solve
+      n = 100_000
+      m = TridiagonalMatrix.from_diagonals([-1] * (n - 1), [2.5] * n, [-1] * (n - 1))
+      b = m * Vector.elements(Array.new(n) { |i| i % 7 })
+      x = m.solve(b)
+      assert_in_delta 3, x[n - 2], 1e-9
+      assert_in_delta 5, x[12], 1e-9
+    end
+  end
+end
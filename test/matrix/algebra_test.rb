@@ -84,6 +84,44 @@ module FastMatrixTest
       assert_equal -84, m.determinant
     end
     
+    def test_syrk
+      m = Matrix[[1, 2], [3, 4], [5, 6]]
+      assert_equal m * m.transpose, m.syrk
+    end
+
+    def test_syrk_trans
+      m = Matrix[[1, 2], [3, 4], [5, 6]]
+      assert_equal m.transpose * m, m.syrk(trans: true)
+    end
+
+    def test_syrk_too_large
+      assert_raises(IndexError) { Matrix.new(50_000, 1).syrk }
+      assert_raises(IndexError) { Matrix.new(1, 50_000).gram }
+    end
+
+    def test_gram_large
+      m = Matrix.build(300, 170) { |i, j| (i * 7 + j * 3) % 11 - 5 }
+      assert_equal m.transpose * m, m.gram
+      assert_equal m * m.transpose, m.syrk
+    end
+
+    def test_large_elementwise
+      m1 = Matrix.fill(3, 600, 500)
+      m2 = Matrix.fill(-1, 600, 500)
+      assert_equal Matrix.fill(2, 600, 500), m1 + m2
+      assert_equal Matrix.fill(4, 600, 500), m1 - m2
+      assert_equal Matrix.fill(1, 600, 500), m2.abs
+      assert m1 >= m2
+    end
+
+    def test_large_eql_differs_in_last
+      m1 = Matrix.fill(1, 600, 500)
+      m2 = m1.clone
+      m2[-1, -1] = 2
+      refute m1.eql?(m2)
+      refute m1 >= m2
+    end
+
     def test_eql_equal
       m = FastMatrix::Matrix[[1, 2, 5], [3, 4, 1]]
       n = FastMatrix::Matrix[[1, 2, 5], [3, 4, 1]]
@@ -95,5 +133,114 @@ module FastMatrixTest
       n = FastMatrix::Matrix[[1, 2, 5], [3, 3, 1]]
       refute m.eql?(n)
     end
+
+    def test_inverse
+      m = Matrix[[-1, -1], [0, -1]]
+      assert_equal Matrix[[-1, 1], [0, -1]], m.inverse
+      a = Matrix[[0, 2, 1], [1, 1, 0], [3, 0, 1]]
+      assert_in_delta 0, (a * a.inv - Matrix.identity(3)).abs.max, 1e-12
+    end
+
+    def test_inverse_singular
+      assert_raises(FastMatrix::Error) { Matrix[[1, 2], [2, 4]].inverse }
+      assert_raises(IndexError) { Matrix[[1, 2]].inverse }
+    end
+
+    def test_solve_vector
+      m = Matrix[[2, 1], [1, 3]]
+      x = m.solve(Vector[3, 5])
+      assert_in_delta 0.8, x[0], 1e-12
+      assert_in_delta 1.4, x[1], 1e-12
+    end
+
+    def test_solve_matrix
+      a = Matrix[[0, 2, 1], [1, 1, 0], [3, 0, 1]]
+      b = Matrix[[1, 2], [3, 4], [5, 6]]
+      assert_in_delta 0, (a * a.solve(b) - b).abs.max, 1e-12
+    end
+
+    def test_solve_mixed_is_double_accurate
+      a = Matrix.new(60, 60).random!(seed: 3) + Matrix.scalar(60, 60)
+      b = Vector.new(60).fill!(1)
+      exact = a.solve(b)
+      mixed = a.solve(b, precision: :mixed)
+      60.times { |i| assert_in_delta exact[i], mixed[i], 1e-13 }
+
+      columns = Matrix.new(60, 3).random!(seed: 4)
+      assert_in_delta 0, (a * a.solve(columns, precision: :mixed) - columns).abs.max, 1e-12
+    end
+
+    def test_solve_mixed_falls_back_for_ill_conditioned
+      hilbert = Matrix.build(9, 9) { |i, j| 1.0 / (i + j + 1) }
+      b = hilbert * Vector.new(9).fill!(1)
+      x = hilbert.solve(b, precision: :mixed)
+      9.times { |i| assert_in_delta 1, x[i], 1e-3 }
+      assert_equal hilbert.solve(b), x
+    end
+
+    def test_solve_errors
+      assert_raises(FastMatrix::Error) { Matrix[[1, 2], [2, 4]].solve(Vector[1, 2], precision: :mixed) }
+      assert_raises(IndexError) { Matrix[[1, 2]].solve(Vector[1]) }
+      assert_raises(IndexError) { Matrix[[1, 2], [3, 4]].solve(Vector[1, 2, 3]) }
+      assert_raises(ArgumentError) { Matrix[[1]].solve(Vector[1], precision: :half) }
+      assert_raises(TypeError) { Matrix[[1]].solve([1]) }
+    end
+
+    def test_power
+      m = Matrix[[1, 1], [1, 0]]
+      assert_equal Matrix[[89, 55], [55, 34]], m**10
+      assert_equal m, m**1
+      assert_equal Matrix.identity(2), m**0
+      assert_equal m * m * m, m**3
+    end
+
+    def test_power_negative
+      m = Matrix[[2, 0], [0, 4]]
+      assert_equal Matrix[[0.125, 0], [0, 0.015625]], m**-3
+      assert_raises(FastMatrix::Error) { Matrix[[1, 1], [1, 1]]**-1 }
+    end
+
+    def test_power_incorrect
+      assert_raises(IndexError) { Matrix[[1, 2]]**2 }
+      assert_raises(TypeError) { Matrix[[1]]**0.5 }
+    end
+
+    def test_chain_multiply
+      a = Matrix.build(10, 30) { |i, j| i + j }
+      b = Matrix.build(30, 5) { |i, j| i - j }
+      c = Matrix.build(5, 60) { |i, j| i * j % 7 }
+      d = Matrix.build(60, 2) { |i, j| (i + 2 * j) % 5 }
+      assert_equal a * b * c * d, Matrix.chain_multiply(a, b, c, d)
+      assert_equal a * (b * (c * d)), Matrix.chain_multiply(a, b, c, d)
+      assert_equal b * c, Matrix.chain_multiply(b, c)
+      assert_equal a, Matrix.chain_multiply(a)
+    end
+
+    def test_chain_multiply_incorrect
+      a = Matrix[[1, 2]]
+      assert_raises(IndexError) { Matrix.chain_multiply(a, a) }
+      assert_raises(ArgumentError) { Matrix.chain_multiply }
+    end
+
+    def test_kronecker
+      a = Matrix[[1, 2], [3, 4]]
+      b = Matrix[[0, 5], [6, 7]]
+      expected = Matrix[[0, 5, 0, 10],
+                        [6, 7, 12, 14],
+                        [0, 15, 0, 20],
+                        [18, 21, 24, 28]]
+      assert_equal expected, a.kronecker(b)
+      assert_equal Matrix[[1, 2], [10, 20]], Matrix[[1, 2]].kronecker(Matrix[[1], [10]])
+    end
+
+    def test_kronecker_large
+      a = Matrix.random(20, 30, seed: 1)
+      b = Matrix.random(25, 15, seed: 2)
+      k = a.kronecker(b)
+      assert_equal 500, k.row_count
+      assert_equal 450, k.column_count
+      assert_equal a[7, 11] * b[3, 4], k[7 * 25 + 3, 11 * 15 + 4]
+      assert_equal a[19, 29] * b[24, 14], k[499, 449]
+    end
   end
 end
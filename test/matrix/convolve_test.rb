@@ -0,0 +1,61 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class ConvolveTest < Minitest::Test
+    include FastMatrix
+
+    def test_convolve_full
+      m = Matrix[[1, 2], [3, 4]]
+      assert_equal Matrix[[1, 3, 2], [3, 7, 4]], m.convolve(Matrix[[1, 1]], mode: :full)
+      assert_equal Matrix[[2, 5, 2], [6, 11, 4]], m.convolve(Matrix[[2, 1]], mode: :full)
+      assert_equal Matrix[[1, 4, 4], [3, 10, 8]], m.correlate(Matrix[[2, 1]], mode: :full)
+    end
+
+    def test_convolve_same_and_valid
+      m = Matrix[[1, 2, 3], [4, 5, 6], [7, 8, 9]]
+      box = Matrix.new(3, 3).fill!(1)
+      assert_equal Matrix[[12, 21, 16], [27, 45, 33], [24, 39, 28]], m.convolve(box)
+      assert_equal Matrix[[45]], m.convolve(box, mode: :valid)
+      gradient = Matrix[[-1, 0, 1]]
+      assert_equal Matrix[[2], [2], [2]], m.correlate(gradient, mode: :valid)
+      assert_equal Matrix[[-2], [-2], [-2]], m.convolve(gradient, mode: :valid)
+    end
+
+    def test_convolve_reflect
+      m = Matrix[[1, 2, 3], [4, 5, 6], [7, 8, 9]]
+      box = Matrix.new(3, 3).fill!(1)
+      assert_equal Matrix[[21, 27, 33], [39, 45, 51], [57, 63, 69]],
+                   m.convolve(box, boundary: :reflect)
+      assert_equal Matrix[[1, 2, 3, 3, 2]],
+                   Matrix[[1, 2, 3]].convolve(Matrix[[1, 0, 0]], mode: :full, boundary: :reflect)
+    end
+
+    def test_convolve_large_kernel
+      m = Matrix.new(40, 50).random!(seed: 1)
+      k = Matrix.new(9, 11).random!(seed: 2)
+      r = m.correlate(k, mode: :valid)
+      assert_equal [32, 40], [r.row_count, r.column_count]
+      expected = 0.0
+      9.times { |u| 11.times { |v| expected += k[u, v] * m[5 + u, 7 + v] } }
+      assert_in_delta expected, r[5, 7], 1e-12
+
+      flipped = Matrix.build(9, 11) { |u, v| k[8 - u, 10 - v] }
+      difference = m.convolve(k, boundary: :reflect) - m.correlate(flipped, boundary: :reflect)
+      assert_in_delta 0, difference.abs.max, 1e-12
+    end
+
+    def test_convolve_errors
+      m = Matrix[[1, 2], [3, 4]]
+      assert_raises(IndexError) { m.convolve(Matrix[[1, 2, 3]], mode: :valid) }
+      assert_raises(ArgumentError) { m.convolve(Matrix[[1]], mode: :wrap) }
+      assert_raises(ArgumentError) { m.convolve(Matrix[[1]], boundary: :wrap) }
+      assert_raises(::TypeError) { m.convolve([[1]]) }
+    end
+
+    def test_convolve_full_too_large
+      assert_raises(IndexError) { Matrix.new(1, 50_000).convolve(Matrix.new(50_000, 1), mode: :full) }
+    end
+  end
+end
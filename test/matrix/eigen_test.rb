@@ -0,0 +1,102 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class EigenTest < Minitest::Test
+    include FastMatrix
+
+    def symmetric(n)
+      a = Matrix.build(n) { |i, j| Math.sin(i + 2 * j) }
+      a + a.transpose
+    end
+
+    # Q diag(values) Q^T with the Householder reflection Q = I - 2 u u^T / u^T u,
+    # full rank with the eigenvalues given
+    def with_eigenvalues(values)
+      n = values.size
+      u = Array.new(n) { |i| i + 1.0 }
+      norm = u.sum { |x| x * x }
+      q = Matrix.build(n) { |i, j| (i == j ? 1 : 0) - 2 * u[i] * u[j] / norm }
+      q * Matrix.diagonal(*values) * q.transpose
+    end
+
+    def assert_orthonormal(vectors)
+      product = vectors.transpose * vectors
+      product.each_with_index do |elem, i, j|
+        assert_in_delta i == j ? 1 : 0, elem, 1e-10
+      end
+    end
+
+    def assert_eigenpair(m, value, vectors, column)
+      v = Vector.elements(Array.new(m.row_count) { |i| vectors[i, column] })
+      (m * v).to_ary.zip((v * value).to_ary).each do |x, y|
+        assert_in_delta y, x, 1e-8
+      end
+    end
+
+    def test_symmetric_eigen_2x2
+      values, vectors = Matrix[[2, 1], [1, 2]].symmetric_eigen
+      assert_in_delta 1, values[0], 1e-12
+      assert_in_delta 3, values[1], 1e-12
+      assert_in_delta 0.5, vectors[0, 1]**2, 1e-12
+    end
+
+    def test_symmetric_eigen_pairs
+      m = symmetric(7)
+      values, vectors = m.symmetric_eigen
+      assert_equal 7, values.size
+      7.times { |k| assert_eigenpair(m, values[k], vectors, k) }
+      6.times { |k| assert values[k] <= values[k + 1] }
+    end
+
+    def test_symmetric_eigen_orthogonal
+      _, vectors = symmetric(6).symmetric_eigen
+      product = vectors.transpose * vectors
+      product.each_with_index do |elem, i, j|
+        assert_in_delta i == j ? 1 : 0, elem, 1e-12
+      end
+    end
+
+    def test_symmetric_eigen_full_rank
+      expected = Array.new(12) { |k| 2.0**k }
+      m = with_eigenvalues(expected.reverse)
+      values, vectors = m.symmetric_eigen
+      12.times do |k|
+        assert_in_delta expected[k], values[k], 1e-9
+        assert_eigenpair(m, values[k], vectors, k)
+      end
+      assert_orthonormal(vectors)
+    end
+
+    def test_symmetric_eigen_not_square
+      assert_raises(IndexError) { Matrix.new(2, 3).symmetric_eigen }
+    end
+
+    def test_top_eigen
+      m = symmetric(30)
+      all, = m.symmetric_eigen
+      expected = all.to_ary.sort_by { |x| -x.abs }.first(3)
+      values, vectors = m.top_eigen(3)
+      assert_equal 3, vectors.column_count
+      3.times do |k|
+        assert_in_delta expected[k], values[k], 1e-8
+        assert_eigenpair(m, values[k], vectors, k)
+      end
+    end
+
+    def test_top_eigen_full_rank
+      m = with_eigenvalues(Array.new(12) { |k| -(2.0**k) })
+      values, vectors = m.top_eigen(3)
+      3.times do |k|
+        assert_in_delta(-(2.0**(11 - k)), values[k], 1e-8)
+        assert_eigenpair(m, values[k], vectors, k)
+      end
+      assert_orthonormal(vectors)
+    end
+
+    def test_top_eigen_wrong_count
+      assert_raises(IndexError) { symmetric(3).top_eigen(4) }
+    end
+  end
+end
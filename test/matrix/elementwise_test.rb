@@ -0,0 +1,102 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class ElementwiseTest < Minitest::Test
+    include FastMatrix
+
+    def test_hadamard_product
+      m1 = Matrix[[1, 2], [3, 4]]
+      m2 = Matrix[[1, 2], [3, 2]]
+      assert_equal Matrix[[1, 4], [9, 8]], m1.hadamard_product(m2)
+      assert_equal Matrix[[1, 4], [9, 8]], m1.entrywise_product(m2)
+      assert_same m1, m1.hadamard!(m2)
+      assert_equal Matrix[[1, 4], [9, 8]], m1
+    end
+
+    def test_hadamard_product_different_sizes
+      assert_raises(IndexError) { Matrix[[1, 2]].hadamard(Matrix[[1], [2]]) }
+    end
+
+    def test_divide
+      m = Matrix[[2, 4], [6, 8]]
+      assert_equal Matrix[[1, 2], [3, 4]], m / 2
+      assert_equal Matrix[[2, 1], [3, 2]], m / Matrix[[1, 4], [2, 4]]
+      assert_equal Matrix[[1, 1], [3, 2]], m / Vector[2, 4]
+      assert_equal Matrix[[0.6]], Matrix[[3]] / 5
+      assert_raises(IndexError) { m / Matrix[[1, 2]] }
+      assert_raises(TypeError) { m / 'a' }
+    end
+
+    def test_math_functions
+      m = Matrix[[1, 4], [9, 16]]
+      assert_equal Matrix[[1, 2], [3, 4]], m.sqrt
+      assert_equal Matrix[[1, 2], [3, 4]], m.map_fn(:sqrt)
+      assert_equal m.map { |x| Math.exp(x) }, m.exp
+      assert_equal m.map { |x| Math.log(x) }, m.log
+      assert_equal m.map { |x| Math.tanh(x) }, m.tanh
+      assert_equal m.map { |x| Math.sin(x) }, m.sin
+      assert_equal m.map { |x| Math.cos(x) }, m.cos
+      assert_equal Matrix[[1, 2]], Matrix[[-1, 2]].map_fn(:abs)
+      assert_raises(ArgumentError) { m.map_fn(:gamma) }
+    end
+
+    def test_math_functions_in_place
+      m = Matrix[[1, 4], [9, 16]]
+      assert_same m, m.sqrt!
+      assert_equal Matrix[[1, 2], [3, 4]], m
+      m.map_fn!(:log)
+      assert_equal 0, m[0, 0]
+      assert_raises(FrozenError) { m.freeze.exp! }
+    end
+
+    def test_pow
+      m = Matrix[[1, 2], [3, 4]]
+      assert_equal Matrix[[1, 4], [9, 16]], m.pow(2)
+      assert_equal Matrix[[1, 8], [27, 64]], m.pow(3)
+      assert_equal Matrix[[1, 0.5], [0.25, 0.125]], Matrix[[1, 2], [4, 8]].pow(-1)
+      m.pow!(0.5)
+      assert_in_delta 2, m[1, 1], 1e-15
+    end
+
+    def test_clamp
+      m = Matrix[[-2, 0.5], [3, 1]]
+      assert_equal Matrix[[0, 0.5], [1, 1]], m.clamp(0, 1)
+      m.clamp!(-1, 2)
+      assert_equal Matrix[[-1, 0.5], [2, 1]], m
+      assert_raises(ArgumentError) { m.clamp(1, 0) }
+    end
+
+    def test_broadcast_rows
+      m = Matrix[[1, 2, 3], [4, 5, 6]]
+      v = Vector[10, 20, 30]
+      assert_equal Matrix[[11, 22, 33], [14, 25, 36]], m.broadcast(:+, v)
+      assert_equal Matrix[[-9, -18, -27], [-6, -15, -24]], m.broadcast(:-, v)
+      assert_equal Matrix[[10, 40, 90], [40, 100, 180]], m.broadcast(:*, v, axis: :rows)
+    end
+
+    def test_broadcast_columns
+      m = Matrix[[1, 2, 3], [4, 5, 6]]
+      v = Vector[1, 2]
+      assert_equal Matrix[[1, 2, 3], [2, 2.5, 3]], m.broadcast(:/, v, axis: :columns)
+      assert_same m, m.broadcast!(:+, v, axis: :columns)
+      assert_equal Matrix[[2, 3, 4], [6, 7, 8]], m
+    end
+
+    def test_broadcast_incorrect
+      m = Matrix[[1, 2, 3], [4, 5, 6]]
+      assert_raises(IndexError) { m.broadcast(:+, Vector[1, 2]) }
+      assert_raises(IndexError) { m.broadcast(:+, Vector[1, 2, 3], axis: :columns) }
+      assert_raises(ArgumentError) { m.broadcast(:%, Vector[1, 2, 3]) }
+      assert_raises(ArgumentError) { m.broadcast(:+, Vector[1, 2], axis: :diagonal) }
+    end
+
+    def test_broadcast_large
+      m = Matrix.build(600, 300) { |i, j| i - j }
+      v = Vector.random(300, seed: 1)
+      expected = Matrix.build(600, 300) { |i, j| i - j + v[j] }
+      assert_equal expected, m.broadcast(:+, v)
+    end
+  end
+end
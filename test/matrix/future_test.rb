@@ -0,0 +1,90 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class FutureTest < Minitest::Test
+    include FastMatrix
+
+    def test_multiply_async
+      m1 = Matrix[[1, 2], [3, 4]]
+      m2 = Matrix[[5, 6], [7, 8]]
+      future = m1.multiply_async(m2)
+      assert_instance_of Future, future
+      assert_equal m1 * m2, future.value
+      assert future.ready?
+      assert_same future.value, future.value
+    end
+
+    def test_strassen_async
+      m1 = Matrix.build(70, 50) { |i, j| i - 2 * j }
+      m2 = Matrix.build(50, 60) { |i, j| i * j % 7 }
+      assert_equal m1 * m2, m1.strassen_async(m2).value
+    end
+
+    def test_determinant_async
+      m = Matrix[[2, 1], [3, 4]]
+      assert_in_delta 5, m.determinant_async.value, 1e-10
+    end
+
+    def test_async_copies_arguments
+      m1 = Matrix[[1, 2], [3, 4]]
+      m2 = Matrix[[1, 0], [0, 1]]
+      future = m1.multiply_async(m2)
+      m1[0, 0] = 10
+      assert_equal Matrix[[1, 2], [3, 4]], future.value
+    end
+
+    def test_async_different_sizes
+      m1 = Matrix[[1, 2], [3, 4]]
+      m2 = Matrix[[1, 2, 3]]
+      assert_raises(FastMatrix::IndexError) { m1.multiply_async(m2) }
+      assert_raises(FastMatrix::IndexError) { m2.determinant_async }
+    end
+
+    def test_select
+      m = Matrix.build(100, 100) { |i, j| i + j }
+      futures = Array.new(4) { m.multiply_async(m) }
+      ready = []
+      ready += IO.select(futures - ready).first until ready.size == futures.size
+      futures.each { |future| assert_equal m * m, future.value }
+    end
+
+    def test_wait
+      future = Matrix[[1]].multiply_async(Matrix[[2]])
+      assert future.wait
+      assert future.wait(0)
+    end
+
+    def test_cancel
+      m = Matrix.build(300, 300) { |i, j| i - j }
+      futures = Array.new(8) { m.multiply_async(m) }
+      cancelled = futures.map(&:cancel)
+      futures.zip(cancelled).each do |future, was_cancelled|
+        if was_cancelled
+          assert future.cancelled?
+          assert future.ready?
+          assert_raises(Future::CancelledError) { future.value }
+        else
+          assert_equal m * m, future.value
+          refute future.cancel
+        end
+      end
+    end
+
+    def test_fork_keeps_parent_futures
+      skip 'fork is not supported' unless Process.respond_to?(:fork)
+
+      m = Matrix.build(200, 200) { |i, j| i * j % 3 }
+      futures = Array.new(4) { m.multiply_async(m) }
+      pid = fork { exit!(m.determinant_async.value.is_a?(Float) ? 0 : 1) }
+      Process.wait(pid)
+      assert_equal 0, $?.exitstatus
+      futures.each { |future| assert_equal m * m, future.value }
+    end
+
+    def test_no_new
+      assert_raises(::TypeError) { Future.new }
+    end
+  end
+end
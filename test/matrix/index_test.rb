@@ -64,5 +64,69 @@ module FastMatrixTest
       m = Matrix.new(2, 4)
       assert_raises(TypeError) { m[1, 1] = 'not a number' }
     end
+
+    def test_slice
+      m = Matrix[[11, 12, 13], [21, 22, 23], [31, 32, 33]]
+      assert_equal Matrix[[22, 23], [32, 33]], m[1..2, 1..2]
+      assert_equal Matrix[[12, 13]], m[0, 1..]
+      assert_equal Matrix[[13], [23]], m[0...2, -1]
+      assert_equal Matrix[[21, 22, 23], [31, 32, 33]], m[1..5, 0..]
+    end
+
+    def test_slice_out_of_range
+      m = Matrix[[11, 12, 13], [21, 22, 23]]
+      assert_nil m[3..4, 0..1]
+      assert_nil m[0..1, 1...1]
+      assert_nil m[5, 0..1]
+    end
+
+    def test_minor
+      m = Matrix[[11, 12, 13], [21, 22, 23], [31, 32, 33]]
+      assert_equal Matrix[[21, 22]], m.minor(1, 1, 0, 2)
+      assert_equal Matrix[[12], [22]], m.minor(0..1, 1..1)
+    end
+
+    def test_select_rows
+      m = Matrix[[11, 12], [21, 22], [31, 32]]
+      assert_equal Matrix[[31, 32], [11, 12], [31, 32]], m.select_rows([2, 0, -1])
+      assert_raises(IndexError) { m.select_rows([3]) }
+      assert_raises(IndexError) { m.select_rows([]) }
+      assert_raises(TypeError) { m.select_rows(1) }
+    end
+
+    def test_select_rows_too_large
+      assert_raises(IndexError) { Matrix.new(1, 50_000).select_rows([0] * 50_000) }
+    end
+
+    def test_select_columns
+      m = Matrix[[11, 12, 13], [21, 22, 23]]
+      assert_equal Matrix[[13, 11], [23, 21]], m.select_columns([2, 0])
+      assert_raises(IndexError) { m.select_columns([0, -4]) }
+    end
+
+    def test_scatter_rows
+      m = Matrix.zero(3, 2)
+      assert_same m, m.scatter_rows!([2, 0], Matrix[[1, 2], [3, 4]])
+      assert_equal Matrix[[3, 4], [0, 0], [1, 2]], m
+      assert_raises(IndexError) { m.scatter_rows!([0], Matrix[[1, 2], [3, 4]]) }
+      assert_raises(IndexError) { m.scatter_rows!([0], Matrix[[1, 2, 3]]) }
+    end
+
+    def test_permute_rows
+      m = Matrix[[11, 12], [21, 22], [31, 32]]
+      assert_equal Matrix[[21, 22], [31, 32], [11, 12]], m.permute_rows([1, 2, 0])
+      assert_raises(IndexError) { m.permute_rows([1, 1, 0]) }
+      assert_raises(IndexError) { m.permute_rows([1, 0]) }
+    end
+
+    def test_swap
+      m = Matrix[[11, 12, 13], [21, 22, 23]]
+      assert_same m, m.swap_rows!(0, -1)
+      assert_equal Matrix[[21, 22, 23], [11, 12, 13]], m
+      m.swap_columns!(0, 2)
+      assert_equal Matrix[[23, 22, 21], [13, 12, 11]], m
+      assert_raises(IndexError) { m.swap_rows!(0, 2) }
+      assert_raises(FrozenError) { m.freeze.swap_columns!(0, 1) }
+    end
   end
 end
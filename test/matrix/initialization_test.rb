@@ -63,6 +63,41 @@ module FastMatrixTest
       assert_raises(NotSupportedError) { Matrix.build(0, 4) }
     end
 
+    def test_build_without_block
+      enumerator = Matrix.build(2, 3)
+      assert_kind_of Enumerator, enumerator
+      assert_equal Matrix[[0, 1, 2], [1, 2, 3]], enumerator.each { |row, col| row + col }
+    end
+
+    def test_random_seed
+      assert_equal Matrix.random(3, 5, seed: 7), Matrix.random(3, 5, seed: 7)
+      refute_equal Matrix.random(3, 5, seed: 7), Matrix.random(3, 5, seed: 8)
+      refute_equal Matrix.random(3, 5), Matrix.random(3, 5)
+    end
+
+    def test_random_does_not_depend_on_size
+      large = Matrix.random(500, 400, distribution: :normal, seed: 11)
+      small = Matrix.random(1, 401, distribution: :normal, seed: 11)
+      400.times { |j| assert_equal large[0, j], small[0, j] }
+      assert_equal large[1, 0], small[0, 400]
+    end
+
+    def test_random_distributions
+      uniform = Matrix.random(400, 500, seed: 1)
+      assert uniform.min >= 0
+      assert uniform.max < 1
+      assert_in_delta 0.5, uniform.mean, 0.01
+      normal = Matrix.random(400, 500, distribution: :normal, seed: 1)
+      assert_in_delta 0, normal.mean, 0.01
+      assert_in_delta 1, normal.frobenius_norm**2 / 200_000, 0.02
+    end
+
+    def test_random_incorrect
+      assert_raises(ArgumentError) { Matrix.random(2, distribution: :poisson) }
+      assert_raises(IndexError) { Matrix.random(-2, 4) }
+      assert_raises(FrozenError) { Matrix[[1]].freeze.random! }
+    end
+
     def test_columns
       actual = Matrix.columns([[25, 93, 34], [-1, 66, 78]])
       expected = Matrix[[25, -1], [93, 66], [34, 78]]
@@ -140,6 +175,59 @@ module FastMatrixTest
                    Matrix.hstack(x, y, z)
     end
 
+    def test_stack_different_sizes
+      x = Matrix[[1, 2], [3, 4]]
+      assert_raises(IndexError) { Matrix.vstack(x, Matrix[[1, 2, 3]]) }
+      assert_raises(IndexError) { Matrix.hstack(x, Matrix[[1, 2, 3]]) }
+    end
+
+    def test_stack_large
+      x = Matrix.random(700, 300, seed: 1)
+      y = Matrix.random(700, 200, seed: 2)
+      h = Matrix.hstack(x, y)
+      assert_equal x, h.select_columns((0...300).to_a)
+      assert_equal y, h.select_columns((300...500).to_a)
+      v = Matrix.vstack(x, x)
+      assert_equal x, v.select_rows((700...1400).to_a)
+    end
+
+    def test_scalar_and_identity
+      assert_equal Matrix[[5, 0], [0, 5]], Matrix.scalar(2, 5)
+      assert_equal Matrix[[1, 0, 0], [0, 1, 0], [0, 0, 1]], Matrix.identity(3)
+      assert_raises(NotSupportedError) { Matrix.identity(0) }
+    end
+
+    def test_block_matrix
+      a = Matrix[[1, 2], [3, 4]]
+      b = Matrix[[5], [6]]
+      c = Matrix[[7, 8]]
+      d = Matrix[[9]]
+      assert_equal Matrix[[1, 2, 5], [3, 4, 6], [7, 8, 9]], Matrix.block_matrix([[a, b], [c, d]])
+    end
+
+    def test_block_matrix_different_sizes
+      a = Matrix[[1, 2], [3, 4]]
+      assert_raises(IndexError) { Matrix.block_matrix([[a, Matrix[[1]]]]) }
+      assert_raises(IndexError) { Matrix.block_matrix([[a], [Matrix[[1]]]]) }
+      assert_raises(IndexError) { Matrix.block_matrix([[a, a], [a]]) }
+      assert_raises(IndexError) { Matrix.block_matrix([]) }
+    end
+
+    def test_block_diagonal
+      expected = Matrix[[1, 2, 0],
+                        [0, 0, 3],
+                        [0, 0, 4]]
+      assert_equal expected, Matrix.block_diagonal(Matrix[[1, 2]], Matrix[[3], [4]])
+    end
+
+    def test_block_assembly_too_large
+      row = Matrix.new(1, 50_000)
+      column = Matrix.new(50_000, 1)
+      assert_raises(IndexError) { Matrix.block_diagonal(row, column) }
+      assert_raises(IndexError) { Matrix.block_matrix([[row], [Matrix.new(49_999, 50_000)]]) }
+      assert_raises(IndexError) { row.kronecker(column) }
+    end
+
     def test_combine
       x = Matrix[[6, 6], [4, 4]]
       y = Matrix[[1, 2], [3, 4]]
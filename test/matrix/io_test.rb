@@ -0,0 +1,141 @@
+# frozen_string_literal: true
+require 'test_helper'
+require 'stringio'
+require 'tmpdir'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class IOTest < Minitest::Test
+    include FastMatrix
+
+    def npy(descr, shape, data, fortran: false)
+      header = +"{'descr': '#{descr}', 'fortran_order': #{fortran ? 'True' : 'False'}, 'shape': #{shape}, }"
+      header << ' ' * (63 - (10 + header.size) % 64) << "\n"
+      "\x93NUMPY".b + [1, 0, header.size].pack('CCv') + header + data
+    end
+
+    def with_file(content = nil)
+      Dir.mktmpdir do |dir|
+        path = File.join(dir, 'data')
+        File.binwrite(path, content) if content
+        yield path
+      end
+    end
+
+    def test_load_npy_float64
+      with_file(npy('<f8', '(2, 3)', [1, 2, 3, 4, 5, 6.5].pack('E*'))) do |path|
+        assert_equal Matrix[[1, 2, 3], [4, 5, 6.5]], Matrix.load_npy(path)
+      end
+    end
+
+    def test_load_npy_float32_big_endian
+      with_file(npy('>f4', '(2, 2)', [1.5, 2, 3, 4].pack('g*'))) do |path|
+        assert_equal Matrix[[1.5, 2], [3, 4]], Matrix.load_npy(path)
+      end
+    end
+
+    def test_load_npy_fortran_order
+      with_file(npy('<f8', '(2, 3)', [1, 4, 2, 5, 3, 6].pack('E*'), fortran: true)) do |path|
+        assert_equal Matrix[[1, 2, 3], [4, 5, 6]], Matrix.load_npy(path)
+      end
+    end
+
+    def test_load_npy_vector
+      with_file(npy('<f8', '(3,)', [1, 2, 3].pack('E*'))) do |path|
+        assert_equal Vector[1, 2, 3], Vector.load_npy(path)
+        assert_raises(FastMatrix::Error) { Matrix.load_npy(path) }
+      end
+    end
+
+    def test_load_npy_invalid
+      with_file(npy('<i8', '(1, 1)', [1].pack('q'))) do |path|
+        assert_raises(FastMatrix::Error) { Matrix.load_npy(path) }
+      end
+      with_file(npy('<f8', '(2, 2)', [1, 2, 3].pack('E*'))) do |path|
+        assert_raises(FastMatrix::Error) { Matrix.load_npy(path) }
+      end
+      with_file('not numpy') do |path|
+        assert_raises(FastMatrix::Error) { Matrix.load_npy(path) }
+      end
+      assert_raises(Errno::ENOENT) { Matrix.load_npy('/nonexistent/file.npy') }
+    end
+
+    def test_load_npy_overflowing_shape
+      ['(9223372036854775807, 2)', '(4294967296, 4294967296)', '(65536, 65536)', '(2, -1)'].each do |shape|
+        with_file(npy('<f8', shape, [1, 2].pack('E*'))) do |path|
+          assert_raises(FastMatrix::Error, shape) { Matrix.load_npy(path) }
+        end
+      end
+      with_file(npy('<f8', '(9223372036854775807,)', [1, 2].pack('E*'))) do |path|
+        assert_raises(FastMatrix::Error) { Vector.load_npy(path) }
+      end
+    end
+
+    def test_save_npy
+      m = Matrix[[1, 2.5], [3, 4]]
+      with_file do |path|
+        m.save_npy(path)
+        content = File.binread(path)
+        assert content.start_with?("\x93NUMPY".b)
+        assert_equal 0, (content.size - 32) % 64
+        assert_includes content, "'shape': (2, 2)"
+        assert_equal m, Matrix.load_npy(path)
+        m.save_npy(path, dtype: :float32)
+        assert_equal m, Matrix.load_npy(path)
+      end
+    end
+
+    def test_save_npy_vector
+      v = Vector[1, 2, 3.25]
+      with_file do |path|
+        v.save_npy(path, dtype: :float32)
+        assert_equal v, Vector.load_npy(path)
+        assert_raises(ArgumentError) { v.save_npy(path, dtype: :int8) }
+      end
+    end
+
+    def test_read_csv
+      m = Matrix.read_csv(StringIO.new("1,2,3\n4, 5.5 ,6e1\r\n\n7,\"8\",\n"))
+      assert_equal 3, m.row_count
+      assert_equal 3, m.column_count
+      assert_equal [1, 2, 3, 4, 5.5, 60, 7, 8], m.first(8)
+      assert m[2, 2].nan?
+    end
+
+    def test_read_csv_options
+      io = StringIO.new("a;b\n1;2\n3;4")
+      assert_equal Matrix[[1, 2], [3, 4]], Matrix.read_csv(io, col_sep: ';', headers: true)
+    end
+
+    def test_read_csv_chunks
+      text = (0...2500).map { |i| "#{i},#{-i},#{i * 0.5}" }.join("\n")
+      chunks = Matrix.read_csv(StringIO.new(text), chunk_rows: 1000).to_a
+      assert_equal [1000, 1000, 500], chunks.map(&:row_count)
+      assert_equal 1999, chunks[1][999, 0]
+      assert_equal 1249.5, chunks[2][499, 2]
+    end
+
+    def test_read_csv_invalid
+      assert_raises(FastMatrix::Error) { Matrix.read_csv(StringIO.new("1,2\n3,x\n")) }
+      assert_raises(IndexError) { Matrix.read_csv(StringIO.new("1,2\n3\n")) }
+      assert_raises(NotSupportedError) { Matrix.read_csv(StringIO.new("\n")) }
+      assert_raises(ArgumentError) { Matrix.read_csv(StringIO.new('1'), col_sep: ', ') }
+    end
+
+    def test_write_csv
+      m = Matrix[[1, 0.1, -2.5], [1e20, 1.0 / 3, 4]]
+      io = StringIO.new
+      m.write_csv(io)
+      assert_equal "1,0.1,-2.5\n", io.string.lines.first
+      assert_equal m, Matrix.read_csv(StringIO.new(io.string))
+    end
+
+    def test_csv_file
+      m = Matrix.random(1500, 3, seed: 3)
+      with_file do |path|
+        m.write_csv(path, col_sep: "\t")
+        assert_equal m, Matrix.read_csv(path, col_sep: "\t")
+      end
+    end
+  end
+end
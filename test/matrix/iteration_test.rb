@@ -0,0 +1,54 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class IterationTest < Minitest::Test
+    include FastMatrix
+
+    def setup
+      @m = Matrix[[1, 2, 3], [4, 5, 6]]
+    end
+
+    def test_each
+      assert_equal [1, 2, 3, 4, 5, 6], @m.each.to_a
+      assert_equal [1, 5], @m.each(:diagonal).to_a
+      assert_equal [2, 3, 6], @m.each(:strict_upper).to_a
+      assert_raises(ArgumentError) { @m.each(:wrong) {} }
+    end
+
+    def test_each_with_index
+      result = []
+      @m.each_with_index { |e, i, j| result << [e, i, j] }
+      assert_equal [1, 0, 0], result[0]
+      assert_equal [6, 1, 2], result[-1]
+      assert_equal 6, @m.each_with_index.size
+    end
+
+    def test_each_with_index!
+      @m.each_with_index! { |e, i, j| e + 10 * i + 100 * j }
+      assert_equal Matrix[[1, 102, 203], [14, 115, 216]], @m
+    end
+
+    def test_map
+      assert_equal Matrix[[2, 4, 6], [8, 10, 12]], @m.map { |x| x * 2 }
+      assert_equal Matrix[[1, 2, 3], [4, 5, 6]], @m
+      assert_equal Matrix[[1, 4, 9], [16, 25, 36]], @m.collect { |x| x * x }
+    end
+
+    def test_map!
+      @m.map!(:lower) { 0 }
+      assert_equal Matrix[[0, 2, 3], [0, 0, 6]], @m
+    end
+
+    def test_enumerable
+      assert_equal 3, @m.count { |x| x > 3 }
+      assert_equal [[1, 2, 3], [4, 5, 6]], @m.to_a
+      assert @m.include?(5)
+    end
+
+    def test_combine_instance
+      assert_equal Matrix[[2, 4, 6], [8, 10, 12]], @m.combine(@m) { |a, b| a + b }
+    end
+  end
+end
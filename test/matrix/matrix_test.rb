@@ -33,6 +33,60 @@ module FastMatrixTest
       refute m1.eql? m2
     end
 
+    def test_not_eql_other_type
+      refute Matrix[[1, 2]].eql?([[1, 2]])
+    end
+
+    def test_hash_key
+      table = { Matrix[[1, 2], [3, 4]] => :a, Matrix[[1, 2]] => :b }
+      assert_equal :a, table[Matrix[[1, 2], [3, 4]]]
+      assert_equal :b, table[Matrix[[1, 2]]]
+      assert_nil table[Matrix[[1, 2], [3, 5]]]
+      assert_nil table[Matrix[[1], [2]]]
+    end
+
+    def test_hash_of_negative_zero
+      assert_equal Matrix[[0.0, 1]].hash, Matrix[[-0.0, 1]].hash
+    end
+
+    def test_hash_after_write
+      m = Matrix[[1, 2], [3, 4]]
+      h = m.hash
+      m[0, 0] = 5
+      refute_equal h, m.hash
+      assert_equal Matrix[[5, 2], [3, 4]].hash, m.hash
+    end
+
+    def test_memoized_results_after_write
+      m = Matrix[[2, 1], [1, 3]]
+      assert_equal 5, m.determinant
+      assert_equal Matrix[[2, 1], [1, 3]], m.transpose
+      assert_in_delta Math.sqrt(15), m.norm
+      m.inverse
+
+      m[0, 1] = 0
+      assert_equal 6, m.determinant
+      assert_equal Matrix[[2, 1], [0, 3]], m.transpose
+      assert_in_delta Math.sqrt(14), m.norm
+      assert_equal Matrix[[3, 0], [-1, 2]] / 6.0, m.inverse
+
+      m += Matrix[[1, 0], [0, 1]]
+      assert_equal 12, m.determinant
+      m.fill!(1)
+      assert_equal 0, m.determinant
+      assert_raises(FastMatrix::Error) { m.inverse }
+      m.each_with_index! { |_, i, j| i == j ? 2 : 0 }
+      assert_equal 4, m.determinant
+    end
+
+    def test_memoized_transpose_is_independent
+      m = Matrix[[1, 2], [3, 4]]
+      t = m.transpose
+      t[0, 0] = 10
+      assert_equal Matrix[[1, 3], [2, 4]], m.transpose
+      assert_equal Matrix[[10, 3], [2, 4]], t
+    end
+
     def test_equal_by_value
       m1 = Matrix[[1, 2], [3, 4]]
       m2 = Matrix[[1, 2], [3, 4]]
@@ -52,5 +106,114 @@ module FastMatrixTest
       assert_equal original, clone
       refute_same original, clone
     end
+
+    def test_clone_is_independent_after_write
+      original = Matrix[[1, 2], [3, 4]]
+      clone = original.clone
+      other = clone.clone
+      clone[0, 0] = 10
+      original.fill!(0)
+
+      assert_equal Matrix[[10, 2], [3, 4]], clone
+      assert_equal Matrix[[0, 0], [0, 0]], original
+      assert_equal Matrix[[1, 2], [3, 4]], other
+    end
+
+    def test_clone_is_independent_after_in_place_operations
+      m = Matrix[[1, 2], [3, 4]]
+      writes = {
+        '+=' => ->(x) { x.public_send('+=', m) },
+        '-=' => ->(x) { x.public_send('-=', m) },
+        'each_with_index!' => ->(x) { x.each_with_index! { |v, _, _| v * 2 } },
+        'map!' => ->(x) { x.map! { |v| -v } },
+        'swap_rows!' => ->(x) { x.swap_rows!(0, 1) },
+        'hadamard_product!' => ->(x) { x.hadamard_product!(m) },
+        'random!' => ->(x) { x.random!(seed: 1) }
+      }
+      writes.each do |name, write|
+        clone = m.clone
+        write.call(clone)
+        assert_equal Matrix[[1, 2], [3, 4]], m, name
+        refute_equal m, clone, name
+      end
+    end
+
+    # a buffer swapped out by a write while a parallel kernel reads it without
+    # the GVL must outlive the kernel; freed buffers are unmapped at once,
+    # so a read after free crashes the child process
+    def test_clone_written_during_parallel_kernel
+      script = <<~RUBY
+        require 'fast_matrix'
+        3.times do
+          a = FastMatrix::Matrix.new(1200, 1200).random!(seed: 1)
+          clones = [a.clone]
+          thread = Thread.new { a.syrk }
+          sleep 0.02
+          a[0, 0] = 1.0
+          clones.clear
+          GC.start
+          thread.join
+        end
+      RUBY
+      env = { 'FAST_MATRIX_NUM_THREADS' => '4', 'MALLOC_MMAP_THRESHOLD_' => '131072' }
+      includes = $LOAD_PATH.flat_map { |path| ['-I', path] }
+      assert system(env, RbConfig.ruby, *includes, '-e', script, err: File::NULL)
+    end
+
+    # a clone interrupted while copying its shared buffer must still own
+    # the copy, not write through to the original
+    def test_clone_written_after_interrupted_copy
+      script = <<~RUBY
+        require 'fast_matrix'
+        m = FastMatrix::Matrix.new(400, 400).fill!(1)
+        clone = nil
+        50.times do
+          thread = Thread.new { loop { clone = m.clone; clone[1, 1] = 42 } }
+          sleep 0.005
+          thread.raise(RuntimeError)
+          thread.join rescue nil
+          clone[1, 1] = 42
+          exit 1 unless m[1, 1] == 1
+        end
+      RUBY
+      env = { 'FAST_MATRIX_NUM_THREADS' => '4' }
+      includes = $LOAD_PATH.flat_map { |path| ['-I', path] }
+      assert system(env, RbConfig.ruby, *includes, '-e', script, err: File::NULL)
+    end
+
+    # an exception raised into a thread running a parallel kernel must not
+    # leave the pool locked or keep later frees deferred forever
+    def test_raise_into_parallel_kernel
+      skip 'needs /proc/self/status' unless File.exist?('/proc/self/status')
+      script = <<~RUBY
+        require 'fast_matrix'
+        m = FastMatrix::Matrix.new(1000, 1000).fill!(1)
+        20.times do
+          thread = Thread.new { loop { m.clone[0, 0] = 2 } }
+          sleep 0.01
+          thread.raise(RuntimeError)
+          thread.join rescue nil
+        end
+        300.times { exit 2 unless (m + m)[999, 999] == 2 }
+        GC.start
+        exit 3 if File.read('/proc/self/status')[/VmRSS:\\s+(\\d+)/, 1].to_i > 500_000
+      RUBY
+      env = { 'FAST_MATRIX_NUM_THREADS' => '4' }
+      includes = $LOAD_PATH.flat_map { |path| ['-I', path] }
+      assert system(env, RbConfig.ruby, *includes, '-e', script, err: File::NULL)
+    end
+
+    def test_clone_inside_map_block
+      m = Matrix[[1, 2], [3, 4]]
+      snapshots = []
+      m.map! do |v|
+        snapshots << m.clone
+        v * 10
+      end
+
+      assert_equal Matrix[[10, 20], [30, 40]], m
+      assert_equal Matrix[[1, 2], [3, 4]], snapshots.first
+      assert_equal Matrix[[10, 20], [30, 4]], snapshots.last
+    end
   end
 end
@@ -0,0 +1,107 @@
+# frozen_string_literal: true
+
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class ProfileTest < Minitest::Test
+    include FastMatrix
+
+    def setup
+      FastMatrix.reset_stats
+    end
+
+    def teardown
+      FastMatrix.stats_enabled = false
+      FastMatrix.on_operation
+      FastMatrix.reset_stats
+    end
+
+    def test_disabled_by_default
+      refute FastMatrix.stats_enabled?
+      Matrix[[1, 2], [3, 4]] * Matrix[[1, 0], [0, 1]]
+      assert_empty FastMatrix.stats
+    end
+
+    def test_counts_calls_flops_and_bytes
+      a = Matrix.new(3, 4).fill!(1)
+      b = Matrix.new(4, 5).fill!(1)
+      FastMatrix.stats_enabled = true
+      2.times { a * b }
+      stats = FastMatrix.stats['Matrix#*']
+      assert_equal 2, stats[:calls]
+      assert_equal 2 * 2 * 3 * 4 * 5, stats[:flops]
+      assert_equal 2 * 8 * 3 * 5, stats[:bytes]
+      assert_operator stats[:nanoseconds], :>, 0
+    end
+
+    def test_shapes_histogram
+      FastMatrix.stats_enabled = true
+      Matrix.new(3, 4).transpose
+      Matrix.new(4, 3).transpose
+      Matrix.new(100, 1).transpose
+      shapes = FastMatrix.stats['Matrix#transpose'][:shapes]
+      assert_equal({ [4, 4] => 2, [128, 1] => 1 }, shapes)
+    end
+
+    def test_covered_operations
+      a = Matrix[[1, 2], [3, 4]]
+      v = Vector[1, 2]
+      FastMatrix.stats_enabled = true
+      Matrix.new(1, 1)
+      Vector.new(1)
+      a.strassen(a)
+      a.determinant
+      a + a
+      a - a
+      a.clone
+      v + v
+      v - v
+      v * 2
+      names = FastMatrix.stats.keys
+      %w[Matrix.new Matrix#strassen Matrix#determinant Matrix#+ Matrix#- Matrix#clone
+         Vector.new Vector#+ Vector#- Vector#*].each { |name| assert_includes names, name }
+    end
+
+    def test_reset_stats
+      FastMatrix.stats_enabled = true
+      Matrix.new(2, 2)
+      refute_empty FastMatrix.stats
+      FastMatrix.reset_stats
+      assert_empty FastMatrix.stats
+    end
+
+    def test_on_operation
+      events = []
+      FastMatrix.on_operation { |*args| events << args }
+      a = Matrix.new(2, 3).fill!(0)
+      a.transpose
+      name, nanoseconds, shape, flops, bytes = events.last
+      assert_equal 'Matrix#transpose', name
+      assert_kind_of Integer, nanoseconds
+      assert_equal [2, 3], shape
+      assert_equal 0, flops
+      assert_equal 48, bytes
+      assert_empty FastMatrix.stats
+    end
+
+    def test_on_operation_does_not_report_hook_operations
+      events = []
+      FastMatrix.on_operation do |name|
+        events << name
+        Matrix.new(1, 1)
+      end
+      Vector.new(3)
+      assert_equal ['Vector.new'], events
+    end
+
+    def test_on_operation_without_block_removes_hook
+      calls = 0
+      FastMatrix.on_operation { calls += 1 }
+      Matrix.new(1, 1)
+      FastMatrix.on_operation
+      Matrix.new(1, 1)
+      assert_equal 1, calls
+    end
+  end
+end
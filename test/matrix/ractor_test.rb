@@ -0,0 +1,50 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class RactorTest < Minitest::Test
+    include FastMatrix
+
+    def test_frozen_matrix_is_immutable
+      m = Matrix[[1, 2], [3, 4]].freeze
+      assert_raises(FrozenError) { m[0, 0] = 5 }
+      assert_raises(FrozenError) { m.fill!(0) }
+      assert_raises(FrozenError) { m.public_send('+=', m) }
+      assert_raises(FrozenError) { m.map! { 0 } }
+      assert_equal Matrix[[2, 4], [6, 8]], m + m
+    end
+
+    def test_frozen_vector_is_immutable
+      v = Vector[1, 2].freeze
+      assert_raises(FrozenError) { v[0] = 5 }
+      assert_raises(FrozenError) { v.normalize! }
+    end
+
+    def test_clone_of_frozen_is_mutable
+      m = Matrix[[1, 2], [3, 4]].freeze
+      c = m.clone
+      c[0, 0] = 0
+      assert_equal 0, c[0, 0]
+    end
+
+    def test_shareable
+      skip 'Ractor is not supported' unless defined?(Ractor)
+
+      m = Ractor.make_shareable(Matrix[[1, 2], [3, 4]])
+      assert Ractor.shareable?(m)
+      assert m.frozen?
+    end
+
+    def test_use_in_ractor
+      skip 'Ractor is not supported' unless defined?(Ractor)
+
+      m = Ractor.make_shareable(Matrix[[1, 2], [3, 4]])
+      verbose = $VERBOSE
+      $VERBOSE = nil
+      ractor = Ractor.new(m) { |x| (x * x).sum }
+      $VERBOSE = verbose
+      assert_equal 54, ractor.take
+    end
+  end
+end
@@ -0,0 +1,66 @@
+# frozen_string_literal: true
+require 'test_helper'
+
+module FastMatrixTest
+  # noinspection RubyInstanceMethodNamingConvention
+  class ReductionTest < Minitest::Test
+    include FastMatrix
+
+    def setup
+      @m = Matrix[[1, -2, 3], [4, 5, -6]]
+    end
+
+    def test_sum_mean
+      assert_equal 5, @m.sum
+      assert_in_delta 5.0 / 6, @m.mean, 1e-15
+    end
+
+    def test_min_max
+      assert_equal(-6, @m.min)
+      assert_equal 5, @m.max
+    end
+
+    def test_enumerable_forms
+      assert_equal [-6, -2], @m.min(2)
+      assert_equal [5, 4], @m.max(2)
+      assert_equal(-6, @m.max { |a, b| b <=> a })
+      assert_equal 1, @m.min_by(&:abs)
+      assert_equal 5.0, @m.sum(0.0)
+      assert_equal 11, @m.sum(6)
+      assert_equal 91, @m.sum { |v| v * v }
+    end
+
+    def test_norms
+      assert_in_delta Math.sqrt(91), @m.frobenius_norm, 1e-12
+      assert_in_delta Math.sqrt(91), @m.norm, 1e-12
+      assert_equal 21, @m.norm(1)
+      assert_equal 6, @m.norm(Float::INFINITY)
+      assert_raises(ArgumentError) { @m.norm(0) }
+    end
+
+    def test_trace
+      assert_equal 6, Matrix[[1, 2], [3, 5]].trace
+      assert_raises(IndexError) { @m.trace }
+    end
+
+    def test_rows
+      assert_equal Vector[2, 3], @m.row_sums
+      assert_equal Vector[2.0 / 3, 1], @m.row_means
+      assert_equal Vector[-2, -6], @m.row_min
+      assert_equal Vector[3, 5], @m.row_max
+    end
+
+    def test_columns
+      assert_equal Vector[5, 3, -3], @m.column_sums
+      assert_equal Vector[2.5, 1.5, -1.5], @m.column_means
+      assert_equal Vector[1, -2, -6], @m.column_min
+      assert_equal Vector[4, 5, 3], @m.column_max
+    end
+
+    def test_sum_accuracy
+      m = Matrix.fill(0.1, 1, 1_000_000)
+      assert_in_delta 100_000, m.sum, 1e-8
+      assert_in_delta 100_000, m.transpose.column_sums[0], 1e-8
+    end
+  end
+end
@@ -51,6 +51,59 @@ module FastVectorTest
       assert_equal expected, v1 * v2
     end
 
+    def test_sub
+      v1 = Vector[1, 3]
+      v2 = Vector[4, 3]
+      assert_equal Vector[-3, 0], v1 - v2
+      v1 -= v2
+      assert_equal Vector[-3, 0], v1
+    end
+
+    def test_dot
+      assert_equal 47, Vector[4, 7].dot(Vector[10, 1])
+      assert_equal 47, Vector[4, 7].inner_product(Vector[10, 1])
+      assert_raises(IndexError) { Vector[1, 2].dot(Vector[1]) }
+    end
+
+    def test_dot_long
+      n = 300_000
+      v = Vector.elements(Array.new(n) { |i| i.odd? ? 1 : -1 })
+      assert_equal n, v.dot(v)
+    end
+
+    def test_norm
+      assert_equal 5, Vector[3, 4].norm
+      assert_equal 5, Vector[3, 4].magnitude
+    end
+
+    def test_normalize
+      v = Vector[3, 4]
+      assert_equal Vector[0.6, 0.8], v.normalize
+      assert_equal Vector[3, 4], v
+      v.normalize!
+      assert_equal Vector[0.6, 0.8], v
+      assert_raises(Error) { Vector[0, 0].normalize }
+    end
+
+    def test_cross_product
+      assert_equal Vector[-3, 6, -3], Vector[1, 2, 3].cross_product(Vector[4, 5, 6])
+      assert_raises(IndexError) { Vector[1, 2].cross_product(Vector[1, 2]) }
+    end
+
+    def test_outer
+      expected = Matrix[[3, 4, 5], [-3, -4, -5]]
+      assert_equal expected, Vector[1, -1].outer(Vector[3, 4, 5])
+    end
+
+    def test_outer_too_large
+      assert_raises(IndexError) { Vector.new(50_000).outer(Vector.new(50_000)) }
+    end
+
+    def test_dot_rows
+      m = Matrix[[1, 2], [3, 4], [5, 6]]
+      assert_equal Vector[5, 11, 17], m.dot_rows(Vector[1, 2])
+    end
+
     def test_eql_equal
       m = FastMatrix::Vector[1, 2, 5]
       n = FastMatrix::Vector[1, 2, 5]
@@ -62,5 +115,25 @@ module FastVectorTest
       n = FastMatrix::Vector[1, 4, 5]
       refute m.eql?(n)
     end
+
+    def test_hadamard_product
+      v = Vector[1, 2, 3]
+      assert_equal Vector[4, 10, 18], v.hadamard(Vector[4, 5, 6])
+      assert_raises(IndexError) { v.hadamard(Vector[1, 2]) }
+    end
+
+    def test_divide
+      assert_equal Vector[1, 2], Vector[2, 4] / 2
+      assert_equal Vector[2, 1], Vector[2, 4] / Vector[1, 4]
+    end
+
+    def test_elementwise_math
+      v = Vector[1, 4, 9]
+      assert_equal Vector[1, 2, 3], v.sqrt
+      assert_equal Vector[1, 16, 81], v.pow(2)
+      assert_equal Vector[1, 4, 5], v.clamp(0, 5)
+      v.map_fn!(:log)
+      assert_equal Vector[0, Math.log(4), Math.log(9)], v
+    end
   end
 end
@@ -43,5 +43,18 @@ module FastVectorTest
     def test_zero
       assert_equal Vector[0, 0, 0], Vector.zero(3)
     end
+
+    def test_random
+      v = Vector.random(300_001, seed: 5)
+      assert_equal Vector.random(3, seed: 5).to_a, v.first(3)
+      assert(v.all? { |x| x >= 0 && x < 1 })
+      assert_in_delta 0, Vector.random(300_000, distribution: :normal).sum / 300_000, 0.01
+    end
+
+    def test_random_in_place
+      v = Vector.zero(4)
+      assert_same v, v.random!(seed: 1)
+      assert_equal Vector.random(4, seed: 1), v
+    end
   end
 end
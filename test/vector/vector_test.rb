@@ -12,6 +12,36 @@ module FastVectorTest
       refute_same original, clone
     end
 
+    def test_clone_is_independent_after_write
+      original = Vector[1, 2, 3]
+      clone = original.clone
+      clone[0] = 10
+      other = original.clone
+      original.public_send('+=', original)
+      other.normalize!
+
+      assert_equal Vector[10, 2, 3], clone
+      assert_equal Vector[2, 4, 6], original
+      assert_in_delta 1.0, other.norm, 1e-12
+    end
+
+    def test_each
+      assert_equal [1, 2, 3], Vector[1, 2, 3].each.to_a
+      assert_equal [[1, 0], [2, 1]], Vector[1, 2].each_with_index.to_a
+    end
+
+    def test_map
+      v = Vector[1, 2, 3]
+      assert_equal Vector[2, 4, 6], v.map { |x| x * 2 }
+      v.map! { |x| -x }
+      assert_equal Vector[-1, -2, -3], v
+    end
+
+    def test_enumerable
+      assert_equal 2, Vector[1, 2, 3].count { |x| x > 1 }
+      assert_equal [1, 2, 3], Vector[1, 2, 3].to_a
+    end
+
     def test_same
       v = Vector[1, 2]
       assert_same v, v
@@ -39,6 +69,13 @@ module FastVectorTest
       refute v1.eql? v2
     end
 
+    def test_hash_key
+      table = { Vector[1, 2, 3] => :a }
+      assert_equal :a, table[Vector[1, 2, 3]]
+      assert_nil table[Vector[1, 2, 4]]
+      refute Vector[1, 2].eql?([1, 2])
+    end
+
     def test_equal_by_value
       v1 = Vector[1, 2, 3, 4]
       v2 = Vector[1, 2, 3, 4]